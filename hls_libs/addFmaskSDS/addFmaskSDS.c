@@ -43,9 +43,9 @@
 #include <stdlib.h>
 #include <math.h>
 
-#include "dilation.h"
 #include "hls_projection.h"
 #include "s2r.h"
+#include "s2addmask.h"
 #include "util.h"
 #include "hls_hdfeos.h"
 
@@ -134,7 +134,9 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	/* Make it hdfeos */
+	/* Make it hdfeos, unless it is a raw intermediate (see hls_raw.h) */
+	if (is_hls_raw(s2rout.fname))
+		return 0;
  	sds_info_t all_sds[S2NBAND+2];
 	set_S10_sds_info(all_sds, S2NBAND+2, &s2rout);
 	ret = S10_PutSpaceDefHDF(s2rout.fname, all_sds, S2NBAND+2); 
@@ -151,8 +153,6 @@ int copyref_addmask(s2r_t *s2in, char *fname_fmask, char *fname_aeroQA, s2r_t *s
 	int ib;
 	int psi;
 	int k, npix;
-	unsigned char mask, val;
-	char message[MSGLEN];
 
 	/* Needed for map projection */
 	strcpy(s2out->zonehem, s2in->zonehem);
@@ -166,180 +166,8 @@ int copyref_addmask(s2r_t *s2in, char *fname_fmask, char *fname_aeroQA, s2r_t *s
 			s2out->ref[ib][k] = s2in->ref[ib][k];
 	}
 
-
-	/***************************************************/
-// Jun 27, 2019. This is the bit description of the v1.4 QA SDS. Although we do not keep this SDS
-// in v1.5, we use the same bit description in v1.5 for both ACmask and Fmask.
-//
-//	/* v1.4 QA SDS */
-//	/* Note: For better view with hdfdump, the blanks within the string is blank space characters, not tab */
-// 	sprintf(attr,   "Bits are listed from the MSB (bit 7) to the LSB (bit 0): \n"
-//                      "7-6    aerosol:\n"
-//                      "       00 - climatology\n"
-//                      "       01 - low\n"
-//                      "       10 - average\n"
-//                      "       11 - high\n"
-//		  	"5      water\n"
-//			"4      snow/ice\n"
-//			"3      cloud shadow\n"
-//    			"2      adjacent to cloud; \n",
-//			"1      cloud\n"
-//			"0      cirrus\n");
-//	SDsetattr(s2r->sds_id_qa, "QA description", DFNT_CHAR8, strlen(attr), (VOIDP)attr);
-//
-//	/* The original CLOUD SDS from LaSRC 
-//	CLOUD:QA index = "\n",
-//	    		"\tBits are listed from the MSB (bit 7) to the LSB (bit 0):\n",
-//	    		"\t7      internal test; \n",
-//	    		"\t6      unused; \n",
-//	    		"\t4-5     aerosol;\n",
-//	    		"\t       00 -- climatology\n",
-//	    		"\t       01 -- low\n",
-//	    		"\t       10 -- average\n",
-//	    		"\t       11 -- high\n",
-//	    		"\t3      cloud shadow; \n",
-//	    		"\t2      adjacent to cloud; \n",
-//	    		"\t1      cloud; \n",
-//	    		"\t0      cirrus cloud; \n",
-//	*/
-
-	/* v1.5 ACmask. Essentially CLOUD but with some bits swapped in compliance with the v1.4 QA SDS  */
-	npix = s2in->nrow[0] * s2in->ncol[0];
-	for (k = 0; k < npix; k++) { 
-		/* Bug fix on Aug 30, 2019.  LaSRC S2 uses a baffling mask fill value 24, not 255! */
-		//if (s2in->accloud[k] == HLS_MASK_FILLVAL)
-		if (s2in->accloud[k] == AC_S2_CLOUD_FILLVAL)
-			continue;
-
-		mask = 0;
-
-		/* Bits 0-3 are the same for CLOUD and ACmask.
-		 * They are: CIRRUS, cloud, adjacent to cloud, and cloud shadow.
-		 */
-		mask = s2in->accloud[k] & 017; 	/* 017 is binary 1111 */
-
-		/* Reserve bit 4 for snow/ice, which is not set in AC CLOUD  */
-
-		/* Reserve bit 5 for water, which is not set in AC CLOUD. Although bit 7 of AC CLOUD
-		 * is "internal test" for water (Oct 3, 2017), the quality is very poor.  Jun 27, 2019 
-		 */
-
-		/* 2-bit aerosol level, shift from original CLOUD bits 4-5 to ACmask bits 6-7 */
-		mask = mask | (((s2in->accloud[k] >> 4 ) & 03) << 6);
-
-		/* Finally */
-		s2out->acmask[k] = mask;
-	}
-
-
-	/***** Fmask *****/
-
-	int nrow10m, ncol10m;
-	int nrow20m, ncol20m;
-	int irow, icol, k10m, k20m;
-	unsigned char *fmask;
-	FILE *ffmask;
-
-	nrow10m = s2in->nrow[0];
-	ncol10m = s2in->ncol[0];
-
-	/*** Fmask cloud mask is originally created at 20m, but oversampled here to 10m for S10 products. */
-	nrow20m = s2in->nrow[0]/2;	/* 1/2 dimension of 10m bands */
-	ncol20m = s2in->ncol[0]/2;
-	if ((fmask = (uint8*)calloc(nrow20m * ncol20m, sizeof(uint8))) == NULL) {
-		Error("Cannot allocate memory\n");
-		return(1);
-	}
-	if ((ffmask = fopen(fname_fmask, "r")) == NULL) {
-		sprintf(message, "Cannot read Fmask %s\n", fname_fmask);
-		Error(message);
-		return(1);
-	}
-	if (fread(fmask, sizeof(uint8), nrow20m * ncol20m, ffmask) !=  nrow20m * ncol20m) {
-		sprintf(message, "Fmask file size wrong: %s\n", fname_fmask);
-		Error(message);
-		return(1);
-	}
-	fclose(ffmask);
-
-	/* Dilate 20m Fmask result by 7 pixels.  9/22/2020 */
-	dilate(fmask, nrow20m, ncol20m, 7);
-
-	/* Read USGS aerosol QA byte. Apr 14, 2021*/
-	FILE *faeroQA;
-	unsigned char *aeroQA;
-	if ((aeroQA = (uint8*)calloc(nrow10m * ncol10m, sizeof(uint8))) == NULL) {
-		Error("Cannot allocate memory\n");
-		return(1);
-	}
-	if ((faeroQA = fopen(fname_aeroQA, "r")) == NULL) {
-		sprintf(message, "Cannot read Fmask %s\n", fname_aeroQA);
-		Error(message);
-		return(1);
-	}
-	if (fread(aeroQA, sizeof(uint8), nrow10m * ncol10m, faeroQA) !=  nrow10m * ncol10m) {
-		sprintf(message, "Fmask file size wrong: %s\n", fname_aeroQA);
-		Error(message);
-		return(1);
-	}
-	fclose(faeroQA);
-
-	for (irow = 0; irow < nrow10m; irow++) {
-		for (icol = 0; icol < ncol10m; icol++) {
-			k10m = irow * ncol10m + icol;
-			k20m = (irow/2) * ncol20m + (icol/2);
-
-			if (fmask[k20m] == HLS_MASK_FILLVAL)	/* Fmask has used 255 as fill */
-				continue;
-
-			/* fmask
-			clear land = 0
-			water = 1
-			cloud shadow = 2
-			snow = 3
-			cloud = 4
-			thin_cirrus = 5		#  Seems cirrus is dropped in v4.0?   Mar 20, 2019 
-			*/
-
-			switch(fmask[k20m])
-			{
-				case 254:	/* Dilated cloud or cloud shadow */
-					val = 1;
-					mask = (val << 2);
-					break;
-				case 5: 	/* CIRRUS. But not set in Fmask4.0. A placeholder for now. Jun 27, 2019 */
-					mask = 1;
-					break;
-				case 4: 	/* cloud*/ 
-					val = 1;
-					mask = (val << 1);
-					break;
-				case 3: 	/* snow/ice. */
-					val = 1;
-					mask = (val << 4);
-					break;
-				case 2: 	/* Cloud shadow */
-					val = 1;
-					mask = (val << 3);
-					break;
-				case 1: 	/* water*/
-					val = 1;
-					mask = (val << 5);
-					break;
-				case 0:
-					mask = 0;
-					break;	/* clear; do nothing */
-				default: 
-					sprintf(message, "Fmask value not expected: %d", fmask[k20m]);
-					Error(message);
-					exit(1);
-			}
-
-			/* Add the 2 bits of aerosol level from USGS aerosol QA */
-			mask = mask | (((aeroQA[k10m] >> 6 ) & 03) << 6);
-			s2out->fmask[k10m] = mask;
-		}
-	}
-
-	return 0;
+	/* ACmask from CLOUD, and the dilated Fmask with the aerosol level. 
+	 * See s2addmask.c for the bit description.
+	 */
+	return add_s2mask(s2in, fname_fmask, fname_aeroQA, s2out);
 }
@@ -0,0 +1,97 @@
+/* Regression check for dilate(): compare it with the original per-seed window search
+ * on synthetic masks of random size, seed density and window size. The output must be
+ * identical. Exit status is 1 on any difference.
+ *
+ * Oct 17, 2026
+ */
+#include "dilation.h"
+
+/* The original dilate(), which visits the window around every seed and keeps the
+ * squared distance to the nearest seed.
+ */
+static void dilate_baseline(unsigned char *mask, int nrow, int ncol, int hw)
+{
+	unsigned char *dm;
+	unsigned short *dis;
+	unsigned short d;
+	int irow, icol, i, j, k, n;
+
+	dm = (unsigned char*)malloc(nrow * ncol);
+	dis = (unsigned short*)malloc(nrow * ncol * sizeof(unsigned short));
+	if (dm == NULL || dis == NULL) {
+		fprintf(stderr, "Cannot allocate memory\n");
+		exit(1);
+	}
+	memcpy(dm, mask, nrow * ncol);
+	for (k = 0; k < nrow * ncol; k++)
+		dis[k] = 10000;
+
+	for (irow = 0; irow < nrow; irow++) {
+		for (icol = 0; icol < ncol; icol++) {
+			if (!isSeed(mask[irow * ncol + icol]))
+				continue;
+			for (i = irow-hw; i <= irow+hw; i++) {
+				for (j = icol-hw; j <= icol+hw; j++) {
+					if (i < 0 || i >= nrow || j < 0 || j >= ncol)
+						continue;
+					n = i * ncol + j;
+					if (mask[n] == HLS_MASK_FILLVAL || isSeed(mask[n]))
+						continue;
+					d = (i-irow)*(i-irow) + (j-icol)*(j-icol);
+					if (d < dis[n]) {
+						dm[n] = 254;
+						dis[n] = d;
+					}
+				}
+			}
+		}
+	}
+
+	memcpy(mask, dm, nrow * ncol);
+	free(dm);
+	free(dis);
+}
+
+int main()
+{
+	unsigned char *mask, *ref;
+	int nrow, ncol, hw, dens, r;
+	int itest, k;
+
+	srand(1);
+	for (itest = 0; itest < 500; itest++) {
+		nrow = 1 + rand() % 80;
+		ncol = 1 + rand() % 80;
+		hw = rand() % 10;
+		dens = rand() % 200;	/* Seeds per thousand */
+		mask = (unsigned char*)malloc(nrow * ncol);
+		ref = (unsigned char*)malloc(nrow * ncol);
+		if (mask == NULL || ref == NULL) {
+			fprintf(stderr, "Cannot allocate memory\n");
+			return(1);
+		}
+		for (k = 0; k < nrow * ncol; k++) {
+			r = rand() % 1000;
+			if (r < dens)
+				mask[k] = rand() % 2 ? 2 : 4;
+			else if (r < dens + 100)
+				mask[k] = HLS_MASK_FILLVAL;
+			else
+				mask[k] = rand() % 5;
+		}
+		memcpy(ref, mask, nrow * ncol);
+
+		dilate(mask, nrow, ncol, hw);
+		dilate_baseline(ref, nrow, ncol, hw);
+		if (memcmp(mask, ref, nrow * ncol) != 0) {
+			fprintf(stderr, "dilate() differs from the baseline: nrow=%d ncol=%d hw=%d\n",
+					nrow, ncol, hw);
+			return(1);
+		}
+		free(mask);
+		free(ref);
+	}
+
+	printf("check_dilation: %d masks identical\n", itest);
+	return(0);
+}
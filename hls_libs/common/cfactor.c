@@ -52,10 +52,6 @@ int open_cfactor(int sensor_type, cfactor_t *cfactor, intn access_mode)
 
 	if (access_mode == DFACC_CREATE) {
 		char *dimnames[] =  {"YDim_Grid", "XDim_Grid"};
-		int32 comp_type;   /*Compression flag*/
-		comp_info c_info;  /*Compression structure*/
-		comp_type = COMP_CODE_DEFLATE;
-		c_info.deflate.level = 2;     /*Level 9 would be too slow */
 		rank = 2;
 		int irow, icol;
 
@@ -80,7 +76,7 @@ int open_cfactor(int sensor_type, cfactor_t *cfactor, intn access_mode)
 			*/
 			PutSDSDimInfo(cfactor->sds_id_ratio[ib], dimnames[0], 0);
 			PutSDSDimInfo(cfactor->sds_id_ratio[ib], dimnames[1], 1);
-			SDsetcompress(cfactor->sds_id_ratio[ib], comp_type, &c_info);	
+			SetSDSChunkDeflate(cfactor->sds_id_ratio[ib], cfactor->nrow, cfactor->ncol, HLS_CHUNK_NROW);	
 			SDsetattr(cfactor->sds_id_ratio[ib], "_FillValue", DFNT_FLOAT32, 1, (VOIDP)&cfactor_fillval);
 
 			if ((cfactor->ratio[ib] = (float32*)calloc(cfactor->nrow * cfactor->ncol, sizeof(float32))) == NULL) {
@@ -108,16 +104,12 @@ int close_cfactor(cfactor_t *cfactor)
 	int ib;
 	
 	if (cfactor->access_mode == DFACC_CREATE && cfactor->sd_id != FAIL) {
-		int32 start[2], edge[2];
-
 		for (ib = 0; ib < cfactor->nband; ib++) {
 			if (cfactor->sds_id_ratio[ib] == FAIL)
 				continue;
 
-			start[0] = 0; edge[0] = cfactor->nrow;
-			start[1] = 0; edge[1] = cfactor->ncol;
-			if (SDwritedata(cfactor->sds_id_ratio[ib], start, NULL, edge, cfactor->ratio[ib]) == FAIL) {
-				Error("Error in SDwritedata");
+			if (WriteSDSByChunk(cfactor->sds_id_ratio[ib], cfactor->nrow, cfactor->ncol, sizeof(float32), cfactor->ratio[ib]) != 0) {
+				Error("Error in WriteSDSByChunk");
 				return(ERR_CREATE);
 			}
 			SDendaccess(cfactor->sds_id_ratio[ib]);
@@ -0,0 +1,99 @@
+#include "dilation.h"
+
+
+/* Dilate certain mask values by a number of pixels. 
+ * The values to be dilated (seeds) are defined in isSeed().
+ *   mask: cloud mask array
+ *   nrow: 
+ *   ncol: 
+ *   hw: half size of the dilation window (kernel as people say?)
+ *
+ * Oct 17, 2026: The original code visited the (2*hw+1)^2 window around every seed
+ * pixel and kept the squared distance to the nearest seed for each pixel. But a 
+ * dilated pixel is labeled 254 no matter how far the nearest seed is, so the result 
+ * is simply whether there is a seed in the square window centered on the pixel, i.e.
+ * whether the Chebyshev distance to the nearest seed is no more than hw. The square 
+ * window is separable: first find, for each pixel, whether there is a seed within hw 
+ * columns in the same row; then whether any of the rows within hw rows has such a 
+ * pixel in the same column. Both passes keep a running count over a sliding window, 
+ * so the cost is O(nrow*ncol) regardless of hw, and the rows in the first pass and the 
+ * columns in the second pass are independent of each other. The output is identical 
+ * to the original.
+ */
+void dilate(unsigned char *mask, int nrow, int ncol, int hw) 
+{
+	unsigned char dval = 254; 	/* Dilated */
+	unsigned char *rowhit;		/* 1 if there is a seed within hw columns in the same row */
+	int *cnt;			/* Number of rows in the vertical window with rowhit set */
+	int ncolblk;			/* Columns processed together in the vertical pass */
+	int nblk;
+
+	int irow, icol, ib;
+	int n;
+	long k;
+
+	if ((rowhit = (unsigned char*) calloc((long)nrow * ncol, sizeof(char))) == NULL) {
+		fprintf(stderr, "Cannot allocate memory for rowhit\n");
+		exit(1);
+	}
+	if ((cnt = (int*) calloc(ncol, sizeof(int))) == NULL) {
+		fprintf(stderr, "Cannot allocate memory for cnt\n");
+		exit(1);
+	}
+
+	/* Horizontal pass. n is the number of seeds in columns [icol-hw, icol+hw]. */
+	#pragma omp parallel for private(icol, n, k) schedule(static)
+	for (irow = 0; irow < nrow; irow++) {
+		k = (long)irow * ncol;
+		n = 0;
+		for (icol = 0; icol < hw && icol < ncol; icol++)
+			n += isSeed(mask[k+icol]);
+		for (icol = 0; icol < ncol; icol++) {
+			if (icol+hw < ncol)
+				n += isSeed(mask[k+icol+hw]);
+			if (icol-hw-1 >= 0)
+				n -= isSeed(mask[k+icol-hw-1]);
+			rowhit[k+icol] = (n > 0);
+		}
+	}
+
+	/* Vertical pass, in blocks of columns so that the image is still traversed 
+	 * row by row. cnt[icol] is the number of rows in [irow-hw, irow+hw] with rowhit set.
+	 * Do not dilate into nodata pixels or other seed pixels, but it is okay to 
+	 * dilate into non-seed pixels because the masking may not correct there anyway.
+	 */
+	ncolblk = 256;
+	nblk = (ncol + ncolblk - 1) / ncolblk;
+	#pragma omp parallel for private(irow, icol, k) schedule(static)
+	for (ib = 0; ib < nblk; ib++) {
+		int colbeg = ib * ncolblk;
+		int colend = colbeg + ncolblk < ncol ? colbeg + ncolblk : ncol;
+
+		for (irow = 0; irow < hw && irow < nrow; irow++) {
+			k = (long)irow * ncol;
+			for (icol = colbeg; icol < colend; icol++)
+				cnt[icol] += rowhit[k+icol];
+		}
+		for (irow = 0; irow < nrow; irow++) {
+			if (irow+hw < nrow) {
+				k = (long)(irow+hw) * ncol;
+				for (icol = colbeg; icol < colend; icol++)
+					cnt[icol] += rowhit[k+icol];
+			}
+			if (irow-hw-1 >= 0) {
+				k = (long)(irow-hw-1) * ncol;
+				for (icol = colbeg; icol < colend; icol++)
+					cnt[icol] -= rowhit[k+icol];
+			}
+
+			k = (long)irow * ncol;
+			for (icol = colbeg; icol < colend; icol++) {
+				if (cnt[icol] > 0 && mask[k+icol] != HLS_MASK_FILLVAL && !isSeed(mask[k+icol]))
+					mask[k+icol] = dval;
+			}
+		}
+	}
+
+	free(rowhit);
+	free(cnt);
+}
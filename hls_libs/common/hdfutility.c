@@ -19,3 +19,69 @@ int PutSDSDimInfo(int32 sds_id, char *dimname, int irank)
 
 	return(0);
 }
+
+int SetSDSChunkDeflate(int32 sds_id, int32 nrow, int32 ncol, int32 chunk_nrow)
+{
+	HDF_CHUNK_DEF chunk_def;
+
+	chunk_def.comp.chunk_lengths[0] = (chunk_nrow < nrow) ? chunk_nrow : nrow;
+	chunk_def.comp.chunk_lengths[1] = ncol;
+	chunk_def.comp.comp_type = COMP_CODE_DEFLATE;
+	chunk_def.comp.cinfo.deflate.level = 2;     /*Level 9 would be too slow */
+	if (SDsetchunk(sds_id, chunk_def, HDF_CHUNK | HDF_COMP) == FAIL) {
+		Error("Error in SDsetchunk()");
+		return(ERR_CREATE);
+	}
+
+	return(0);
+}
+
+int WriteSDSByChunk(int32 sds_id, int32 nrow, int32 ncol, size_t pixsz, void *buf)
+{
+	HDF_CHUNK_DEF cdef;
+	int32 cflags;
+	int32 start[2], edge[2];
+	int32 origin[2];
+	int32 chunk_nrow, irow;
+	size_t rowsize;
+	char *padded = NULL;	/* For the last chunk, which may extend beyond the last row */
+
+	if (SDgetchunkinfo(sds_id, &cdef, &cflags) == FAIL || cflags == HDF_NONE || 
+	    cdef.chunk_lengths[1] != ncol) {
+		start[0] = 0; edge[0] = nrow;
+		start[1] = 0; edge[1] = ncol;
+		if (SDwritedata(sds_id, start, NULL, edge, buf) == FAIL) {
+			Error("Error in SDwritedata()");
+			return(ERR_CREATE);
+		}
+		return(0);
+	}
+
+	chunk_nrow = cdef.chunk_lengths[0];
+	rowsize = (size_t)ncol * pixsz;
+	origin[1] = 0;
+	for (irow = 0; irow < nrow; irow += chunk_nrow) {
+		origin[0] = irow / chunk_nrow;
+		if (irow + chunk_nrow <= nrow) {
+			if (SDwritechunk(sds_id, origin, (char*)buf + irow * rowsize) == FAIL) {
+				Error("Error in SDwritechunk()");
+				return(ERR_CREATE);
+			}
+		}
+		else {
+			if ((padded = (char*)calloc(chunk_nrow, rowsize)) == NULL) {
+				Error("Cannot allocate memory");
+				return(ERR_MEM);
+			}
+			memcpy(padded, (char*)buf + irow * rowsize, (nrow - irow) * rowsize);
+			if (SDwritechunk(sds_id, origin, padded) == FAIL) {
+				Error("Error in SDwritechunk()");
+				free(padded);
+				return(ERR_CREATE);
+			}
+			free(padded);
+		}
+	}
+
+	return(0);
+}
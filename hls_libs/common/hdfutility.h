@@ -11,4 +11,28 @@
 static char *dimnames[] = {"YDim_Grid", "XDim_Grid"};
 int PutSDSDimInfo(int32 sds_id, char *dimname, int irank);
 
+/* Oct 17, 2026: Chunked deflate layout for the SDS created by the HLS code, in place of a
+ * deflated SDS that is not chunked. A chunk is chunk_nrow rows by the full width,
+ * deflated at level 2 as before. Chunked, deflated SDS are standard HDF4 and are read
+ * by hdp, GDAL, etc. the same way. A chunked SDS can be written in part (a strip of 
+ * rows, or the rows changed), and a chunk is deflated as it is written, not the 
+ * whole SDS at once.
+ *
+ * This is the chunked layout only. The deflate is still done by HDF4 inside 
+ * SDwritechunk(), on the calling thread: HDF4 is not thread-safe and has no call to 
+ * store a chunk deflated outside the library, so the chunks are not deflated on a 
+ * worker pool. The deflate time is about the same as for the unchunked SDS; it is 
+ * spent in WriteSDSByChunk() instead of at SDendaccess(). Multithreaded deflate is 
+ * only done for the native COG output, where the tiles are compressed in parallel 
+ * (hls_cog.c).
+ */
+#define HLS_CHUNK_NROW 60
+int SetSDSChunkDeflate(int32 sds_id, int32 nrow, int32 ncol, int32 chunk_nrow);
+
+/* Write a whole 2-D SDS from buf, which holds nrow by ncol pixels of pixsz bytes. A 
+ * chunked SDS of full-width chunks is written a chunk at a time with SDwritechunk(),
+ * which bypasses the chunk cache; any other SDS is written with SDwritedata().
+ */
+int WriteSDSByChunk(int32 sds_id, int32 nrow, int32 ncol, size_t pixsz, void *buf);
+
 #endif
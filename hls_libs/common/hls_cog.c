@@ -0,0 +1,573 @@
+#include "hls_cog.h"
+#include "hls_raw.h"
+#include <math.h>
+#include <stdint.h>
+#include <zlib.h>
+
+/* TIFF field types */
+#define TIFF_ASCII  2
+#define TIFF_SHORT  3
+#define TIFF_LONG   4
+#define TIFF_DOUBLE 12
+
+#define COG_MAXTAG   24
+
+/* A TIFF tag. The value is in data (nbyte bytes), or in value for a single SHORT or LONG. */
+typedef struct {
+	uint16_t tag;
+	uint16_t type;
+	uint32_t count;
+	uint32_t value;
+	const void *data;
+	uint32_t nbyte;
+} cog_tag_t;
+
+/* The full resolution (level 0) or an overview */
+typedef struct {
+	int nrow, ncol;
+	void *img;		/* From the pyramid */
+	int ntilex, ntiley, ntile;
+	unsigned char **tile;	/* Compressed tiles */
+	uint32_t *tilesize;
+	uint32_t *tileoffset;
+
+	cog_tag_t tag[COG_MAXTAG];
+	int ntag;
+	uint32_t ifdsize;
+	uint32_t ifdoffset;
+} cog_level_t;
+
+/* A growing string for the GDAL metadata */
+typedef struct {
+	char *s;
+	size_t len, cap;
+} cog_str_t;
+
+static size_t cog_pixsz(int type)
+{
+	return (type == HLS_COG_UINT8 ? 1 : 2);
+}
+
+static double get_pix(void *buf, int type, size_t k)
+{
+	if (type == HLS_COG_UINT8)
+		return ((uint8*)buf)[k];
+	else if (type == HLS_COG_INT16)
+		return ((int16*)buf)[k];
+	else
+		return ((uint16*)buf)[k];
+}
+
+static void set_pix(void *buf, int type, size_t k, double v)
+{
+	if (type == HLS_COG_UINT8)
+		((uint8*)buf)[k] = (uint8)v;
+	else if (type == HLS_COG_INT16)
+		((int16*)buf)[k] = (int16)v;
+	else
+		((uint16*)buf)[k] = (uint16)v;
+}
+
+/* Halve an image. Average takes the rounded mean of the pixels in the 2x2 box that are
+ * not fill; nearest takes the upper-left pixel.
+ */
+static void *reduce_image(void *in, int type, int nrow, int ncol, double fillval, int resampling,
+			  int *onrow, int *oncol)
+{
+	void *out;
+	int orow, ocol;
+
+	*onrow = (nrow + 1) / 2;
+	*oncol = (ncol + 1) / 2;
+	orow = *onrow;
+	ocol = *oncol;
+	if ((out = malloc((size_t)orow * ocol * cog_pixsz(type))) == NULL)
+		return(NULL);
+
+	int r;
+	#pragma omp parallel for schedule(static)
+	for (r = 0; r < orow; r++) {
+		int c, dr, dc, n;
+		double v, sum;
+		for (c = 0; c < ocol; c++) {
+			if (resampling == HLS_COG_NEAREST) {
+				set_pix(out, type, (size_t)r * ocol + c, get_pix(in, type, (size_t)2*r * ncol + 2*c));
+				continue;
+			}
+			sum = 0;
+			n = 0;
+			for (dr = 0; dr < 2 && 2*r + dr < nrow; dr++) {
+				for (dc = 0; dc < 2 && 2*c + dc < ncol; dc++) {
+					v = get_pix(in, type, (size_t)(2*r + dr) * ncol + 2*c + dc);
+					if (v != fillval) {
+						sum += v;
+						n++;
+					}
+				}
+			}
+			set_pix(out, type, (size_t)r * ocol + c, n == 0 ? fillval : floor(sum / n + 0.5));
+		}
+	}
+
+	return(out);
+}
+
+/* Copy tile it of a level to raw, padded with fill, apply the horizontal differencing
+ * predictor, and deflate it.
+ */
+static int compress_tile(cog_level_t *lv, int type, double fillval, int it, unsigned char *raw)
+{
+	size_t pixsz, rawsize;
+	uLongf destlen;
+	int tx, ty, r, c, nr, nc;
+	long k;
+
+	pixsz = cog_pixsz(type);
+	rawsize = (size_t)HLS_COG_TILESZ * HLS_COG_TILESZ * pixsz;
+	ty = it / lv->ntilex;
+	tx = it % lv->ntilex;
+	nr = lv->nrow - ty * HLS_COG_TILESZ;
+	if (nr > HLS_COG_TILESZ)
+		nr = HLS_COG_TILESZ;
+	nc = lv->ncol - tx * HLS_COG_TILESZ;
+	if (nc > HLS_COG_TILESZ)
+		nc = HLS_COG_TILESZ;
+
+	if (nr < HLS_COG_TILESZ || nc < HLS_COG_TILESZ) {
+		for (k = 0; k < HLS_COG_TILESZ * HLS_COG_TILESZ; k++)
+			set_pix(raw, type, k, fillval);
+	}
+	for (r = 0; r < nr; r++)
+		memcpy(raw + (size_t)r * HLS_COG_TILESZ * pixsz,
+		       (char*)lv->img + ((size_t)(ty * HLS_COG_TILESZ + r) * lv->ncol + tx * HLS_COG_TILESZ) * pixsz,
+		       nc * pixsz);
+
+	/* Predictor 2, in the unsigned arithmetic of the sample size */
+	for (r = 0; r < HLS_COG_TILESZ; r++) {
+		if (pixsz == 1) {
+			uint8 *p = raw + (size_t)r * HLS_COG_TILESZ;
+			for (c = HLS_COG_TILESZ - 1; c > 0; c--)
+				p[c] -= p[c-1];
+		}
+		else {
+			uint16 *p = (uint16*)raw + (size_t)r * HLS_COG_TILESZ;
+			for (c = HLS_COG_TILESZ - 1; c > 0; c--)
+				p[c] -= p[c-1];
+		}
+	}
+
+	destlen = compressBound(rawsize);
+	if ((lv->tile[it] = (unsigned char*)malloc(destlen)) == NULL)
+		return(ERR_MEM);
+	if (compress2(lv->tile[it], &destlen, raw, rawsize, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return(ERR_CREATE);
+	lv->tilesize[it] = destlen;
+
+	return 0;
+}
+
+/* Compress all the tiles of a level, in parallel */
+static int compress_level(cog_level_t *lv, int type, double fillval)
+{
+	int ret = 0;
+
+	lv->ntilex = (lv->ncol + HLS_COG_TILESZ - 1) / HLS_COG_TILESZ;
+	lv->ntiley = (lv->nrow + HLS_COG_TILESZ - 1) / HLS_COG_TILESZ;
+	lv->ntile = lv->ntilex * lv->ntiley;
+	if ((lv->tile = (unsigned char**)calloc(lv->ntile, sizeof(unsigned char*))) == NULL ||
+	    (lv->tilesize = (uint32_t*)calloc(lv->ntile, sizeof(uint32_t))) == NULL ||
+	    (lv->tileoffset = (uint32_t*)calloc(lv->ntile, sizeof(uint32_t))) == NULL)
+		return(ERR_MEM);
+
+	#pragma omp parallel
+	{
+		unsigned char *raw;
+		int it, tret;
+
+		raw = (unsigned char*)malloc((size_t)HLS_COG_TILESZ * HLS_COG_TILESZ * cog_pixsz(type));
+		#pragma omp for schedule(dynamic)
+		for (it = 0; it < lv->ntile; it++) {
+			tret = (raw == NULL) ? ERR_MEM : compress_tile(lv, type, fillval, it, raw);
+			if (tret != 0) {
+				#pragma omp critical
+				ret = tret;
+			}
+		}
+		free(raw);
+	}
+
+	return(ret);
+}
+
+static void add_tag(cog_level_t *lv, uint16_t tag, uint16_t type, uint32_t count, uint32_t value, const void *data)
+{
+	cog_tag_t *t;
+	uint32_t size;
+
+	size = (type == TIFF_ASCII ? 1 : type == TIFF_SHORT ? 2 : type == TIFF_LONG ? 4 : 8);
+	t = &lv->tag[lv->ntag++];
+	t->tag = tag;
+	t->type = type;
+	t->count = count;
+	t->value = value;
+	t->data = data;
+	t->nbyte = size * count;
+}
+
+/* The size of an IFD, including the tag data that does not fit in the entries */
+static uint32_t ifd_size(cog_level_t *lv)
+{
+	uint32_t size;
+	int i;
+
+	size = 2 + 12 * lv->ntag + 4;
+	for (i = 0; i < lv->ntag; i++) {
+		if (lv->tag[i].nbyte > 4)
+			size += (lv->tag[i].nbyte + 1) & ~1u;
+	}
+
+	return(size);
+}
+
+/* Lay out the IFD of a level at ifdoffset, followed by its tag data, in buf */
+static void pack_ifd(cog_level_t *lv, uint32_t next, unsigned char *buf)
+{
+	unsigned char *e;
+	uint32_t ext;
+	uint16_t n16;
+	int i;
+
+	memset(buf, 0, lv->ifdsize);
+	n16 = lv->ntag;
+	memcpy(buf, &n16, 2);
+	ext = 2 + 12 * lv->ntag + 4;
+	for (i = 0; i < lv->ntag; i++) {
+		cog_tag_t *t = &lv->tag[i];
+		e = buf + 2 + 12 * i;
+		memcpy(e, &t->tag, 2);
+		memcpy(e + 2, &t->type, 2);
+		memcpy(e + 4, &t->count, 4);
+		if (t->data == NULL) {
+			if (t->type == TIFF_SHORT) {
+				n16 = t->value;
+				memcpy(e + 8, &n16, 2);
+			}
+			else
+				memcpy(e + 8, &t->value, 4);
+		}
+		else if (t->nbyte <= 4)
+			memcpy(e + 8, t->data, t->nbyte);
+		else {
+			uint32_t off = lv->ifdoffset + ext;
+			memcpy(e + 8, &off, 4);
+			memcpy(buf + ext, t->data, t->nbyte);
+			ext += (t->nbyte + 1) & ~1u;
+		}
+	}
+	memcpy(buf + 2 + 12 * lv->ntag, &next, 4);
+}
+
+int build_hls_pyramid(hls_pyramid_t *pyr, void *buf, int type, int nrow, int ncol,
+		      double fillval, int resampling)
+{
+	int il;
+
+	memset(pyr, 0, sizeof(hls_pyramid_t));
+	pyr->type = type;
+	pyr->fillval = fillval;
+	pyr->nrow[0] = nrow;
+	pyr->ncol[0] = ncol;
+	pyr->img[0] = buf;
+	for (il = 1; il < HLS_COG_MAXLEVEL &&
+		     (pyr->nrow[il-1] > HLS_COG_TILESZ || pyr->ncol[il-1] > HLS_COG_TILESZ); il++) {
+		pyr->img[il] = reduce_image(pyr->img[il-1], type, pyr->nrow[il-1], pyr->ncol[il-1],
+				fillval, resampling, &pyr->nrow[il], &pyr->ncol[il]);
+		if (pyr->img[il] == NULL) {
+			Error("Cannot allocate memory for the overviews");
+			pyr->nlevel = il;
+			return(ERR_MEM);
+		}
+	}
+	pyr->nlevel = il;
+
+	return 0;
+}
+
+void free_hls_pyramid(hls_pyramid_t *pyr)
+{
+	int il;
+
+	for (il = 1; il < pyr->nlevel; il++) {
+		free(pyr->img[il]);
+		pyr->img[il] = NULL;
+	}
+	pyr->nlevel = 0;
+}
+
+int write_hls_cog(char *fname, void *buf, int type, int nrow, int ncol,
+		  char *zonehem, double ulx, double uly, double pixsz,
+		  double fillval, int resampling, char *gdal_metadata)
+{
+	hls_pyramid_t pyr;
+	int ret;
+
+	if ((ret = build_hls_pyramid(&pyr, buf, type, nrow, ncol, fillval, resampling)) == 0)
+		ret = write_hls_cog_pyramid(fname, &pyr, zonehem, ulx, uly, pixsz, gdal_metadata);
+	free_hls_pyramid(&pyr);
+
+	return(ret);
+}
+
+int write_hls_cog_pyramid(char *fname, hls_pyramid_t *pyr, char *zonehem, double ulx, double uly,
+			  double pixsz, char *gdal_metadata)
+{
+	cog_level_t lv[HLS_COG_MAXLEVEL];
+	int nlevel, il, it, zone, type, ret;
+	uint32_t offset;
+	double scale[3], tiepoint[6];
+	uint16_t geokey[20];
+	char nodata[50];
+	unsigned char header[8] = {'I', 'I', 42, 0, 8, 0, 0, 0};	/* Little endian, first IFD at 8 */
+	unsigned char *ifdbuf;
+	FILE *fp;
+	char message[MSGLEN];
+
+	/* UTM; uly in the GCTP convention for the southern hemisphere is made positive */
+	zone = atoi(zonehem);
+	if (strchr(zonehem, 'S') != NULL && uly < 0)
+		uly += 10000000;
+	scale[0] = pixsz; scale[1] = pixsz; scale[2] = 0;
+	tiepoint[0] = 0; tiepoint[1] = 0; tiepoint[2] = 0;
+	tiepoint[3] = ulx; tiepoint[4] = uly; tiepoint[5] = 0;
+	uint16_t gk[20] = {1, 1, 0, 4,
+			   1024, 0, 1, 1,		/* GTModelType: projected */
+			   1025, 0, 1, 1,		/* GTRasterType: PixelIsArea */
+			   3072, 0, 1, 0,		/* ProjectedCSType, below */
+			   3076, 0, 1, 9001};		/* ProjLinearUnits: metre */
+	memcpy(geokey, gk, sizeof(gk));
+	geokey[15] = (strchr(zonehem, 'S') != NULL ? 32700 : 32600) + zone;
+	sprintf(nodata, "%g", pyr->fillval);
+
+	memset(lv, 0, sizeof(lv));
+	type = pyr->type;
+	nlevel = pyr->nlevel;
+	for (il = 0; il < nlevel; il++) {
+		lv[il].nrow = pyr->nrow[il];
+		lv[il].ncol = pyr->ncol[il];
+		lv[il].img = pyr->img[il];
+	}
+
+	ret = 0;
+	for (il = 0; il < nlevel && ret == 0; il++)
+		ret = compress_level(&lv[il], type, pyr->fillval);
+	if (ret != 0) {
+		sprintf(message, "Error in compressing the tiles of %s", fname);
+		Error(message);
+		goto cleanup;
+	}
+
+	/* The IFDs, in ascending tag order */
+	for (il = 0; il < nlevel; il++) {
+		add_tag(&lv[il], 254, TIFF_LONG, 1, il == 0 ? 0 : 1, NULL);	/* NewSubfileType */
+		add_tag(&lv[il], 256, TIFF_LONG, 1, lv[il].ncol, NULL);
+		add_tag(&lv[il], 257, TIFF_LONG, 1, lv[il].nrow, NULL);
+		add_tag(&lv[il], 258, TIFF_SHORT, 1, cog_pixsz(type) * 8, NULL);
+		add_tag(&lv[il], 259, TIFF_SHORT, 1, 8, NULL);			/* Deflate */
+		add_tag(&lv[il], 262, TIFF_SHORT, 1, 1, NULL);			/* BlackIsZero */
+		add_tag(&lv[il], 277, TIFF_SHORT, 1, 1, NULL);			/* SamplesPerPixel */
+		add_tag(&lv[il], 284, TIFF_SHORT, 1, 1, NULL);			/* PlanarConfiguration */
+		add_tag(&lv[il], 317, TIFF_SHORT, 1, 2, NULL);			/* Predictor */
+		add_tag(&lv[il], 322, TIFF_SHORT, 1, HLS_COG_TILESZ, NULL);
+		add_tag(&lv[il], 323, TIFF_SHORT, 1, HLS_COG_TILESZ, NULL);
+		add_tag(&lv[il], 324, TIFF_LONG, lv[il].ntile, 0, lv[il].tileoffset);
+		add_tag(&lv[il], 325, TIFF_LONG, lv[il].ntile, 0, lv[il].tilesize);
+		add_tag(&lv[il], 339, TIFF_SHORT, 1, type == HLS_COG_INT16 ? 2 : 1, NULL);	/* SampleFormat */
+		if (il == 0) {
+			add_tag(&lv[il], 33550, TIFF_DOUBLE, 3, 0, scale);		/* ModelPixelScale */
+			add_tag(&lv[il], 33922, TIFF_DOUBLE, 6, 0, tiepoint);	/* ModelTiepoint */
+			add_tag(&lv[il], 34735, TIFF_SHORT, 20, 0, geokey);	/* GeoKeyDirectory */
+			if (gdal_metadata != NULL)
+				add_tag(&lv[il], 42112, TIFF_ASCII, strlen(gdal_metadata) + 1, 0, gdal_metadata);
+			add_tag(&lv[il], 42113, TIFF_ASCII, strlen(nodata) + 1, 0, nodata);
+		}
+	}
+
+	/* The IFDs from the 8-byte header on, then the tiles from the smallest overview */
+	offset = 8;
+	for (il = 0; il < nlevel; il++) {
+		lv[il].ifdoffset = offset;
+		lv[il].ifdsize = ifd_size(&lv[il]);
+		offset += lv[il].ifdsize;
+	}
+	for (il = nlevel - 1; il >= 0; il--) {
+		for (it = 0; it < lv[il].ntile; it++) {
+			lv[il].tileoffset[it] = offset;
+			offset += lv[il].tilesize[it];
+		}
+	}
+
+	if ((fp = fopen(fname, "wb")) == NULL) {
+		sprintf(message, "Cannot create %s", fname);
+		Error(message);
+		ret = ERR_CREATE;
+		goto cleanup;
+	}
+	if (fwrite(header, 1, 8, fp) != 8)
+		ret = ERR_CREATE;
+	for (il = 0; il < nlevel && ret == 0; il++) {
+		if ((ifdbuf = (unsigned char*)malloc(lv[il].ifdsize)) == NULL) {
+			ret = ERR_MEM;
+			break;
+		}
+		pack_ifd(&lv[il], il + 1 < nlevel ? lv[il+1].ifdoffset : 0, ifdbuf);
+		if (fwrite(ifdbuf, 1, lv[il].ifdsize, fp) != lv[il].ifdsize)
+			ret = ERR_CREATE;
+		free(ifdbuf);
+	}
+	for (il = nlevel - 1; il >= 0 && ret == 0; il--) {
+		for (it = 0; it < lv[il].ntile && ret == 0; it++) {
+			if (fwrite(lv[il].tile[it], 1, lv[il].tilesize[it], fp) != lv[il].tilesize[it])
+				ret = ERR_CREATE;
+		}
+	}
+	if (ret == 0 && ferror(fp))
+		ret = ERR_CREATE;
+	if (fclose(fp) != 0 && ret == 0)
+		ret = ERR_CREATE;
+	if (ret != 0) {
+		sprintf(message, "Error in writing %s", fname);
+		Error(message);
+	}
+
+cleanup:
+	for (il = 0; il < nlevel; il++) {
+		if (lv[il].tile != NULL) {
+			for (it = 0; it < lv[il].ntile; it++)
+				free(lv[il].tile[it]);
+			free(lv[il].tile);
+		}
+		free(lv[il].tilesize);
+		free(lv[il].tileoffset);
+	}
+
+	return(ret);
+}
+
+static void str_append(cog_str_t *str, const char *s, size_t n)
+{
+	if (str->len + n + 1 > str->cap) {
+		str->cap = (str->len + n + 1) * 2;
+		if ((str->s = (char*)realloc(str->s, str->cap)) == NULL) {
+			Error("Cannot allocate memory for the GDAL metadata");
+			exit(ERR_MEM);
+		}
+	}
+	memcpy(str->s + str->len, s, n);
+	str->len += n;
+	str->s[str->len] = '\0';
+}
+
+/* Append n characters of s, escaped for XML */
+static void str_append_xml(cog_str_t *str, const char *s, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n && s[i] != '\0'; i++) {
+		switch (s[i]) {
+			case '&': str_append(str, "&amp;", 5); break;
+			case '<': str_append(str, "&lt;", 4); break;
+			case '>': str_append(str, "&gt;", 4); break;
+			case '"': str_append(str, "&quot;", 6); break;
+			default:  str_append(str, s + i, 1);
+		}
+	}
+}
+
+char *hls_cog_hdf_items(int32 sd_id)
+{
+	int32 nsds, nattr, data_type, count;
+	char attr_name[H4_MAX_NC_NAME];
+	char num[50];
+	void *val;
+	int32 i, j;
+	cog_str_t str = {NULL, 0, 0};
+
+	str_append(&str, "", 0);
+	if (sd_id == FAIL || SDfileinfo(sd_id, &nsds, &nattr) == FAIL)
+		return(str.s);
+
+	for (i = 0; i < nattr; i++) {
+		if (SDattrinfo(sd_id, i, attr_name, &data_type, &count) == FAIL)
+			continue;
+		/* The image dimension of a raw sidecar is not metadata */
+		if (strcmp(attr_name, HLS_RAW_NROW) == 0 || strcmp(attr_name, HLS_RAW_NCOL) == 0)
+			continue;
+		if ((val = malloc((size_t)DFKNTsize(data_type) * count + 1)) == NULL) {
+			Error("Cannot allocate memory for an attribute");
+			exit(ERR_MEM);
+		}
+		if (SDreadattr(sd_id, i, val) == FAIL) {
+			free(val);
+			continue;
+		}
+
+		str_append(&str, "  <Item name=\"", 14);
+		str_append_xml(&str, attr_name, strlen(attr_name));
+		str_append(&str, "\">", 2);
+		for (j = 0; j < count; j++) {
+			num[0] = '\0';
+			switch (data_type) {
+				case DFNT_CHAR8:
+				case DFNT_UCHAR8:
+					str_append_xml(&str, (char*)val, count);
+					j = count;
+					break;
+				case DFNT_FLOAT64: sprintf(num, "%.15g", ((float64*)val)[j]); break;
+				case DFNT_FLOAT32: sprintf(num, "%.7g", ((float32*)val)[j]); break;
+				case DFNT_INT8:    sprintf(num, "%d", ((int8*)val)[j]); break;
+				case DFNT_UINT8:   sprintf(num, "%u", ((uint8*)val)[j]); break;
+				case DFNT_INT16:   sprintf(num, "%d", ((int16*)val)[j]); break;
+				case DFNT_UINT16:  sprintf(num, "%u", ((uint16*)val)[j]); break;
+				case DFNT_INT32:   sprintf(num, "%d", ((int32*)val)[j]); break;
+				case DFNT_UINT32:  sprintf(num, "%u", ((uint32*)val)[j]); break;
+			}
+			if (num[0] != '\0') {
+				if (j > 0)
+					str_append(&str, ", ", 2);
+				str_append(&str, num, strlen(num));
+			}
+		}
+		str_append(&str, "</Item>\n", 8);
+		free(val);
+	}
+
+	return(str.s);
+}
+
+static void append_band_item(cog_str_t *str, char *name, char *role, char *value)
+{
+	char item[200];
+
+	sprintf(item, "  <Item name=\"%s\" sample=\"0\" role=\"%s\">", name, role);
+	str_append(str, item, strlen(item));
+	str_append_xml(str, value, strlen(value));
+	str_append(str, "</Item>\n", 8);
+}
+
+char *hls_cog_metadata(char *items, char *description, char *scale, char *offset)
+{
+	cog_str_t str = {NULL, 0, 0};
+
+	str_append(&str, "<GDALMetadata>\n", 15);
+	if (items != NULL)
+		str_append(&str, items, strlen(items));
+	if (description != NULL)
+		append_band_item(&str, "DESCRIPTION", "description", description);
+	if (scale != NULL)
+		append_band_item(&str, "SCALE", "scale", scale);
+	if (offset != NULL)
+		append_band_item(&str, "OFFSET", "offset", offset);
+	str_append(&str, "</GDALMetadata>\n", 16);
+
+	return(str.s);
+}
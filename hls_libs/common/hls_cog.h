@@ -0,0 +1,85 @@
+/* Cloud-Optimized GeoTIFF writer for the final products. Oct 17, 2026.
+ *
+ * The S30 and the angles used to be written as HDF-EOS and then converted band by
+ * band to COG by hdf_to_cog, which read each SDS back and inflated it. The product
+ * is now written to COG straight from the buffers of s2at30m_t and s2ang_t, one
+ * single-band file per SDS, named as by hdf_to_cog.
+ *
+ * The file is a little-endian classic TIFF laid out as a COG:
+ *   - 512x512 tiles, deflated (zlib) with the horizontal differencing predictor;
+ *   - internal overviews at 2x, 4x, ... until the image fits in one tile (hls_pyramid_t);
+ *   - all the IFDs at the start of the file, followed by the tiles of the smallest
+ *     overview first and the full resolution last;
+ *   - UTM georeferencing (EPSG 326zz/327zz) from zonehem, ulx and uly;
+ *   - the nodata value and the metadata in the GDAL tags.
+ *
+ * There is no libtiff or GDAL in the build, so the TIFF is written here with zlib.
+ * The hosts are all little endian, and the pixels are written in the native order.
+ */
+#ifndef HLS_COG_H
+#define HLS_COG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mfhdf.h"
+#include "util.h"
+#include "hls_commondef.h"
+
+#define HLS_COG_TILESZ 512
+
+/* Pixel data types */
+#define HLS_COG_UINT8  1
+#define HLS_COG_INT16  2
+#define HLS_COG_UINT16 3
+
+/* Overview resampling. Average ignores fill; use nearest for masks and for angles,
+ * whose azimuth cannot be averaged across 0/360.
+ */
+#define HLS_COG_NEAREST 0
+#define HLS_COG_AVERAGE 1
+
+#define HLS_COG_MAXLEVEL 16
+
+/* Oct 17, 2026: The image and its overviews, each half the size of the previous one
+ * (2x, 4x, 8x, ...) until it fits in a tile; for the S30, 3660, 1830, 915, 458. They
+ * are built once, while the image is still in memory, and used for the COG and the
+ * quicklook (see hls_quicklook.h), so neither has to go over the full resolution again.
+ */
+typedef struct {
+	int type;
+	double fillval;
+	int nlevel;
+	int nrow[HLS_COG_MAXLEVEL];
+	int ncol[HLS_COG_MAXLEVEL];
+	void *img[HLS_COG_MAXLEVEL];	/* img[0] is the caller's image, not copied */
+} hls_pyramid_t;
+
+int build_hls_pyramid(hls_pyramid_t *pyr, void *buf, int type, int nrow, int ncol,
+		      double fillval, int resampling);
+void free_hls_pyramid(hls_pyramid_t *pyr);
+
+/* Write the pyramid to fname as COG. gdal_metadata is the content of the GDAL_METADATA
+ * tag, e.g. from hls_cog_metadata(); NULL for none. For the southern hemisphere, uly
+ * can be in the GCTP convention (negative).
+ */
+int write_hls_cog_pyramid(char *fname, hls_pyramid_t *pyr, char *zonehem, double ulx, double uly,
+			  double pixsz, char *gdal_metadata);
+
+/* Build the pyramid of the nrow x ncol image buf of the given type and write it */
+int write_hls_cog(char *fname, void *buf, int type, int nrow, int ncol,
+		  char *zonehem, double ulx, double uly, double pixsz,
+		  double fillval, int resampling, char *gdal_metadata);
+
+/* The global attributes of an HDF file (or a raw sidecar) as GDAL metadata items;
+ * the result is to be freed. An empty string if sd_id is FAIL.
+ */
+char *hls_cog_hdf_items(int32 sd_id);
+
+/* The GDAL_METADATA of a band: the dataset items (from hls_cog_hdf_items(); can be NULL),
+ * the band description, and the scale and offset if not NULL. To be freed.
+ */
+char *hls_cog_metadata(char *items, char *description, char *scale, char *offset);
+
+#endif
@@ -35,6 +35,12 @@ static char *ang_add_offset = "0.0";
 #define NAMELEN 500  /* obsolete? */
 #define LINELEN 500
 
+/* Access mode for an image that is only held in memory, without an HDF file.
+ * Used for the S10 passed between the stages of hls_s2_pipeline.  Not a DFACC_ mode. 
+ * Oct 17, 2026
+ */
+#define HLS_ACC_MEMORY 0x100
+
 #define ERR_READ    1 
 #define ERR_CREATE  2 
 #define ERR_MEM     3 
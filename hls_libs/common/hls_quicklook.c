@@ -0,0 +1,77 @@
+#include "hls_quicklook.h"
+#include <jpeglib.h>
+
+static unsigned char stretch(int16 ref)
+{
+	if (ref == HLS_REFL_FILLVAL || ref <= 0)
+		return 0;
+	if (ref >= HLS_QUICKLOOK_MAXREF)
+		return 255;
+	return (unsigned char)(ref * 255 / HLS_QUICKLOOK_MAXREF);
+}
+
+int write_hls_quicklook(char *fname, hls_pyramid_t *red, hls_pyramid_t *green, hls_pyramid_t *blue)
+{
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	hls_pyramid_t *rgb[3];
+	unsigned char *line;
+	JSAMPROW row;
+	int il, nrow, ncol, irow, icol, i;
+	long k;
+	FILE *fp;
+	char message[MSGLEN];
+
+	rgb[0] = red;
+	rgb[1] = green;
+	rgb[2] = blue;
+
+	/* The three bands have the same dimension and therefore the same levels */
+	for (il = red->nlevel - 1; il > 0 && red->ncol[il] < HLS_QUICKLOOK_MINSZ; il--)
+		;
+	nrow = red->nrow[il];
+	ncol = red->ncol[il];
+
+	if ((fp = fopen(fname, "wb")) == NULL) {
+		sprintf(message, "Cannot create %s", fname);
+		Error(message);
+		return(ERR_CREATE);
+	}
+	if ((line = (unsigned char*)malloc(ncol * 3)) == NULL) {
+		Error("Cannot allocate memory");
+		fclose(fp);
+		return(ERR_MEM);
+	}
+
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_stdio_dest(&cinfo, fp);
+	cinfo.image_width = ncol;
+	cinfo.image_height = nrow;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, HLS_QUICKLOOK_QUALITY, TRUE);
+	jpeg_start_compress(&cinfo, TRUE);
+
+	row = line;
+	for (irow = 0; irow < nrow; irow++) {
+		for (icol = 0; icol < ncol; icol++) {
+			k = (long)irow * ncol + icol;
+			for (i = 0; i < 3; i++)
+				line[icol * 3 + i] = stretch(((int16*)rgb[i]->img[il])[k]);
+		}
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	free(line);
+	if (fclose(fp) != 0) {
+		sprintf(message, "Error in writing %s", fname);
+		Error(message);
+		return(ERR_CREATE);
+	}
+
+	return 0;
+}
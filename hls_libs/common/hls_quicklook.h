@@ -0,0 +1,28 @@
+/* RGB quicklook of the S30. Oct 17, 2026.
+ *
+ * Written as JPEG from an overview of B04, B03, and B02 built for the COG (see 
+ * hls_pyramid_t in hls_cog.h), while the bands are still in memory. The stretch is 
+ * not that of create_thumbnail, which still makes the published thumbnail from the
+ * COGs; the quicklook is only written in debug mode, next to it, for comparison.
+ */
+#ifndef HLS_QUICKLOOK_H
+#define HLS_QUICKLOOK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mfhdf.h"
+#include "util.h"
+#include "fillval.h"
+#include "hls_commondef.h"
+#include "hls_cog.h"
+
+#define HLS_QUICKLOOK_MINSZ 400		/* The coarsest overview at least this wide is used */
+#define HLS_QUICKLOOK_MAXREF 3000	/* Scaled reflectance stretched to 255; fill is black */
+#define HLS_QUICKLOOK_QUALITY 90
+
+/* Write the quicklook from the pyramids of the red, green, and blue bands */
+int write_hls_quicklook(char *fname, hls_pyramid_t *red, hls_pyramid_t *green, hls_pyramid_t *blue);
+
+#endif
@@ -0,0 +1,131 @@
+#include "hls_raw.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int is_hls_raw(char *fname)
+{
+	size_t len, extlen;
+
+	len = strlen(fname);
+	extlen = strlen(HLS_RAW_EXT);
+	return (len > extlen && strcmp(fname + len - extlen, HLS_RAW_EXT) == 0);
+}
+
+int32 start_hls_raw_sidecar(char *fname, intn access_mode, int nrow, int ncol)
+{
+	char fname_sidecar[LINELEN+10];
+	int32 sd_id, dim;
+	char message[MSGLEN];
+
+	sprintf(fname_sidecar, "%s%s", fname, HLS_RAW_SIDECAR_EXT);
+	if ((sd_id = SDstart(fname_sidecar, access_mode)) == FAIL) {
+		sprintf(message, "Cannot open %s", fname_sidecar);
+		Error(message);
+		return(FAIL);
+	}
+
+	if (access_mode == DFACC_CREATE) {
+		dim = nrow;
+		SDsetattr(sd_id, HLS_RAW_NROW, DFNT_INT32, 1, (VOIDP)&dim);
+		dim = ncol;
+		SDsetattr(sd_id, HLS_RAW_NCOL, DFNT_INT32, 1, (VOIDP)&dim);
+	}
+
+	return(sd_id);
+}
+
+int get_hls_raw_dim(char *fname, int *nrow, int *ncol)
+{
+	int32 sd_id, attr_index, dim[2];
+	char *attr_name[2] = {HLS_RAW_NROW, HLS_RAW_NCOL};
+	int i;
+	char message[MSGLEN];
+
+	if ((sd_id = start_hls_raw_sidecar(fname, DFACC_READ, 0, 0)) == FAIL)
+		return(ERR_READ);
+
+	for (i = 0; i < 2; i++) {
+		if ((attr_index = SDfindattr(sd_id, attr_name[i])) == FAIL ||
+		    SDreadattr(sd_id, attr_index, &dim[i]) == FAIL) {
+			sprintf(message, "Error read attribute \"%s\" for %s", attr_name[i], fname);
+			Error(message);
+			SDend(sd_id);
+			return(ERR_READ);
+		}
+	}
+	SDend(sd_id);
+
+	*nrow = dim[0];
+	*ncol = dim[1];
+	return(0);
+}
+
+size_t hls_raw_layout(int nplane, size_t *planesize, size_t *offset)
+{
+	int ip;
+	size_t size = 0;
+
+	for (ip = 0; ip < nplane; ip++) {
+		offset[ip] = size;
+		size += (planesize[ip] + HLS_RAW_ALIGN - 1) / HLS_RAW_ALIGN * HLS_RAW_ALIGN;
+	}
+
+	return(size);
+}
+
+int map_hls_raw(char *fname, intn access_mode, size_t size, void **map)
+{
+	int fd, flags, prot, share;
+	struct stat st;
+	char message[MSGLEN];
+
+	prot = PROT_READ | PROT_WRITE;
+	share = MAP_SHARED;
+	if (access_mode == DFACC_CREATE)
+		flags = O_RDWR | O_CREAT | O_TRUNC;
+	else if (access_mode == DFACC_WRITE)
+		flags = O_RDWR;
+	else {
+		flags = O_RDONLY;
+		share = MAP_PRIVATE;
+	}
+
+	if ((fd = open(fname, flags, 0644)) == -1) {
+		sprintf(message, "Cannot open %s", fname);
+		Error(message);
+		return(access_mode == DFACC_CREATE ? ERR_CREATE : ERR_READ);
+	}
+	if (access_mode == DFACC_CREATE) {
+		if (ftruncate(fd, size) == -1) {
+			sprintf(message, "Cannot set the size of %s to %lu bytes", fname, (unsigned long)size);
+			Error(message);
+			close(fd);
+			return(ERR_CREATE);
+		}
+	}
+	else if (fstat(fd, &st) == -1 || st.st_size != size) {
+		sprintf(message, "File size wrong: %s", fname);
+		Error(message);
+		close(fd);
+		return(ERR_READ);
+	}
+
+	if ((*map = mmap(NULL, size, prot, share, fd, 0)) == MAP_FAILED) {
+		sprintf(message, "Cannot map %s", fname);
+		Error(message);
+		close(fd);
+		*map = NULL;
+		return(access_mode == DFACC_CREATE ? ERR_CREATE : ERR_READ);
+	}
+	close(fd);
+
+	return(0);
+}
+
+void unmap_hls_raw(void *map, size_t size)
+{
+	if (map != NULL)
+		munmap(map, size);
+}
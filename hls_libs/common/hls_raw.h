@@ -0,0 +1,62 @@
+/* Raw intermediate container. Oct 17, 2026.
+ *
+ * The intermediate products passed from one stage to the next (e.g. the S10 from
+ * addFmaskSDS to s2trim and consolidate, and the angles of a twin granule) are
+ * written with deflate by HDF4 and read back in full only minutes later. A file
+ * named with the extension HLS_RAW_EXT is instead kept raw:
+ *
+ *   fname	the image planes, uncompressed in the native byte order, one after
+ *		another, each starting at a multiple of HLS_RAW_ALIGN bytes.
+ *   fname.hdf	a sidecar HDF with no SDS, but the image dimension and all the
+ *		attributes (geolocation and metadata) that would have been set in
+ *		fname with SDsetattr(). The sd_id of the sidecar is used in place of
+ *		the sd_id of an HDF file, so the attribute code is unchanged.
+ *
+ * The planes are mapped with mmap() and used in place: no copy and no decompression
+ * on read, and a stage that changes a few rows (s2trim) only dirties those pages.
+ * The planes and order are those of the product type, e.g. open_s2r(), and the file
+ * size is checked against them. Final products are still HDF-EOS.
+ */
+#ifndef HLS_RAW_H
+#define HLS_RAW_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mfhdf.h"
+#include "util.h"
+#include "hls_commondef.h"
+
+#define HLS_RAW_EXT ".raw"
+#define HLS_RAW_SIDECAR_EXT ".hdf"
+#define HLS_RAW_ALIGN 4096	/* A multiple of the page size on all the platforms used */
+
+/* Sidecar attributes for the image dimension, at the finest pixel size */
+#define HLS_RAW_NROW "RAW_NROW"
+#define HLS_RAW_NCOL "RAW_NCOL"
+
+/* Return 1 if fname is a raw intermediate, by its extension */
+int is_hls_raw(char *fname);
+
+/* Open the sidecar of a raw intermediate with SDstart() in the access mode; FAIL on error.
+ * For DFACC_CREATE, the image dimension is written to it.
+ */
+int32 start_hls_raw_sidecar(char *fname, intn access_mode, int nrow, int ncol);
+
+/* The image dimension from the sidecar */
+int get_hls_raw_dim(char *fname, int *nrow, int *ncol);
+
+/* Lay out nplane planes of planesize bytes (0 for a plane not in the file): set the
+ * offset of each and return the file size.
+ */
+size_t hls_raw_layout(int nplane, size_t *planesize, size_t *offset);
+
+/* Map the file of size bytes. DFACC_CREATE creates the file. DFACC_WRITE maps it shared,
+ * so the changes go to the file. DFACC_READ maps it private: the planes can be changed
+ * in memory, e.g. as a scratch buffer, but the file is not.
+ */
+int map_hls_raw(char *fname, intn access_mode, size_t size, void **map);
+void unmap_hls_raw(void *map, size_t size);
+
+#endif
@@ -48,3 +48,208 @@ double LiSparseR(double sz_deg, double vz_deg, double ra_deg)
 
 	return kernel;
 }
+
+
+#define RTLS_LUT_MAGIC "RTLSLUT1"
+
+int build_rtls_lut(rtls_lut_t *lut)
+{
+	int isz, ivz, ira;
+	long n;
+	double sz, vz, ra;
+
+	lut->dsz = RTLS_LUT_STEP_SZ;
+	lut->dvz = RTLS_LUT_STEP_VZ;
+	lut->dra = RTLS_LUT_STEP_RA;
+	lut->nsz = (int)(RTLS_LUT_SZMAX / lut->dsz + 0.5) + 1;
+	lut->nvz = (int)(RTLS_LUT_VZMAX / lut->dvz + 0.5) + 1;
+	lut->nra = (int)(180.0 / lut->dra + 0.5) + 1;
+
+	lut->kernel = (float*)malloc(sizeof(float) * 2 * lut->nsz * lut->nvz * lut->nra);
+	if (lut->kernel == NULL) {
+		fprintf(stderr, "Cannot allocate memory for the kernel lookup table\n");
+		return(1);
+	}
+
+	for (isz = 0; isz < lut->nsz; isz++) {
+		sz = isz * lut->dsz;
+		for (ivz = 0; ivz < lut->nvz; ivz++) {
+			vz = ivz * lut->dvz;
+			for (ira = 0; ira < lut->nra; ira++) {
+				ra = ira * lut->dra;
+				n = ((long)isz * lut->nvz + ivz) * lut->nra + ira;
+				lut->kernel[2*n]   = RossThick(sz, vz, ra);
+				lut->kernel[2*n+1] = LiSparseR(sz, vz, ra);
+			}
+		}
+	}
+
+	return 0;
+}
+
+int save_rtls_lut(rtls_lut_t *lut, char *fname)
+{
+	FILE *fp;
+	long nnode;
+
+	if ((fp = fopen(fname, "wb")) == NULL) {
+		fprintf(stderr, "Cannot create %s\n", fname);
+		return(1);
+	}
+
+	nnode = (long)lut->nsz * lut->nvz * lut->nra;
+	if (fwrite(RTLS_LUT_MAGIC, 1, strlen(RTLS_LUT_MAGIC), fp) != strlen(RTLS_LUT_MAGIC) ||
+	    fwrite(&lut->nsz, sizeof(int), 1, fp) != 1 ||
+	    fwrite(&lut->nvz, sizeof(int), 1, fp) != 1 ||
+	    fwrite(&lut->nra, sizeof(int), 1, fp) != 1 ||
+	    fwrite(&lut->dsz, sizeof(double), 1, fp) != 1 ||
+	    fwrite(&lut->dvz, sizeof(double), 1, fp) != 1 ||
+	    fwrite(&lut->dra, sizeof(double), 1, fp) != 1 ||
+	    fwrite(lut->kernel, sizeof(float), 2 * nnode, fp) != 2 * nnode) {
+		fprintf(stderr, "Error in writing %s\n", fname);
+		fclose(fp);
+		return(1);
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+int load_rtls_lut(rtls_lut_t *lut, char *fname)
+{
+	FILE *fp;
+	char magic[20];
+	long nnode;
+
+	lut->kernel = NULL;
+	if ((fp = fopen(fname, "rb")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", fname);
+		return(1);
+	}
+
+	if (fread(magic, 1, strlen(RTLS_LUT_MAGIC), fp) != strlen(RTLS_LUT_MAGIC) ||
+	    strncmp(magic, RTLS_LUT_MAGIC, strlen(RTLS_LUT_MAGIC)) != 0 ||
+	    fread(&lut->nsz, sizeof(int), 1, fp) != 1 ||
+	    fread(&lut->nvz, sizeof(int), 1, fp) != 1 ||
+	    fread(&lut->nra, sizeof(int), 1, fp) != 1 ||
+	    fread(&lut->dsz, sizeof(double), 1, fp) != 1 ||
+	    fread(&lut->dvz, sizeof(double), 1, fp) != 1 ||
+	    fread(&lut->dra, sizeof(double), 1, fp) != 1) {
+		fprintf(stderr, "Not a kernel lookup table: %s\n", fname);
+		fclose(fp);
+		return(1);
+	}
+
+	/* A table made with a different spacing or domain is rebuilt */
+	if (lut->dsz != RTLS_LUT_STEP_SZ || lut->dvz != RTLS_LUT_STEP_VZ || lut->dra != RTLS_LUT_STEP_RA ||
+	    (lut->nsz - 1) * lut->dsz < RTLS_LUT_SZMAX || (lut->nvz - 1) * lut->dvz < RTLS_LUT_VZMAX ||
+	    (lut->nra - 1) * lut->dra < 180.0) {
+		fprintf(stderr, "Kernel lookup table %s does not match this code\n", fname);
+		fclose(fp);
+		return(1);
+	}
+
+	nnode = (long)lut->nsz * lut->nvz * lut->nra;
+	if ((lut->kernel = (float*)malloc(sizeof(float) * 2 * nnode)) == NULL) {
+		fprintf(stderr, "Cannot allocate memory for the kernel lookup table\n");
+		fclose(fp);
+		return(1);
+	}
+	if (fread(lut->kernel, sizeof(float), 2 * nnode, fp) != 2 * nnode) {
+		fprintf(stderr, "Error in reading %s\n", fname);
+		free(lut->kernel);
+		lut->kernel = NULL;
+		fclose(fp);
+		return(1);
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+int get_rtls_lut(rtls_lut_t *lut, char *fname)
+{
+	FILE *fp;
+
+	if ((fp = fopen(fname, "rb")) != NULL) {
+		fclose(fp);
+		if (load_rtls_lut(lut, fname) == 0)
+			return 0;
+	}
+
+	if (build_rtls_lut(lut) != 0)
+		return(1);
+
+	/* Not fatal; the table is only rebuilt next time */
+	if (save_rtls_lut(lut, fname) != 0)
+		fprintf(stderr, "Kernel lookup table not cached in %s\n", fname);
+
+	return 0;
+}
+
+void free_rtls_lut(rtls_lut_t *lut)
+{
+	if (lut->kernel != NULL) {
+		free(lut->kernel);
+		lut->kernel = NULL;
+	}
+}
+
+void rtls_lut_kernel(rtls_lut_t *lut, double sz_deg, double vz_deg, double ra_deg, 
+			double *rossthick, double *lisparseR)
+{
+	double x, y, z;		/* Position in node spacing */
+	double fx, fy, fz;
+	int isz, ivz, ira;
+	long n00, n01, n10, n11;	/* Nodes at (isz, ivz), (isz, ivz+1), ... for ira */
+	long dn;		/* Node offset of one step in sz */
+	float *k;
+	double c00, c01, c10, c11, c0, c1;
+
+	ra_deg = fabs(fmod(ra_deg, 360.0));
+	if (ra_deg > 180)
+		ra_deg = 360 - ra_deg;
+
+	x = sz_deg / lut->dsz;
+	y = vz_deg / lut->dvz;
+	z = ra_deg / lut->dra;
+	isz = (int)x;
+	ivz = (int)y;
+	ira = (int)z;
+	if (sz_deg < vz_deg + RTLS_LUT_HOTSPOT || vz_deg < 0 || 
+	    isz >= lut->nsz - 1 || ivz >= lut->nvz - 1) {
+		*rossthick = RossThick(sz_deg, vz_deg, ra_deg);
+		*lisparseR = LiSparseR(sz_deg, vz_deg, ra_deg);
+		return;
+	}
+	if (ira >= lut->nra - 1)	/* ra of 180 */
+		ira = lut->nra - 2;
+	fx = x - isz;
+	fy = y - ivz;
+	fz = z - ira;
+
+	dn = (long)lut->nvz * lut->nra;
+	n00 = ((long)isz * lut->nvz + ivz) * lut->nra + ira;
+	n01 = n00 + lut->nra;
+	n10 = n00 + dn;
+	n11 = n01 + dn;
+
+	/* RossThick, then LiSparseR */
+	k = lut->kernel;
+	c00 = k[2*n00] + fz * (k[2*(n00+1)] - k[2*n00]);
+	c01 = k[2*n01] + fz * (k[2*(n01+1)] - k[2*n01]);
+	c10 = k[2*n10] + fz * (k[2*(n10+1)] - k[2*n10]);
+	c11 = k[2*n11] + fz * (k[2*(n11+1)] - k[2*n11]);
+	c0 = c00 + fy * (c01 - c00);
+	c1 = c10 + fy * (c11 - c10);
+	*rossthick = c0 + fx * (c1 - c0);
+
+	k = lut->kernel + 1;
+	c00 = k[2*n00] + fz * (k[2*(n00+1)] - k[2*n00]);
+	c01 = k[2*n01] + fz * (k[2*(n01+1)] - k[2*n01]);
+	c10 = k[2*n10] + fz * (k[2*(n10+1)] - k[2*n10]);
+	c11 = k[2*n11] + fz * (k[2*(n11+1)] - k[2*n11]);
+	c0 = c00 + fy * (c01 - c00);
+	c1 = c10 + fy * (c11 - c10);
+	*lisparseR = c0 + fx * (c1 - c0);
+}
@@ -1,8 +1,10 @@
 #ifndef RTLS_H
 #define RTLS_H
 
+#include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef pi	/* GCTP uses PI */
 #define pi 3.141592653589
@@ -13,4 +15,61 @@
 double RossThick(double sz_deg, double vz_deg, double ra_deg);
 double LiSparseR(double sz_deg, double vz_deg, double ra_deg);
 
+
+/* Lookup table of the two kernels over (sz, vz, ra), with trilinear interpolation.
+ * Oct 17, 2026.
+ *
+ * The kernels depend on the relative azimuth only through cos(ra) and sin(ra)^2,
+ * so ra is folded into [0, 180]. The nodes are at RTLS_LUT_STEP_SZ, RTLS_LUT_STEP_VZ,
+ * and RTLS_LUT_STEP_RA degrees, for sz in [0, RTLS_LUT_SZMAX] and vz in 
+ * [0, RTLS_LUT_VZMAX]; the table takes about 28 MB.
+ *
+ * LiSparseR has a cusp at the hot spot (sz == vz, ra == 0) and gets steep towards
+ * large solar zenith, where interpolation is poor. So rtls_lut_kernel() evaluates 
+ * the analytic kernels for sz < vz + RTLS_LUT_HOTSPOT, and outside the table.
+ *
+ * Error bound, measured against the analytic kernels on 2 million random angles 
+ * quantized to 0.01 degree (as in s2ang_t) over the domain where the table is used.
+ * The largest errors seen over several samples are in parentheses; the bound has a 
+ * small margin and is checked by derive_s2nbar/check_rtls_lut.c:
+ * 	RossThick	max abs error 1.0e-5 (9.6e-6)
+ * 	LiSparseR	max abs error 5.5e-4 (5.2e-4, at sz near 80)
+ * 	NBAR ratio	max relative error 2.0e-4 (1.7e-4) for all nine sets of MODIS 
+ * 			coefficients, i.e. under 2 in the scaled reflectance of 10000.
+ */
+#define RTLS_LUT_SZMAX	80.0
+#define RTLS_LUT_VZMAX	15.0
+#define RTLS_LUT_STEP_SZ 0.25
+#define RTLS_LUT_STEP_VZ 0.25
+#define RTLS_LUT_STEP_RA 1.0
+#define RTLS_LUT_HOTSPOT 5.0
+
+typedef struct {
+	int nsz;		/* Number of nodes in each dimension */
+	int nvz;
+	int nra;
+	double dsz;		/* Node spacing in degree */
+	double dvz;
+	double dra;
+	float *kernel;		/* RossThick and LiSparseR at node [isz][ivz][ira] are at
+				 * kernel[2n] and kernel[2n+1], n = (isz*nvz + ivz)*nra + ira
+				 */
+} rtls_lut_t;
+
+/* Evaluate the analytic kernels at the nodes */
+int build_rtls_lut(rtls_lut_t *lut);
+
+/* Cache the table in a binary file for later processes */
+int save_rtls_lut(rtls_lut_t *lut, char *fname);
+int load_rtls_lut(rtls_lut_t *lut, char *fname);
+
+/* Load the table from fname if the file exists; otherwise build and save it */
+int get_rtls_lut(rtls_lut_t *lut, char *fname);
+
+void free_rtls_lut(rtls_lut_t *lut);
+
+/* Kernel values from the table, or analytic outside the table domain */
+void rtls_lut_kernel(rtls_lut_t *lut, double sz_deg, double vz_deg, double ra_deg, 
+			double *rossthick, double *lisparseR);
+
 #endif
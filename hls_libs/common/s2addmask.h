@@ -0,0 +1,26 @@
+/* Derive the S10 ACmask and Fmask SDS.
+ *
+ * ACmask is derived from the CLOUD SDS of the atmospheric correction;
+ * Fmask is read from the 20m Fmask result in flat binary, dilated by 7 
+ * pixels, and oversampled to 10m, with bits 7-6 from the USGS aerosol QA.
+ *
+ * Moved from addFmaskSDS.c so that hls_s2_pipeline can add the masks in
+ * memory. Oct 17, 2026
+ */
+#ifndef S2ADDMASK_H
+#define S2ADDMASK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "dilation.h"
+#include "s2r.h"
+#include "util.h"
+
+/* s2in->accloud is the input CLOUD SDS; s2out->acmask and s2out->fmask are set.
+ * s2in and s2out can be the same image.
+ */
+int add_s2mask(s2r_t *s2in, char *fname_fmask, char *fname_aeroQA, s2r_t *s2out);
+
+#endif
@@ -2,6 +2,12 @@
 #include "s2r.h"
 #include "error.h"
 #include "math.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int map_s2ang_raw(s2ang_t *s2ang);
 
 /* open S2 angles for read or create*/
 int open_s2ang(s2ang_t *s2ang, intn access_mode) 
@@ -14,25 +20,38 @@ int open_s2ang(s2ang_t *s2ang, intn access_mode)
 	int32 dimsizes[2];
 	int32 rank, data_type, n_attrs;
 	int32 start[2], edge[2];
-	int ib;
+	int ib, ret;
 
 	char message[MSGLEN];
 
 	for (ib = 0; ib < NANG; ib++)
 		s2ang->ang[ib] = NULL;
 	s2ang->access_mode = access_mode;
+	s2ang->raw_map = NULL;
 
 	/* For DFACC_READ, find the image dimension from band 1.
 	 * For DFACC_CREATE, image dimension is given. 
 	 */
 	if (s2ang->access_mode == DFACC_READ) {
-		if ((s2ang->sd_id = SDstart(s2ang->fname, s2ang->access_mode)) == FAIL) {
+		/* Oct 17, 2026: The angles of a raw intermediate are mapped, and the attributes 
+		 * are in the sidecar.
+		 */
+		if (is_hls_raw(s2ang->fname)) {
+			if (get_hls_raw_dim(s2ang->fname, &s2ang->nrow, &s2ang->ncol) != 0)
+				return(ERR_READ);
+			if ((ret = map_s2ang_raw(s2ang)) != 0)
+				return(ret);
+			s2ang->sd_id = start_hls_raw_sidecar(s2ang->fname, s2ang->access_mode, 0, 0);
+		}
+		else
+			s2ang->sd_id = SDstart(s2ang->fname, s2ang->access_mode);
+		if (s2ang->sd_id == FAIL) {
 			sprintf(message, "Cannot open for read: %s", s2ang->fname);
 			Error(message);
 			return(ERR_CREATE);
 		}
 
-		for (ib = 0; ib < NANG; ib++) {
+		for (ib = 0; ib < NANG && s2ang->raw_map == NULL; ib++) {
 			if ((sds_index = SDnametoindex(s2ang->sd_id, ANG_SDS_NAME[ib])) == FAIL) {
 				sprintf(message, "Didn't find the SDS %s in %s", ANG_SDS_NAME[ib], s2ang->fname);
 				Error(message);
@@ -110,14 +129,27 @@ int open_s2ang(s2ang_t *s2ang, intn access_mode)
 
 
 		SDend(s2ang->sd_id);
+		s2ang->sd_id = FAIL;
+	}
+	else if (s2ang->access_mode == DFACC_CREATE && is_hls_raw(s2ang->fname)) {
+		long k;
+
+		if ((ret = map_s2ang_raw(s2ang)) != 0)
+			return(ret);
+		if ((s2ang->sd_id = start_hls_raw_sidecar(s2ang->fname, DFACC_CREATE, s2ang->nrow, s2ang->ncol)) == FAIL)
+			return(ERR_CREATE);
+		for (ib = 0; ib < NANG; ib++) {
+			for (k = 0; k < (long)s2ang->nrow * s2ang->ncol; k++)
+				s2ang->ang[ib][k] = ANGFILL;
+		}
+
+		SDsetattr(s2ang->sd_id, ULX, DFNT_FLOAT64, 1, (VOIDP)&s2ang->ulx);
+		SDsetattr(s2ang->sd_id, ULY, DFNT_FLOAT64, 1, (VOIDP)&s2ang->uly);
+		SDsetattr(s2ang->sd_id, ZONEHEM, DFNT_CHAR8, strlen(s2ang->zonehem), (VOIDP)s2ang->zonehem);
 	}
 	else if (s2ang->access_mode == DFACC_CREATE) {
 		int irow, icol;
 		char *dimnames[] = {"YDim_Grid", "XDim_Grid"};
-		int32 comp_type;   /*Compression flag*/
-		comp_info c_info;  /*Compression structure*/
-		comp_type = COMP_CODE_DEFLATE;
-		c_info.deflate.level = 2;     /*Level 9 would be too slow */
 		rank = 2;
 
 		if ((s2ang->sd_id = SDstart(s2ang->fname, s2ang->access_mode)) == FAIL) {
@@ -146,7 +178,7 @@ int open_s2ang(s2ang_t *s2ang, intn access_mode)
 			}
 			PutSDSDimInfo(s2ang->sds_id[ib], dimnames[0], 0);
 			PutSDSDimInfo(s2ang->sds_id[ib], dimnames[1], 1);
-			SDsetcompress(s2ang->sds_id[ib], comp_type, &c_info);	
+			SetSDSChunkDeflate(s2ang->sds_id[ib], s2ang->nrow, s2ang->ncol, HLS_CHUNK_NROW);	
 			SDsetattr(s2ang->sds_id[ib], "_FillValue", DFNT_CHAR8, strlen(ang_fillval), (VOIDP)ang_fillval);
 			SDsetattr(s2ang->sds_id[ib], "scale_factor", DFNT_CHAR8, strlen(ang_scale_factor), (VOIDP)ang_scale_factor); 
 			SDsetattr(s2ang->sds_id[ib], "add_offset", DFNT_CHAR8, strlen(ang_add_offset), (VOIDP)ang_add_offset); 
@@ -161,35 +193,245 @@ int open_s2ang(s2ang_t *s2ang, intn access_mode)
 	return 0;
 } 
 
+/* Map a raw intermediate of the four angles, and point the angles into the map */
+static int map_s2ang_raw(s2ang_t *s2ang)
+{
+	size_t planesize[NANG], offset[NANG];
+	int ib, ret;
+
+	for (ib = 0; ib < NANG; ib++)
+		planesize[ib] = (size_t)s2ang->nrow * s2ang->ncol * sizeof(uint16);
+	s2ang->raw_size = hls_raw_layout(NANG, planesize, offset);
+
+	if ((ret = map_hls_raw(s2ang->fname, s2ang->access_mode, s2ang->raw_size, (void**)&s2ang->raw_map)) != 0)
+		return(ret);
+	for (ib = 0; ib < NANG; ib++)
+		s2ang->ang[ib] = (uint16*)(s2ang->raw_map + offset[ib]);
+
+	return 0;
+}
+
+
+
+static void reset_detang(uint16 *tmpang, int nrow, int ncol, int *rcgrid, detspan_t *span);
+static void cut_detang(uint16 *ang, uint16 *tmpang, s2detfoo_t *s2detfoo, int detid, detspan_t *span);
+
+/* Find a tag in [p, end). Return a pointer to the tag, or NULL if not found. */
+static char *find_tag(char *p, char *end, char *tag)
+{
+	size_t len = strlen(tag);
+
+	while (p != NULL && (size_t)(end - p) >= len) {
+		if ((p = memchr(p, tag[0], end - p - len + 1)) == NULL)
+			return NULL;
+		if (memcmp(p, tag, len) == 0)
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+/* Decode the 23 x 23 values of an angle grid, e.g.
+ *	<Zenith>
+ *	  <COL_STEP unit="m">5000</COL_STEP>
+ *	  <ROW_STEP unit="m">5000</ROW_STEP>
+ *	  <Values_List>
+ *	    <VALUES>3.16347 3.19559 3.2289 3.26041 NaN NaN ... 3.90644</VALUES>
+ *	    ...
+ *	  </Values_List>
+ *	</Zenith>
+ * where the angle is Zenith or Azimuth given by tag, and the block is within [p, end).
+ * NaN is decoded as NaN.  Return a pointer past the block, or NULL if the format is wrong.
+ */
+static char *read_anggrid_values(char *p, char *end, char *tag, double val[N5KM][N5KM])
+{
+	char endtag[50];
+	char *blkend, *rowend, *q;
+	int irow, icol;
+
+	sprintf(endtag, "</%s", tag+1);
+	if ((p = find_tag(p, end, tag)) == NULL || 
+	    (blkend = find_tag(p, end, endtag)) == NULL ||
+	    (p = find_tag(p, blkend, "<Values_List>")) == NULL)
+		return NULL;
+
+	for (irow = 0; irow < N5KM; irow++) {
+		if ((p = find_tag(p, blkend, "<VALUES>")) == NULL ||
+		    (rowend = find_tag(p, blkend, "</VALUES>")) == NULL)
+			return NULL;
+		p += strlen("<VALUES>");
+		for (icol = 0; icol < N5KM; icol++) {
+			/* strtod() stops at the '<' of </VALUES> at the latest */
+			val[irow][icol] = strtod(p, &q);
+			if (q == p || q > rowend)
+				return NULL;
+			p = q;
+		}
+		p = rowend;
+	}
+
+	return blkend + strlen(endtag);
+}
+
+/* Set all the values of the 5km grids to NaN */
+static void reset_s2anggrid(s2anggrid_t *grid)
+{
+	int irow, icol, id;
+
+	for (irow = 0; irow < N5KM; irow++) {
+		for (icol = 0; icol < N5KM; icol++) {
+			grid->sz[irow][icol] = grid->sa[irow][icol] = NAN;
+			for (id = 0; id <= NDETECTOR; id++) 
+				grid->vz[id][irow][icol] = grid->va[id][irow][icol] = NAN;
+		}
+	}
+}
+
+/* Read the 5km sun and B06 view angle grids from the granule xml (MTD_TL.xml).
+ * Return 101 if the xml format is wrong; the grids are then all NaN, not partly read.
+ *
+ * Oct 17, 2026: The xml used to be read line by line and value by value with fscanf, 
+ * for the view angles of all the 13 bands, and the format was checked by counting lines.
+ * Now the file is mapped into memory, and the grids are found by their tags. The blocks 
+ * for the bands other than B06 are skipped without decoding the values.
+ */
+int read_s2anggrid(char *fname_xml, s2anggrid_t *grid)
+{
+	int fd;
+	struct stat st;
+	char *buf, *end, *p, *q, *tagend;
+	char *blkbeg, *blkend;
+	int bandid, detid;
+	char message[MSGLEN];
+	int ret = 0;
+
+	reset_s2anggrid(grid);
+
+	if ((fd = open(fname_xml, O_RDONLY)) == -1) {
+		sprintf(message, "Cannot read %s", fname_xml);
+		Error(message);
+		return(-1);
+	}
+	if (fstat(fd, &st) == -1) {
+		sprintf(message, "Cannot read %s", fname_xml);
+		Error(message);
+		close(fd);
+		return(-1);
+	}
+	if ((buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		sprintf(message, "Cannot map %s", fname_xml);
+		Error(message);
+		close(fd);
+		return(-1);
+	}
+	close(fd);
+	end = buf + st.st_size;
+
+	/* Sun angles, same for all bands */
+	if ((blkbeg = find_tag(buf, end, "<Sun_Angles_Grid>")) == NULL ||
+	    (blkend = find_tag(blkbeg, end, "</Sun_Angles_Grid>")) == NULL ||
+	    (p = read_anggrid_values(blkbeg, blkend, "<Zenith>", grid->sz)) == NULL ||
+	    (p = read_anggrid_values(p, blkend, "<Azimuth>", grid->sa)) == NULL) {
+		sprintf(message, "Format is not as expected for the sun angles: %s", fname_xml);
+		Error(message);
+		ret = 101;
+		goto done;
+	}
+
+	/* View angles for each band and each detector, e.g. 
+	 *	<Viewing_Incidence_Angles_Grids bandId="5" detectorId="8">
+	 * Sep 7, 2020: Now only derive for B06, whose bandId is 5. Use the angle data for all bands 
+	 */
+	p = blkend;
+	while ((blkbeg = find_tag(p, end, "<Viewing_Incidence_Angles_Grids ")) != NULL) {
+		if ((tagend = memchr(blkbeg, '>', end - blkbeg)) == NULL ||
+		    (blkend = find_tag(tagend, end, "</Viewing_Incidence_Angles_Grids>")) == NULL ||
+		    (q = find_tag(blkbeg, tagend, "bandId=\"")) == NULL) {
+			sprintf(message, "Format is not as expected: %s", fname_xml);
+			Error(message);
+			ret = 101;
+			goto done;
+		}
+		p = blkend;
+
+		bandid = atoi(q + strlen("bandId=\""));		/* bandId is 0-based*/
+		if (bandid != 5) 	/* Use the 2nd red-edge band */
+			continue;
 
+		q = find_tag(blkbeg, tagend, "detectorId=\"");	/* 1-based */
+		detid = q ? atoi(q + strlen("detectorId=\"")) : 0;
+		if (detid < 1 || detid > NDETECTOR ||
+		    read_anggrid_values(tagend, blkend, "<Zenith>", grid->vz[detid]) == NULL ||
+		    read_anggrid_values(tagend, blkend, "<Azimuth>", grid->va[detid]) == NULL) {
+			sprintf(message, "Format is not as expected for bandId %d, detectorId %d: %s", bandid, detid, fname_xml);
+			Error(message);
+			ret = 101;
+			goto done;
+		}
+	}
 
+done:
+	munmap(buf, st.st_size);
+	if (ret != 0)
+		reset_s2anggrid(grid);
+	return(ret);
+}
 
 /* Read the 5km angle values and interpolate them to finer resolution */
 /* Return 101 if the xml format is wrong. May 1, 2017 */
 int make_smooth_s2ang(s2ang_t *s2ang, s2detfoo_t *s2detfoo, char *fname_xml)
 {
-	FILE *fxml;
-	char line[500];
-	char *pos;
-	double val;
-	int bandid, detid;
-	char str[200]; 	/* Used in read the text file */
-	int irow, icol, i, k;
-	int irow5km, icol5km; 
+	s2anggrid_t *grid;
+	int ret;
+
+	if ((grid = (s2anggrid_t*)malloc(sizeof(s2anggrid_t))) == NULL) {
+		Error("Cannot allocate memory");
+		return(-1);
+	}
+
+	ret = read_s2anggrid(fname_xml, grid);
+	if (ret == 0) 
+		ret = smooth_s2anggrid(s2ang, s2detfoo, grid);
+
+	free(grid);
+	return(ret);
+}
+
+/* Place the values of a 5km grid in the fine-resolution image. NaN is not placed, so the
+ * pixel keeps the fill value.  Return the number of non-NaN values.
+ */
+static int place_anggrid(uint16 *ang, int ncol, int *rcgrid, double val[N5KM][N5KM])
+{
+	int irow5km, icol5km;
+	int n = 0;
+
+	for (irow5km = 0; irow5km < N5KM; irow5km++) {
+		for (icol5km = 0; icol5km < N5KM; icol5km++) {
+			if (isnan(val[irow5km][icol5km]))
+				continue;
+			ang[rcgrid[irow5km] * ncol + rcgrid[icol5km]] = val[irow5km][icol5km] * 100;
+			n++;
+		}
+	}
+	return n;
+}
+
+/* Interpolate the 5km angle grids to finer resolution */
+int smooth_s2anggrid(s2ang_t *s2ang, s2detfoo_t *s2detfoo, s2anggrid_t *grid)
+{
+	int irow, icol, i;
+	int detid, iang;
 	int rcgrid[N5KM];	/* row/col of ANGPIXSZ-meter pixels that contain the GML 5km values */
 	int ret;
-	int detector_has_data;
 	char message[MSGLEN];
+	detspan_t span[NDETECTOR+1];	/* Where each detector is in the footprint image */
+	double (*val)[N5KM];
 
 	uint16 *tmpang;
 	if ((tmpang = (uint16*)calloc(s2ang->nrow * s2ang->ncol, sizeof(uint16))) == NULL) {
 		Error("Cannot allocate memory");
 		return(-1);
 	}
-	for (irow = 0; irow < s2ang->nrow; irow++) {
-		for (icol = 0; icol < s2ang->ncol; icol++) 
-			tmpang[irow * s2ang->ncol + icol] = ANGFILL;
-	}
 
 	/* Where to put the 5km grid point values in the ANGPIXSZ-meter (30m) grid.
 	 * Note that the 5km values are not strictly evenly spaced in the finer-reso grid
@@ -202,262 +444,122 @@ int make_smooth_s2ang(s2ang_t *s2ang, s2detfoo_t *s2detfoo, char *fname_xml)
 			rcgrid[i] = s2ang->nrow-1; 
 	}
 
-	/* The granule's xml */
-	if ((fxml = fopen(fname_xml, "r")) == NULL) {
-		sprintf(message, "Cannot read %s", fname_xml);
-		Error(message);
+	/* Sun angles. Solar zenith and azimuth are interpolated together, since they
+	 * are given at the same 5km points. */
+	for (irow = 0; irow < s2ang->nrow; irow++) {
+		for (icol = 0; icol < s2ang->ncol; icol++) 
+			s2ang->ang[0][irow * s2ang->ncol + icol] = s2ang->ang[1][irow * s2ang->ncol + icol] = ANGFILL;
+	}
+	place_anggrid(s2ang->ang[0], s2ang->ncol, rcgrid, grid->sz);
+	place_anggrid(s2ang->ang[1], s2ang->ncol, rcgrid, grid->sa);
+	ret = interp_s2ang_bilinear_n(s2ang->ang, 2, s2ang->nrow, s2ang->ncol, NULL);
+	if (ret != 0) {
+		Error("Error in interp_s2ang_bilinear for the sun angles");
+		free(tmpang);
 		return(-1);
 	}
-	while (fgets(line, sizeof(line), fxml)) {
 
-		/* Sun angles, same for all bands */
-		if (strstr(line, "<Sun_Angles_Grid>")) {
-			fgets(line, sizeof(line), fxml);
-			if (strstr(line, "<Zenith>") == NULL) {
-				sprintf(message, "Format is not as expected: %s", fname_xml);
-				Error(message);
-				exit(1);
-			}
-
-			/*** Solar zenith ***/
-			fgets(line, sizeof(line), fxml); /* <COL_STEP unit="m">5000</COL_STEP> */
-			fgets(line, sizeof(line), fxml); /* <ROW_STEP unit="m">5000</ROW_STEP> */
-			fgets(line, sizeof(line), fxml); /* <Values_List> */
-
-			/* Read the 5km values to save at the finer-resolution location (i.e. ANGPIXSZ meter) */
-			for (irow5km = 0; irow5km < N5KM; irow5km++) {
-				irow = rcgrid[irow5km]; 	
-				for (icol5km = 0; icol5km < N5KM; icol5km++) {
-					icol = rcgrid[icol5km]; 
-					k = irow * s2ang->ncol + icol;
-					fscanf(fxml, "%s", str);
-					if (icol5km == 0)
-						val = atof(str+strlen("<VALUES>"));
-					else 	
-						val = atof(str);
-
-					s2ang->ang[0][k] = val * 100;
-				}
-			}
+	/* Oct 17, 2026: The view angles of a detector are only computed within the detector's 
+	 * footprint, instead of over the whole tile and then cookie-cut with the footprint. 
+	 */
+	if (index_s2detfoo(s2detfoo, span) != 0) {
+		Error("Error in index_s2detfoo");
+		free(tmpang);
+		return(-1);
+	}
 
+	/* View zenith and azimuth of each detector of B06. If a detector's footprint is not on the 
+	 * tile, some processing baselines still gave the angles for the detector (of course all NaN).
+	 */
+	for (detid = 1; detid <= NDETECTOR; detid++) {
+		if (span[detid].rowbeg == -1)	/* Not in the footprint image */
+			continue;
 
-			/* interp */
-			ret = interp_s2ang_bilinear(s2ang->ang[0], s2ang->nrow, s2ang->ncol);
-			if (ret != 0) {
-				sprintf(message, "Error in interp_s2ang_bilinear for %s", fname_xml);
-				Error(message);
-				return(-1);
-			}
+		for (iang = 2; iang <= 3; iang++) {
+			val = iang == 2 ? grid->vz[detid] : grid->va[detid];
 
-			/*** Solar azimuth***/
-			fgets(line, sizeof(line), fxml);	/* There is a "\n" trailing "</VALUES>" unread by fscanf*/
-			fgets(line, sizeof(line), fxml);	/* </Values_List> */
-			fgets(line, sizeof(line), fxml);	/* </Zenith> */
-			fgets(line, sizeof(line), fxml);	/* <Azimuth> */
-			if (strstr(line, "<Azimuth>") == NULL) {	/* Good that I checked */
-				sprintf(message, "Format is not as expected: %s", fname_xml);
-				Error(message);
-				exit(1);
-			}
-			fgets(line, sizeof(line), fxml); /* <COL_STEP unit="m">5000</COL_STEP> */
-			fgets(line, sizeof(line), fxml); /* <ROW_STEP unit="m">5000</ROW_STEP> */
-			fgets(line, sizeof(line), fxml); /* <Values_List> */
-			//fprintf(stderr, "%s\n", line);
-			
-			for (irow5km = 0; irow5km < N5KM; irow5km++) {
-				irow = rcgrid[irow5km]; 	
-				for (icol5km = 0; icol5km < N5KM; icol5km++) {
-					icol = rcgrid[icol5km]; 
-					k = irow * s2ang->ncol + icol;
-					fscanf(fxml, "%s", str);
-					if (icol5km == 0)
-						val = atof(str+strlen("<VALUES>"));
-					else 	
-						val = atof(str);
-
-					s2ang->ang[1][k] = val * 100;
-				}
-			}
+			reset_detang(tmpang, s2ang->nrow, s2ang->ncol, rcgrid, &span[detid]);
+			if (place_anggrid(tmpang, s2ang->ncol, rcgrid, val) == 0)
+				continue;
 
 			/* interp */
-			ret = interp_s2ang_bilinear(s2ang->ang[1], s2ang->nrow, s2ang->ncol);
+			ret = interp_s2ang_bilinear_n(&tmpang, 1, s2ang->nrow, s2ang->ncol, &span[detid]);
 			if (ret != 0) {
-				sprintf(message, "Error in interp_s2ang_bilinear for %s", fname_xml);
+				sprintf(message, "Error in interp_s2ang_bilinear for detectorId %d", detid);
 				Error(message);
+				free(tmpang);
+				free_detspan(span);
 				return(-1);
 			}
+			/* Cookiecut with the footprint */
+			cut_detang(s2ang->ang[iang], tmpang, s2detfoo, detid, &span[detid]);
 		}
+	}
 
+	free(tmpang);
+	free_detspan(span);
 
-		/* View angles for each band and each detector*/
-		/* For each band, the view zenith and view azimuth angles are given one detector after another. */
-		/* Sep 7, 2020: Now only derive for B06, whose bandId is 5. Use the angle data for all bands */
-		if (strstr(line, "<Viewing_Incidence_Angles_Grids bandId=")) {
-			pos = strstr(line, "bandId=\"");
-			bandid = atoi(pos+strlen("bandId=\""));		/* bandId is 0-based*/
-			pos = strstr(line, "detectorId=\"");	/* 1-based; not used in indexing */
-			detid = atoi(pos+ strlen("detectorId=\""));
-			fgets(line, sizeof(line), fxml);	/* <Zenith> */
-			if (strstr(line, "<Zenith>") == NULL) {
-				sprintf(message, "Format is not as expected: %s", fname_xml);
-				Error(message);
-				exit(1);
-			}
+	return 0;
+}
 
-			/*** View Zenith ***/
-			fgets(line, sizeof(line), fxml); /* <COL_STEP unit="m">5000</COL_STEP> */
-			fgets(line, sizeof(line), fxml); /* <ROW_STEP unit="m">5000</ROW_STEP> */
-			fgets(line, sizeof(line), fxml); /* <Values_List> */
-
-			/* May 1, 2017: When the information is not available it can be:
-			 <COL_STEP unit="m">0</COL_STEP>
-          		 <ROW_STEP unit="m">0</ROW_STEP>
-          		 <Values_List>
-            		   <VALUES>0</VALUES>
-            		   <VALUES>0</VALUES>
-			*/
-
-			/* Init */
-			/* If a detector's footprint is not on the tile, some processing baselines still gave
-			 * the angles for the detector (of course all NaN).
-			 */
-			detector_has_data = 0;
-			for (irow = 0; irow < s2ang->nrow; irow++) {
-				for (icol = 0; icol < s2ang->ncol; icol++) 
-					tmpang[irow * s2ang->ncol + icol] = ANGFILL;
-			}
-			for (irow5km = 0; irow5km < N5KM; irow5km++) {
-				irow = rcgrid[irow5km];  /* the fine-resolution rows in which 5km values are available. */ 
-				for (icol5km = 0; icol5km < N5KM; icol5km++) {
-					icol = rcgrid[icol5km]; /* The fine-reso cols where 5km values avail. */ 
-					k = irow * s2ang->ncol + icol;
-
-					/* No matter what, scan it first (consume the data in the stream). */
-					fscanf(fxml, "%s", str);
-
-					if (icol5km == 0) {
-						if (strncmp(str, "<VALUES>", strlen("<VALUES>")) != 0) {
-							sprintf(message,"irow5km = %d, xml format wrong, or is not read correctly: %s\n", irow5km, fname_xml);
-							Error(message);
-							exit(101);
-						}
-
-						if (strstr(str, "NaN")) 
-							val = ANGFILL;
-						else 
-							val = atof(str+strlen("<VALUES>"));
-					}
-					else {	
-						if (strstr(str, "NaN"))
-							val = ANGFILL;
-						else
-							val = atof(str);
-					}
-
-
-					if (val != ANGFILL) {
-						tmpang[k] = val * 100;
-						detector_has_data = 1;
-					}
-				}
-			}
-			fgets(line, sizeof(line), fxml);	/* There is a "\n" trailing "</VALUES>" */
-			fgets(line, sizeof(line), fxml);	/* </Values_List> */
-			fgets(line, sizeof(line), fxml);	/* </Zenith> */
-			if (bandid == 5 && detector_has_data) {		/* Use the 2nd red-edge band */
-				/* interp */
-				ret = interp_s2ang_bilinear(tmpang, s2ang->nrow, s2ang->ncol);
-				if (ret != 0) {
-					sprintf(message, "Error in interp_s2ang_bilinear for bandId %d, detectorId %d: %s", bandid, detid, fname_xml);
-					Error(message);
-					return(-1);
-				}
-				/* Cookiecut with the footprint */
-				for (irow = 0; irow < s2ang->nrow; irow++) {
-					for (icol = 0; icol < s2ang->ncol; icol++) {
-						k = irow * s2ang->ncol + icol;
-						if (detid == s2detfoo->detid[k])
-							s2ang->ang[2][k] = tmpang[k];
-
-					}
-				}
-			}
+/* Set the angle image of a detector to fill before the 5km values are read in, where 
+ * the interpolation will read or write: the rows holding the 5km data, and the span 
+ * of the detector. The whole image if span is NULL.
+ */
+static void reset_detang(uint16 *tmpang, int nrow, int ncol, int *rcgrid, detspan_t *span)
+{
+	int irow, icol, irow5km;
+	long k;
 
+	if (span == NULL) {
+		for (k = 0; k < (long)nrow * ncol; k++) 
+			tmpang[k] = ANGFILL;
+		return;
+	}
 
-			/*** View Azimuth ***/
-			fgets(line, sizeof(line), fxml);	/* <Azimuth> */
-			if (strstr(line, "<Azimuth>") == NULL) {	/* Good that I checked */
-				sprintf(message, "Format is not as expected: %s", fname_xml);
-				Error(message);
-				exit(1);
-			}
-			fgets(line, sizeof(line), fxml); /* <COL_STEP unit="m">5000</COL_STEP> */
-			fgets(line, sizeof(line), fxml); /* <ROW_STEP unit="m">5000</ROW_STEP> */
-			fgets(line, sizeof(line), fxml); /* <Values_List> */
-			
-			/* Init */
-			detector_has_data = 0;
-			for (irow = 0; irow < s2ang->nrow; irow++) {
-				for (icol = 0; icol < s2ang->ncol; icol++) 
-					tmpang[irow * s2ang->ncol + icol] = ANGFILL;
-			}
-			for (irow5km = 0; irow5km < N5KM; irow5km++) {
-				irow = rcgrid[irow5km]; 	
-				for (icol5km = 0; icol5km < N5KM; icol5km++) {
-					icol = rcgrid[icol5km]; 
-					k = irow * s2ang->ncol + icol;
-
-					/* No matter what, scan it first. */
-					fscanf(fxml, "%s", str);
-
-					if (icol5km == 0) {
-						if (strncmp(str, "<VALUES>", strlen("<VALUES>")) != 0) {
-							sprintf(message, "Format is not as expected: %s", fname_xml);
-							Error(message);
-							exit(1);
-						}
-
-						if (strstr(str, "NaN")) 
-							val = ANGFILL;
-						else 
-							val = atof(str+strlen("<VALUES>"));
-					}
-					else {	
-						if (strstr(str, "NaN"))
-							val = ANGFILL;
-						else
-							val = atof(str);
-					}
-
-					if (val != ANGFILL) {
-						tmpang[k] = val * 100;
-						detector_has_data = 1;
-					}
-				}
-			}
-			if (bandid == 5 && detector_has_data) {
-				/* interp */
-				ret = interp_s2ang_bilinear(tmpang, s2ang->nrow, s2ang->ncol);
-				if (ret != 0) {
-					sprintf(message, "Error in interp_s2ang_bilinear for bandId %d, detectorId %d: %s", bandid, detid, fname_xml);
-					Error(message);
-					return(-1);
-				}
-				/* Cookiecut with the footprint */
-				for (irow = 0; irow < s2ang->nrow; irow++) {
-					for (icol = 0; icol < s2ang->ncol; icol++) {
-						k = irow * s2ang->ncol + icol;
-						if (detid == s2detfoo->detid[k])
-							s2ang->ang[3][k] = tmpang[k];
-					}
-				}
-			}
-		} /* Angles for all bands are examined; recorded for B06 */
+	for (irow5km = 0; irow5km < N5KM; irow5km++) {
+		k = (long)rcgrid[irow5km] * ncol;
+		for (icol = 0; icol < ncol; icol++) 
+			tmpang[k+icol] = ANGFILL;
 	}
+	for (irow = span->rowbeg; irow >= 0 && irow <= span->rowend; irow++) {
+		if (span->colfirst[irow] == -1)
+			continue;
+		k = (long)irow * ncol;
+		for (icol = span->colfirst[irow]; icol <= span->collast[irow]; icol++) 
+			tmpang[k+icol] = ANGFILL;
+	}
+}
 
-	free(tmpang);
+/* Copy the interpolated angle of a detector to the output within the detector's footprint */
+static void cut_detang(uint16 *ang, uint16 *tmpang, s2detfoo_t *s2detfoo, int detid, detspan_t *span)
+{
+	int irow, icol;
+	int rowbeg, rowend, colbeg, colend;
+	long k;
+
+	rowbeg = 0; 
+	rowend = s2detfoo->nrow-1;
+	if (span) {
+		rowbeg = span->rowbeg;
+		rowend = span->rowend;
+	}
+	for (irow = rowbeg; irow >= 0 && irow <= rowend; irow++) {
+		colbeg = 0;
+		colend = s2detfoo->ncol-1;
+		if (span) {
+			if (span->colfirst[irow] == -1)
+				continue;
+			colbeg = span->colfirst[irow];
+			colend = span->collast[irow];
+		}
 
-	return 0;
+		k = (long)irow * s2detfoo->ncol;
+		for (icol = colbeg; icol <= colend; icol++) {
+			if (detid == s2detfoo->detid[k+icol])
+				ang[k+icol] = tmpang[k+icol];
+		}
+	}
 }
 
 /* Bilinear interpolation from the 5km angle grid, which can be solar zenith or azimuth, 
@@ -468,83 +570,78 @@ int make_smooth_s2ang(s2ang_t *s2ang, s2detfoo_t *s2detfoo, char *fname_xml)
  */
 int interp_s2ang_bilinear(uint16 *ang, int nrow, int ncol)
 {
-	int rcgrid[N5KM];	/* row/col of ANGPIXSZ meters that contain the 5km values */
-	char valid5km[N5KM]; 	/* A mask of valid 5km data points for a row*/
-	int lftcol, rgtcol;	
-	int toprow, botrow;
+	return interp_s2ang_bilinear_n(&ang, 1, nrow, ncol, NULL);
+}
 
-	int irow, icol;
-	int irow5km, icol5km;	
-	int i,k, k5km; 
-	int row5km_start, row5km_end,
-	    col5km_start, col5km_end;
-	int lftcol5km, rgtcol5km, toprow5km, botrow5km;
-	int tmprow, tmpcol;
-	uint16 anglft, angrgt, angtop, angbot;
-	double angint;		/* interpolated angle */
-	char message[MSGLEN];
+/* The row and col locations of fine-resolution ANGPIXSZ pixels where the original 5km 
+ * angle is available.  Not a regularly spaced grid because when the 5km values are saved at 
+ * fine resolution, the spacing between values can be +/- one fine-reso pixel due to rounding. 
+ * Additionally, the spacing between the the last two fine-reso rows or cols which hold the 
+ * 5km values is smaller (because 23 point * 5km > 109800 meters).  
+ *
+ * This code snippet also appears in make_smooth_s2ang().  
+ */
+static void set_rcgrid(int *rcgrid, int nrow)
+{
+	int i;
 
-	/* Compute the row and col locations of fine-resolution ANGPIXSZ pixels where the original 5km 
-         * angle is available.  Not a regularly spaced grid because when the 5km values are saved at 
-         * fine resolution, the spacing between values can be +/- one fine-reso pixel due to rounding. 
-         * Additionally, the spacing between the the last two fine-reso rows or cols which hold the 
-         * 5km values is smaller (because 23 point * 5km > 109800 meters).  
-	 *
-	 * This code snippet also appears in the calling function.  
-	 * This array could have been passed in.  Too late to change, Nov 26, 2019. 
-	 */
 	for (i = 0; i < N5KM; i++) {
 		rcgrid[i] = floor(i * 5000.0/ANGPIXSZ);
 		if (rcgrid[i] > nrow-1)	/* or ncol-1. Square tile */
 			rcgrid[i] = nrow-1;
 	}
+}
 
-	/* First pass: linear interp on the rows where 5km data are available.
-	 * Note that only N5KM rows have the 5km data.
-	 */
-	for (irow5km = 0; irow5km < N5KM; irow5km++) {
+/* First pass: linear interp on the rows where 5km data are available.
+ * Note that only N5KM rows have the 5km data.
+ *
+ * For each fine-reso pixel on a row, find its two nearest neighbors that hold valid 5km 
+ * data. For the ideal case, the two neighbors enclose the fine-reso pixel spatially, but 
+ * sometimes they don't and extrapolation is applied.
+ * Remember: there can be 5km-holes between valid 5km-points; for example: In
+ * S2A_MSIL1C_20190727T213051_N0208_R086_T17XMK_20190728T010507.SAFE
+ * Band 01 view zenith:
+ * <Viewing_Incidence_Angles_Grids bandId="0" detectorId="8">
+ * <Zenith>
+ *<COL_STEP unit="m">5000</COL_STEP>
+ *<ROW_STEP unit="m">5000</ROW_STEP>
+ *<Values_List>
+ *<VALUES>3.16347 3.19559 3.2289 3.26041 NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN 3.80201 3.83812 3.87265 3.90644</VALUES>
+ * <VALUES>3.49812 3.53211 3.56407 3.59715 3.63095 3.66483 3.70045 3.73548 3.77001 3.80429 3.84005 3.8748 3.90944 3.94418 3.98009 4.0149 4.05163 4.08518 4.11796 4.15563 4.19345 4.22708 4.26125</VALUES>
+ *
+ * Nov 26, 2019.
+ *
+ * In v1.4 the mask valid5km was not used; using col5km_start and col5km_end alone made mistakes for the above case.
+ *
+ * Oct 17, 2026: The two neighbors are the same for all the images and depend only on which 
+ * 5km points on the row are valid, so they are found once for each column by stepping 
+ * through the valid points, rather than searched for every pixel of every image.
+ */
+static void interp_s2ang_rows(uint16 **ang, int nang, int nrow, int ncol, int *rcgrid, int colbeg, int colend, 
+				int *lftcol, int *rgtcol)
+{
+	int valid[N5KM];	/* The 5km points that hold valid data for a row, from left to right */
+	int nvalid;
+	int irow, icol, irow5km, icol5km;
+	int il, ir, ia;
+	uint16 anglft, angrgt;
+	double angint;		/* interpolated angle */
+	uint16 *a;
 
+	for (irow5km = 0; irow5km < N5KM; irow5km++) {
 		/* Set the mask of valid 5km data for this row; later interpolate/extrapolation for a row
-                 * only use data from these points, but not from interpolated or extrapolated ones.
- 		 */
+		 * only use data from these points, but not from interpolated or extrapolated ones.
+		 */
 		irow = rcgrid[irow5km];		/* This fine-resolution row may have the 5km data (Fill or not) */
+		nvalid = 0;
 		for (icol5km = 0; icol5km < N5KM; icol5km++) {
 			icol = rcgrid[icol5km];	/* This fine-resol col may have the 5km data (Fill or not) */
-			if (ang[irow * ncol + icol] == ANGFILL)
-				valid5km[icol5km] = 0;
-			else
-				valid5km[icol5km] = 1;
-		}
-
-
-		/* The first and last column in the 5km grid that hold valid data for this row.
- 		 * There can be holes between valid data points; for example: In
- 		 * S2A_MSIL1C_20190727T213051_N0208_R086_T17XMK_20190728T010507.SAFE
- 		 * Band 01 view zenith:
- 		 * <Viewing_Incidence_Angles_Grids bandId="0" detectorId="8">
-        	 * <Zenith>
-          	 *<COL_STEP unit="m">5000</COL_STEP>
-          	 *<ROW_STEP unit="m">5000</ROW_STEP>
-          	 *<Values_List>
-            	 *<VALUES>3.16347 3.19559 3.2289 3.26041 NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN NaN 3.80201 3.83812 3.87265 3.90644</VALUES>
-            	 * <VALUES>3.49812 3.53211 3.56407 3.59715 3.63095 3.66483 3.70045 3.73548 3.77001 3.80429 3.84005 3.8748 3.90944 3.94418 3.98009 4.0149 4.05163 4.08518 4.11796 4.15563 4.19345 4.22708 4.26125</VALUES>
- 		 *
- 		 * Nov 26, 2019.
- 		 *
- 		 * In v1.4 the mask valid5km was not used; using col5km_start and col5km_end alone made mistakes for the above case.
- 		 */
-		col5km_start = -1;
-		col5km_end = -1;
-		for (icol5km = 0; icol5km < N5KM; icol5km++) {	 
-			if (valid5km[icol5km] == 1 && col5km_start == -1) 
-				col5km_start = icol5km;
-
-			if (valid5km[icol5km] == 1)
-				col5km_end = icol5km;
+			if (ang[0][irow * ncol + icol] != ANGFILL)
+				valid[nvalid++] = icol5km;
 		}
 
 		/* No valid 5km data on this row. Done with row */ 
-		if (col5km_start == -1) {
+		if (nvalid == 0) {
 			// Not an error.  This is possible when a detector's footprint does not extend
 			// from the very top to the very bottom of the tile, but on the upper-left or 
 			// lower-right corner of the tile. Then for some rows there are no valid angle
@@ -552,141 +649,285 @@ int interp_s2ang_bilinear(uint16 *ang, int nrow, int ncol)
 			continue;
 		}
 
-		for (icol = 0; icol < ncol; icol++) {
-			/* For each fine-reso pixel on a row, find its two nearest
- 			 * neighbors that hold valid 5km data. For the ideal case, the two neighbors
- 			 * enclose the fine-reso pixel spatially, but sometimes they don't and 
- 			 * extrapolation is applied.
- 			 * Remember: there can be 5km-holes between valid 5km-points.
-			 */
-			lftcol5km = -1;
-			rgtcol5km = -1;
-
-			/* The left 5km point */
-			for (icol5km = col5km_end; icol5km >= col5km_start; icol5km--) {
-				if (icol >= rcgrid[icol5km] && valid5km[icol5km] == 1) {
-					lftcol5km = icol5km;
-					break;
-				}
-			}
-			/* Won't be enclosing: fine-resolution point is outside on the left  */
-			if (lftcol5km == -1)
-				lftcol5km = col5km_start;
-
-			/* The right 5km point */
-			for (icol5km = col5km_start; icol5km <= col5km_end; icol5km++) {
-				if (icol <= rcgrid[icol5km] && valid5km[icol5km] == 1) {
-					rgtcol5km = icol5km;
-					break;
+		/* The left neighbor is the last valid point at or to the left of the pixel, and the 
+		 * right neighbor the first valid point at or to the right.  When the pixel is outside
+		 * the valid points, the first or last valid point is used on that side and it 
+		 * becomes extrapolation, which can be wild in that extrapolated values can be nagative 
+		 * or extremely high, or coincidentally be the fill value. But this does NOT pose a 
+		 * problem because later the detector's footprint is used to cookie-cut the angle 
+		 * values and the points with extrapolated values should be outside the detector's 
+		 * footprint anyway.
+		 */
+		il = ir = 0;
+		for (icol = colbeg; icol <= colend; icol++) {
+			/* valid[il-1] is the last point at or left of icol, valid[ir] the first at or right of it */ 
+			while (il < nvalid && rcgrid[valid[il]] <= icol)
+				il++;
+			while (ir < nvalid && rcgrid[valid[ir]] < icol)
+				ir++;
+			lftcol[icol] = il > 0 ? valid[il-1] : valid[0];
+			rgtcol[icol] = ir < nvalid ? valid[ir] : valid[nvalid-1];
+		}
+
+		for (ia = 0; ia < nang; ia++) {
+			a = ang[ia] + (long)irow * ncol;
+			for (icol = colbeg; icol <= colend; icol++) {
+				anglft = a[rcgrid[lftcol[icol]]];
+				angrgt = a[rcgrid[rgtcol[icol]]];
+
+				if (lftcol[icol] == rgtcol[icol]) 
+					a[icol] = anglft;   /* or angrgt; Only one 5km value on this row */
+				else { 
+					/* Interpolation or extrapolation */
+					angint = anglft + (angrgt - anglft) * 1.0 / (rcgrid[rgtcol[icol]] - rcgrid[lftcol[icol]]) * 
+							  (icol - rcgrid[lftcol[icol]]);
+					a[icol] = angint;
 				}
 			}
-			/* Won't be enclosing: fine-resolution point is outside on the right  */
-			if (rgtcol5km == -1)
-				rgtcol5km = col5km_end;
-
-
-			/* If the two found 5km points enclose the fine-reso pixel, it is interpolation. 
- 			 *
- 			 * If they don't, it becomes extrapolation, which can be wild in that extrapolated values 
- 			 * can be nagative or extremely high, or coincidentally be the fill value. But this 
- 			 * does NOT pose a problem because later the detector's footprint is used to cookie-cut 
- 			 * the angle values and the points with extrapolated values should be outside the
- 			 * detector's footprint anyway.
-			 */
-			lftcol = rcgrid[lftcol5km];	
-			rgtcol = rcgrid[rgtcol5km];
-
-			anglft = ang[irow * ncol + lftcol];
-			angrgt = ang[irow * ncol + rgtcol];
-
-			if (lftcol5km == rgtcol5km) 
-				ang[irow * ncol + icol] = anglft;   /* or angrgt; Only one 5km value on this row */
-			else { 
-				/* Interpolation or extrapolation */
-				angint = anglft + (angrgt - anglft) * 1.0 / (rgtcol - lftcol) * (icol - lftcol);
-				ang[irow * ncol + icol] = angint;
-			}
 		}
 	}
+}
+
+/* Second pass: linear interpolation/extrapolation for the pixels in all columns is possible since all 
+ * fine-reso columns should have at least one non-fill data value after first pass. 
+ *
+ * For each fine-reso pixel on a column, find its two nearest neighbors on the 5km grid that have angle 
+ * data. The data can be original 5km data or from interpolation/extrapolation; that is, we no longer 
+ * insist that interpolation/extrapolation must be based on original 5km data, in the way we do in the 
+ * first pass.
+ *
+ * Oct 17, 2026: The columns used to be processed one at a time, a stride of a whole row between 
+ * pixels. Now the image is processed row by row, keeping the two neighbors of each column in toprow 
+ * and botrow. The neighbors only change on the rows holding the 5km data and the rows right below 
+ * them, so they are only searched for on these rows.  Note that a 5km point without data in a column 
+ * is filled when its row is reached, and from the next row on it can be a top neighbor; this is 
+ * what the column-by-column code did too.
+ */
+static void interp_s2ang_cols(uint16 *ang, int nrow, int ncol, int *rcgrid, char *isnode, char *newbracket, detspan_t *span,
+				int *row5km_start, int *row5km_end, int *toprow, int *botrow)
+{
+	int irow, icol, irow5km;
+	int colbeg, colend;	/* Columns to compute the neighbors for */
+	int rowend;
+	int cb, ce;		/* Columns to interpolate on a row */
+	long k;
+	uint16 *a;
+	uint16 angtop, angbot;
+	double angint;		/* interpolated angle */
 
-	/* Second pass: linear interpolation/extrapolation for the pixels in all columns is possible since all 
- 	 * fine-reso columns should have at least one non-fill data value after first pass. 
+	/* The first row and last row in the 5km grid that holds data for each column. 
+	 * Think about: how likely is does interpolated/extrapolated value from the first 
+	 * pass happen to be ANGFILL?   Ignore for now. Nov 26, 2019
 	 */
-	for (icol = 0; icol < ncol; icol++) {
-
-		/* The first row and last row in the 5km grid that holds data for this column. The data can
- 		 * be original 5km data or from interpolation/extrapolation; that is, we no longer insist that
- 		 * interpolation/extrapolation must be based on original 5km data, in the way we do in the first pass.
- 		 */
-		row5km_start = -1;
-		row5km_end = -1;
-		for (irow5km = 0; irow5km < N5KM; irow5km++) {	 
-			k = rcgrid[irow5km] * ncol + icol;
-			if (ang[k] != ANGFILL && row5km_start == -1) 
-				row5km_start = irow5km;
-
-			if (ang[k] != ANGFILL)
-				row5km_end = irow5km;
-
-			/* Think about: how likely is does interpolated/extrapolated value from the first 
- 			 * pass happen to be ANGFILL?   Ignore for now. Nov 26, 2019*/
-		}
-		
+	if (span) {
+		colbeg = span->colbeg;
+		colend = span->colend;
+		rowend = span->rowend;
+	}
+	else {
+		colbeg = 0;
+		colend = ncol-1;
+		rowend = nrow-1;
+	}
 
-		for (irow = 0; irow < nrow; irow++) {	
+	for (icol = colbeg; icol <= colend; icol++) 
+		row5km_start[icol] = row5km_end[icol] = -1;
+	for (irow5km = 0; irow5km < N5KM; irow5km++) {	 
+		a = ang + (long)rcgrid[irow5km] * ncol;
+		for (icol = colbeg; icol <= colend; icol++) {
+			if (a[icol] != ANGFILL && row5km_start[icol] == -1) 
+				row5km_start[icol] = irow5km;
+			if (a[icol] != ANGFILL)
+				row5km_end[icol] = irow5km;
+		}
+	}
 
-			/* For each fine-reso pixel on a column, find its two nearest
-	 		 * neighbors on the 5km grid that have angle data. The data can be original 5km data
-	 		 * or interpolated/extrapolated ones.
-			 */
-			toprow5km = -1;
-			botrow5km = -1;
+	for (irow = 0; irow <= rowend; irow++) {	
+		if (newbracket[irow]) {
+			for (icol = colbeg; icol <= colend; icol++) 
+				toprow[icol] = botrow[icol] = -1;
 
 			/* The top row in the 5km grid */
-			for (irow5km = row5km_end; irow5km >= row5km_start; irow5km--) {
-				k = rcgrid[irow5km] * ncol + icol;
-				if (irow >= rcgrid[irow5km] && ang[k] != ANGFILL) {
-					toprow5km = irow5km;
-					break;
+			for (irow5km = N5KM-1; irow5km >= 0; irow5km--) {
+				if (irow < rcgrid[irow5km])
+					continue;
+				a = ang + (long)rcgrid[irow5km] * ncol;
+				for (icol = colbeg; icol <= colend; icol++) {
+					if (toprow[icol] == -1 && irow5km >= row5km_start[icol] && irow5km <= row5km_end[icol] &&
+					    a[icol] != ANGFILL)
+						toprow[icol] = irow5km;
 				}
 			}
-			/* Won't be enclosing: fine-resolution point is outside on the top */
-			if (toprow5km == -1)
-				toprow5km = row5km_start;
-	
 			/* The bottom row in the 5km grid*/
-			for (irow5km = row5km_start; irow5km <= row5km_end; irow5km++) {
-				k = rcgrid[irow5km] * ncol + icol;
-				if (irow <= rcgrid[irow5km] && ang[k] != ANGFILL) {
-					botrow5km = irow5km;
-					break;
+			for (irow5km = 0; irow5km < N5KM; irow5km++) {
+				if (irow > rcgrid[irow5km])
+					continue;
+				a = ang + (long)rcgrid[irow5km] * ncol;
+				for (icol = colbeg; icol <= colend; icol++) {
+					if (botrow[icol] == -1 && irow5km >= row5km_start[icol] && irow5km <= row5km_end[icol] &&
+					    a[icol] != ANGFILL)
+						botrow[icol] = irow5km;
 				}
 			}
-			/* Won't be enclosing: fine-resolution point is outside at the bottom*/
-			if (botrow5km == -1)
-				botrow5km = row5km_end;
+			/* Won't be enclosing: fine-resolution point is outside on the top or at the bottom */
+			for (icol = colbeg; icol <= colend; icol++) {
+				if (toprow[icol] == -1)
+					toprow[icol] = row5km_start[icol];
+				if (botrow[icol] == -1)
+					botrow[icol] = row5km_end[icol];
+			}
+		}
+
+		/* Within a detector's span, the rows holding the 5km data are interpolated over all
+		 * the columns of the span because they can be used further down; other rows only 
+		 * within the span on the row.
+		 */
+		cb = colbeg;
+		ce = colend;
+		if (span && !isnode[irow]) {
+			if (irow < span->rowbeg || span->colfirst[irow] == -1)
+				continue;
+			cb = span->colfirst[irow];
+			ce = span->collast[irow];
+		}
 
+		k = (long)irow * ncol;
+		for (icol = cb; icol <= ce; icol++) {
+			if (toprow[icol] == -1)		/* No data in this column at all */
+				continue;
 
-			toprow = rcgrid[toprow5km];
-			botrow = rcgrid[botrow5km];
-			angtop = ang[toprow * ncol + icol];
-			angbot = ang[botrow * ncol + icol];
+			angtop = ang[(long)rcgrid[toprow[icol]] * ncol + icol];
+			angbot = ang[(long)rcgrid[botrow[icol]] * ncol + icol];
 
-			if (toprow5km == botrow5km) { 	/* Only one value in this column */
-				k = rcgrid[toprow5km] * ncol + icol;
-				ang[irow * ncol + icol] = ang[k];
-			} else {
+			if (toprow[icol] == botrow[icol])	/* Only one value in this column */
+				ang[k+icol] = angtop;
+			else {
 				/* Interp or Extrap */
-				angint = angtop + (angbot - angtop) * 1.0 / (botrow - toprow) * (irow - toprow);
-				ang[irow * ncol + icol] = angint;
+				angint = angtop + (angbot - angtop) * 1.0 / (rcgrid[botrow[icol]] - rcgrid[toprow[icol]]) * 
+						  (irow - rcgrid[toprow[icol]]);
+				ang[k+icol] = angint;
+			}
+		}
+	}
+}
+
+/* Interpolate several angle images on the same 5km grid points together. The first pass 
+ * is shared by the images that have valid 5km data at the same points as the first image,
+ * e.g. solar zenith and azimuth; the other images are done separately.
+ *
+ * If span is given, the angles are only interpolated within the span of a detector; the
+ * values are the same as from interpolating the whole image. The other pixels are not 
+ * touched, except on the rows holding the 5km data within the columns of the span. 
+ */
+int interp_s2ang_bilinear_n(uint16 **ang, int nang, int nrow, int ncol, detspan_t *span)
+{
+	int rcgrid[N5KM];	/* row/col of ANGPIXSZ meters that contain the 5km values */
+	int *lftcol, *rgtcol;	/* The left and right 5km neighbors of each column on a row */
+	int *toprow, *botrow;	/* The top and bottom 5km neighbors of each column */
+	int *row5km_start, *row5km_end;
+	char *isnode;		/* Rows holding the 5km data */
+	char *newbracket;	/* Rows where the top and bottom neighbors need to be searched for */
+	uint16 **todo;		/* Images not interpolated yet */
+	uint16 **same;		/* Images with the same valid 5km points as the first in todo */
+	int ntodo, nsame;
+	int irow5km, icol5km, ia;
+	long k;
+
+	set_rcgrid(rcgrid, nrow);
+
+	if ((lftcol = malloc(ncol * sizeof(int))) == NULL ||
+	    (rgtcol = malloc(ncol * sizeof(int))) == NULL ||
+	    (toprow = malloc(ncol * sizeof(int))) == NULL ||
+	    (botrow = malloc(ncol * sizeof(int))) == NULL ||
+	    (row5km_start = malloc(ncol * sizeof(int))) == NULL ||
+	    (row5km_end = malloc(ncol * sizeof(int))) == NULL ||
+	    (isnode = calloc(nrow, sizeof(char))) == NULL ||
+	    (newbracket = calloc(nrow, sizeof(char))) == NULL ||
+	    (todo = malloc(nang * sizeof(uint16*))) == NULL ||
+	    (same = malloc(nang * sizeof(uint16*))) == NULL) {
+		Error("Cannot allocate memory");
+		return(ERR_MEM);
+	}
+
+	newbracket[0] = 1;
+	for (irow5km = 0; irow5km < N5KM; irow5km++) {
+		isnode[rcgrid[irow5km]] = 1;
+		newbracket[rcgrid[irow5km]] = 1;
+		if (rcgrid[irow5km] + 1 < nrow)
+			newbracket[rcgrid[irow5km]+1] = 1;
+	}
+
+	ntodo = nang;
+	for (ia = 0; ia < nang; ia++)
+		todo[ia] = ang[ia];
+
+	while (ntodo > 0) {
+		/* Gather the images with the same valid 5km points as the first */
+		nsame = 0;
+		for (ia = 0; ia < ntodo; ia++) {
+			for (irow5km = 0; irow5km < N5KM; irow5km++) {
+				for (icol5km = 0; icol5km < N5KM; icol5km++) {
+					k = (long)rcgrid[irow5km] * ncol + rcgrid[icol5km];
+					if ((todo[0][k] == ANGFILL) != (todo[ia][k] == ANGFILL))
+						break;
+				}
+				if (icol5km < N5KM)
+					break;
 			}
+			if (irow5km == N5KM) 
+				same[nsame++] = todo[ia];
+			else
+				todo[ia-nsame] = todo[ia];	/* Keep for the next round */
 		}
+
+		if (span) 
+			interp_s2ang_rows(same, nsame, nrow, ncol, rcgrid, span->colbeg, span->colend, lftcol, rgtcol);
+		else
+			interp_s2ang_rows(same, nsame, nrow, ncol, rcgrid, 0, ncol-1, lftcol, rgtcol);
+		for (ia = 0; ia < nsame; ia++) 
+			interp_s2ang_cols(same[ia], nrow, ncol, rcgrid, isnode, newbracket, span, 
+						row5km_start, row5km_end, toprow, botrow);
+
+		ntodo -= nsame;
 	}
 
+	free(lftcol);
+	free(rgtcol);
+	free(toprow);
+	free(botrow);
+	free(row5km_start);
+	free(row5km_end);
+	free(isnode);
+	free(newbracket);
+	free(todo);
+	free(same);
+
 	return 0;
 }
 
 
+/* Write the angles as COG. Oct 17, 2026 */
+int write_s2ang_cog(s2ang_t *s2ang, char *prefix)
+{
+	char fname[LINELEN+20];
+	char *metadata;
+	int ib, ret;
+
+	/* The angle file has no metadata but the geolocation, which is in the GeoTIFF tags */
+	for (ib = 0; ib < NANG; ib++) {
+		sprintf(fname, "%s.%s.tif", prefix, ANG_COG_NAME[ib]);
+		metadata = hls_cog_metadata(NULL, ANG_SDS_NAME[ib], ang_scale_factor, ang_add_offset);
+		ret = write_hls_cog(fname, s2ang->ang[ib], HLS_COG_UINT16, s2ang->nrow, s2ang->ncol,
+				s2ang->zonehem, s2ang->ulx, s2ang->uly, ANGPIXSZ, 
+				ANGFILL, HLS_COG_NEAREST, metadata);
+		free(metadata);
+		if (ret != 0)
+			return(ret);
+	}
+
+	return 0;
+}
+
 /* close */
 int close_s2ang(s2ang_t *s2ang)
 {
@@ -694,17 +935,23 @@ int close_s2ang(s2ang_t *s2ang)
 	int ib;
 	int nsds = 4;
 
+	/* Oct 17, 2026: The angles created in a raw intermediate are already in the file */
+	if (s2ang->raw_map != NULL) {
+		if (s2ang->sd_id != FAIL)
+			SDend(s2ang->sd_id);
+		s2ang->sd_id = FAIL;
+		unmap_hls_raw(s2ang->raw_map, s2ang->raw_size);
+		s2ang->raw_map = NULL;
+		for (ib = 0; ib < NANG; ib++)
+			s2ang->ang[ib] = NULL;
+	}
+
 	if (s2ang->access_mode == DFACC_CREATE && s2ang->sd_id != FAIL) {
 		char sdsname[500];     
-		int32 start[2], edge[2];
-
-		start[0] = 0; edge[0] = s2ang->nrow;
-		start[1] = 0; edge[1] = s2ang->ncol;
-
 
 		for (ib = 0; ib < NANG; ib++) {
-			if (SDwritedata(s2ang->sds_id[ib], start, NULL, edge, s2ang->ang[ib]) == FAIL) {
-				Error("Error in SDwritedata");
+			if (WriteSDSByChunk(s2ang->sds_id[ib], s2ang->nrow, s2ang->ncol, sizeof(uint16), s2ang->ang[ib]) != 0) {
+				Error("Error in WriteSDSByChunk");
 				return(ERR_CREATE);
 			}
 			SDendaccess(s2ang->sds_id[ib]);
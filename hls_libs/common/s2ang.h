@@ -12,6 +12,8 @@
 #include "fillval.h"
 #include "hls_commondef.h"
 #include "hdfutility.h"
+#include "hls_raw.h"
+#include "hls_cog.h"
 #include "s2def.h"
 #include "s2detfoo.h"
 
@@ -24,6 +26,9 @@ static char *ANG_SDS_NAME[] = {
 		"view_zenith",
 		"view_azimuth"};
 
+/* The names of the angles in the COG product */
+static char *ANG_COG_NAME[] = {"SZA", "SAA", "VZA", "VAA"};
+
 #define ANGPIXSZ DETFOOPIXSZ    /* same as detfoo pixel size */
 #define N5KM 23			/* 23 x 23 points with angle info, every 5km*/
 typedef struct {
@@ -44,16 +49,50 @@ typedef struct {
 	 */
 	uint16 *ang[NANG];
 
+	/* Oct 17, 2026: A raw intermediate (fname ends in HLS_RAW_EXT, see hls_raw.h) is 
+	 * mapped at raw_map, and the angles point into the map.
+	 */
+	char *raw_map;
+	size_t raw_size;
 } s2ang_t;			
 
 
 /* open s2 angles for read or create */
 int open_s2ang(s2ang_t *s2ang, int access_mode); 
 
+/* The 5km angle grids in the granule xml, in degrees. NaN where not available. Oct 17, 2026 
+ * The values are kept in double, not float: the angles are truncated to hundredths of a 
+ * degree as before, and a float copy of the xml value changes that truncation for about 
+ * 0.4% of the values. A grid is about 120KB and there is only one per granule.
+ */
+typedef struct {
+	double sz[N5KM][N5KM];		/* Solar zenith and azimuth */
+	double sa[N5KM][N5KM];
+	double vz[NDETECTOR+1][N5KM][N5KM];	/* B06 view zenith and azimuth for detectors 1-12 */
+	double va[NDETECTOR+1][N5KM][N5KM];
+} s2anggrid_t;
+
 /* Return 101 if the xml format is wrong. May 1, 2017 */
 int make_smooth_s2ang(s2ang_t *s2ang, s2detfoo_t *s2detfoo, char *fname_xml);
+
+/* The two steps of make_smooth_s2ang(): read the 5km grids from the xml, and interpolate 
+ * them to the resolution of s2ang. 
+ */
+int read_s2anggrid(char *fname_xml, s2anggrid_t *grid);
+int smooth_s2anggrid(s2ang_t *s2ang, s2detfoo_t *s2detfoo, s2anggrid_t *grid);
 int interp_s2ang_bilinear(uint16 *ang, int nrow, int ncol);
 
+/* Interpolate nang angle images at a time, e.g. solar zenith and azimuth. The images with 
+ * valid 5km data at the same points share the search for the 5km neighbors. Oct 17, 2026.
+ * With a detector span, only interpolate within the span; NULL for the whole image. 
+ */
+int interp_s2ang_bilinear_n(uint16 **ang, int nang, int nrow, int ncol, detspan_t *span);
+
+/* Write the four angles as COG, prefix.SZA.tif ... prefix.VAA.tif. Call before close_s2ang(). 
+ * Oct 17, 2026 
+ */
+int write_s2ang_cog(s2ang_t *s2ang, char *prefix);
+
 /* close */
 int close_s2ang(s2ang_t *s2ang);
 
@@ -19,6 +19,8 @@
 //#include "cubic_conv.h"
 
 #include "s2r.h" 
+#include "hls_cog.h"
+#include "hls_quicklook.h"
 
 /* Aug 29, not used? */
 //#define FNAME_MODISBRDF_BAND01 "fname_modisbrdf_band01"
@@ -59,13 +61,54 @@ typedef struct {
 	/* spatial coverage and cloud coverage derived upstream */
 	int16 spcover;
 	int16 clcover;
+
+	/* Oct 17, 2026: The rows [dirty_row0, dirty_row1) modified in each plane, i.e. the 13 
+	 * bands, then ACmask (S30_ACMASK_PLANE) and Fmask (S30_FMASK_PLANE), as recorded by 
+	 * mark_s2at30m_dirty(). If track_dirty is set, close_s2at30m() writes back only these 
+	 * for DFACC_WRITE and leaves the other SDS untouched; otherwise everything is written.
+	 */
+	char track_dirty;
+	int dirty_row0[S2NBAND+2];
+	int dirty_row1[S2NBAND+2];
+
+	/* Oct 17, 2026: A raw intermediate (fname ends in HLS_RAW_EXT, see hls_raw.h) is 
+	 * mapped at raw_map. The planes point into the map, and sd_id is that of the sidecar.
+	 */
+	char *raw_map;
+	size_t raw_size;
 } s2at30m_t;			/* S2 reflectance */
 
+#define S30_ACMASK_PLANE S2NBAND
+#define S30_FMASK_PLANE  (S2NBAND+1)
+
 int open_s2at30m(s2at30m_t *s2at30m, intn access_mode); 
 int close_s2at30m(s2at30m_t *s2at30m); 
 
+/* Oct 17, 2026: For DFACC_READ or DFACC_WRITE, read only the planes flagged in planes
+ * (13 bands, ACmask, Fmask; all if NULL) at open. The other planes are left NULL until
+ * load_s2at30m_plane() reads them, so a stage that needs a few bands only decompresses 
+ * and holds those. A plane never loaded is not written back at close.
+ */
+int open_s2at30m_subset(s2at30m_t *s2at30m, intn access_mode, uint8 *planes); 
+
+/* Read a plane on first access; nothing to do if it is already in memory */
+int load_s2at30m_plane(s2at30m_t *s2at30m, int iplane);
+
+/* Record that the nrow rows from row0 of a plane have been modified */
+void mark_s2at30m_dirty(s2at30m_t *s2at30m, int iplane, int row0, int nrow);
+
 /* Two function used to create 30m S2 from 10m, 20m, and 60m */
 void dup_s2at30m(s2at30m_t *in, s2at30m_t *out);
 int resample_s2to30m(s2r_t *s2r, s2at30m_t *s2at30m); 
 
+/* Write the S10 metadata held in s2r to the S30, with the S30 dimension and pixel size */
+int set_s2at30m_metadata(s2r_t *s2r, s2at30m_t *s2at30m);
+
+/* Oct 17, 2026: Write the 13 bands and Fmask as COG, prefix.B01.tif ... prefix.Fmask.tif,
+ * with the global attributes as metadata, and if fname_quicklook is not NULL the RGB 
+ * quicklook from the overviews of B04, B03, B02. Call before close_s2at30m(); the planes 
+ * not yet in memory are loaded.
+ */
+int write_s2at30m_cog(s2at30m_t *s2at30m, char *prefix, char *fname_quicklook);
+
 #endif
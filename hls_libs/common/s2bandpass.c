@@ -0,0 +1,123 @@
+#include "s2bandpass.h"
+
+/* Read the slope and offset for the NCB common bands. There is a header line. */
+int read_bandpass_para(char *fname_para, double para[][2])
+{
+	FILE *fpara;
+	char line[LINELEN];
+	char message[MSGLEN];
+	int i;
+
+	if ((fpara = fopen(fname_para, "r")) == NULL) {
+		sprintf(message, "Cannot read %s\n", fname_para);
+		Error(message);
+		return(ERR_READ);
+	}
+	fgets(line, sizeof(line), fpara);	/* skip header */
+	for (i = 0; i < NCB; i++) {
+		if (fgets(line, sizeof(line), fpara)) {	
+			if (sscanf(line, "%lf%lf", &para[i][0], &para[i][1]) != 2) {
+				sprintf(message, "Error in reading %s\n", fname_para);
+				Error(message);
+				return(ERR_READ);
+			}
+		}
+		else {
+			sprintf(message, "There are not enough lines in %s\n", fname_para);
+			Error(message);
+			return(ERR_READ);
+		}
+	}
+	if (fgets(line, sizeof(line), fpara) != NULL) {	/* Should not have any more lines */
+		sprintf(message, "There are extra lines data in %s", fname_para);
+		Error(message);
+		return(ERR_READ);
+	}
+	fclose(fpara);
+
+	return(0);
+}
+
+/* Find the row index in the parameter array for an S2 band; -1 if the band is not adjusted */
+int bandpass_para_index(int ib)
+{
+	int idx;
+
+	switch (ib) {
+		case 0:  idx = 0; break;
+		case 1:  idx = 1; break;
+		case 2:  idx = 2; break;
+		case 3:  idx = 3; break;
+		case 8:  idx = 4; break; 	/* 8a */ /* Mar 23, 2016: The parameter file says band80 */
+		case 11: idx = 5; break;		
+		case 12: idx = 6; break;
+		default: idx = -1;
+	}
+
+	return idx;
+}
+
+int bandpass_s2at30m(s2at30m_t *s2o, double para[][2])
+{
+	int ib, idx;
+	int k;
+	double tmpref;
+	int ret;
+
+	for (ib = 0; ib < S2NBAND; ib++) {
+		/* Find the index in the parameter array for S2 */
+		if ((idx = bandpass_para_index(ib)) == -1)
+			continue;
+		if ((ret = load_s2at30m_plane(s2o, ib)) != 0)
+			return(ret);
+		mark_s2at30m_dirty(s2o, ib, 0, s2o->nrow);
+
+		for (k = 0; k < s2o->nrow * s2o->ncol; k++) {
+			if (s2o->ref[ib][k] != HLS_S2_FILLVAL) {	
+				/* Ref scaling factor is 10000 */
+				tmpref = s2o->ref[ib][k] * para[idx][0] + para[idx][1]*10000;
+				s2o->ref[ib][k] =  asInt16(tmpref);
+			}
+		}
+	}
+
+	return 0;
+}
+
+void write_spectral_slope_offset(s2at30m_t *s2o, double para[][2])
+{
+	int band;
+	char attrname[200], attrval[50];
+
+	/* Mar 23, 2016: Mistakenly I had used DFNT_UCHAR8 */
+	/* b1 - b4 */
+	sprintf(attrname, "MSI band 01 bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[0][0], para[0][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+
+	sprintf(attrname, "MSI band 02 bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[1][0], para[1][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+
+	sprintf(attrname, "MSI band 03 bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[2][0], para[2][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+
+	sprintf(attrname, "MSI band 04 bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[3][0], para[3][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+
+	/* b8a */
+	sprintf(attrname, "MSI band 8a bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[4][0], para[4][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+
+	/* b11-12 */
+	sprintf(attrname, "MSI band 11 bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[5][0], para[5][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+
+	sprintf(attrname, "MSI band 12 bandpass adjustment slope and offset");
+	sprintf(attrval,  "%lf, %lf", para[6][0], para[6][1]);
+	SDsetattr(s2o->sd_id, attrname, DFNT_CHAR8, strlen(attrval), (VOIDP)attrval);
+}
@@ -0,0 +1,33 @@
+/* Bandpass adjustment: adjust the 30m S2 reflectance to make it resemble L8.
+ *
+ * Moved from L8like.c so that hls_s2_pipeline can adjust the S30 in memory.
+ * Oct 17, 2026
+ */
+#ifndef S2BANDPASS_H
+#define S2BANDPASS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "s2at30m.h"
+#include "util.h"
+
+/* Number of common bands between the two sensors. */
+#define NCB 7
+
+/* Read the slope and offset of the 7 common bands from the parameter file */
+int read_bandpass_para(char *fname_para, double para[][2]);
+
+/* Row index of an S2 band in the parameter array; -1 for a band without adjustment */
+int bandpass_para_index(int ib);
+
+/* Apply the slope and offset to the non-fill pixels of the 7 common bands, reading the
+ * bands first if the S30 was opened with a subset of the bands. Non-zero on error.
+ */
+int bandpass_s2at30m(s2at30m_t *s2o, double para[][2]);
+
+/* Write the spectral adjustment slope and offset as attributes */
+void write_spectral_slope_offset(s2at30m_t *s2o, double para[][2]);
+
+#endif
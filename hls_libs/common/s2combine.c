@@ -0,0 +1,567 @@
+#include "s2combine.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Number of 60m rows of the LaSRC output read at a time; 360 rows at 10m */
+#define TWOHDF_STRIP_NROW60 60
+
+/* Box size in 10m pixels of the native resolution of each band */
+static int boxsize_of_band[S2NBAND] = {6, 1, 1, 1, 2, 2, 2, 1, 2, 6, 6, 2, 2};
+
+/* The HLS reflectance for the sum of n LaSRC 10m values, 
+ *	asInt16((sum * 0.0000275/n - 0.2) * 10000)
+ * in integer arithmetic. The rounded value is floor((11*sum + 20*n) / (40*n)) - 2000;
+ * when the division is exact, the true value is halfway between two integers and 
+ * the floating-point expression decides, as before. Elsewhere the true value is at
+ * least 1/(40*n) away from a halfway point, much more than the floating-point error, 
+ * so the two agree. The result is well within the int16 range since 0 < sum/n < 65536.
+ */
+static int16 lasrc_to_hls(uint32 sum, int n)
+{
+	long num, den;
+
+	num = 11L * sum + 20L * n;
+	den = 40L * n;
+	if (num % den == 0)
+		return asInt16((sum * 0.0000275/n - 0.2) * 10000);
+	return (int16)(num / den - 2000);
+}
+
+/* ESPA raw binary input. Oct 17, 2026.
+ * The two LaSRC hdf files are made by convert_espa_to_hdf from the ESPA raw binary 
+ * output, as described by the two XML from create_sr_hdf_xml, in which the bands 
+ * are named as in VermoteS2sdsname[] and AC_CLOUD_NAME. The two XML can be given 
+ * in place of the hdf files; the .img files are then mapped into memory and read 
+ * directly. The raw binary is in the native byte order, as written by LaSRC.
+ */
+typedef struct {
+	void *map;	/* The .img file mapped into memory */
+	size_t size;
+	int nrow, ncol;
+} espa_band_t;
+
+static int is_espa_xml(char *fname)
+{
+	int len;
+
+	len = strlen(fname);
+	return (len > 4 && strcmp(fname + len - 4, ".xml") == 0);
+}
+
+/* Copy the value of an attribute of an XML tag, which has been terminated with '\0' */
+static int get_xml_attr(char *tag, char *attr, char *value, int size)
+{
+	char key[100];
+	char *p, *q;
+
+	sprintf(key, " %s=\"", attr);
+	if ((p = strstr(tag, key)) == NULL)
+		return(-1);
+	p += strlen(key);
+	if ((q = strchr(p, '"')) == NULL || q - p >= size)
+		return(-1);
+	strncpy(value, p, q - p);
+	value[q - p] = '\0';
+	return(0);
+}
+
+/* Find the band of the given name in the ESPA XML, e.g.
+ *	<band product="sr_refl" ... name="blue" category="image" data_type="UINT16" nlines="10980" nsamps="10980" ...>
+ *	    ...
+ *	    <file_name>S2A_..._sr_band2.img</file_name>
+ * and map its .img file, which is in the directory of the XML if not an absolute path.
+ * Each pixel has nbyte bytes.
+ */
+static int map_espa_band(char *fname_xml, char *bandname, int nbyte, espa_band_t *band)
+{
+	FILE *fxml;
+	long len;
+	char *xml, *p, *tagend, *bandend;
+	char name[100], dtype[20], nlines[20], nsamps[20];
+	char fname_img[LINELEN];
+	char *chpos;
+	struct stat st;
+	int fd, found;
+	char message[MSGLEN];
+
+	if ((fxml = fopen(fname_xml, "r")) == NULL) {
+		sprintf(message, "Cannot open %s", fname_xml);
+		Error(message);
+		return(ERR_READ);
+	}
+	if (fseek(fxml, 0, SEEK_END) != 0 || (len = ftell(fxml)) < 0) {
+		sprintf(message, "Error reading %s", fname_xml);
+		Error(message);
+		fclose(fxml);
+		return(ERR_READ);
+	}
+	rewind(fxml);
+	if ((xml = (char*)malloc(len + 1)) == NULL) {
+		Error("Cannot allocate memory");
+		fclose(fxml);
+		return(ERR_MEM);
+	}
+	if (fread(xml, 1, len, fxml) != len) {
+		sprintf(message, "Error reading %s", fname_xml);
+		Error(message);
+		fclose(fxml);
+		free(xml);
+		return(ERR_READ);
+	}
+	xml[len] = '\0';
+	fclose(fxml);
+
+	found = 0;
+	for (p = xml; (p = strstr(p, "<band ")) != NULL; p = tagend + 1) {
+		if ((tagend = strchr(p, '>')) == NULL)
+			break;
+		*tagend = '\0';
+		if (get_xml_attr(p, "name", name, sizeof(name)) == 0 && strcmp(name, bandname) == 0) {
+			found = (get_xml_attr(p, "data_type", dtype, sizeof(dtype)) == 0 &&
+				 get_xml_attr(p, "nlines", nlines, sizeof(nlines)) == 0 &&
+				 get_xml_attr(p, "nsamps", nsamps, sizeof(nsamps)) == 0);
+			break;
+		}
+	}
+	if (p == NULL || !found) {
+		sprintf(message, "Didn't find the band %s in %s", bandname, fname_xml);
+		Error(message);
+		free(xml);
+		return(ERR_READ);
+	}
+	if ((nbyte == 2 && strcmp(dtype, "INT16") != 0 && strcmp(dtype, "UINT16") != 0) ||
+	    (nbyte == 1 && strcmp(dtype, "UINT8") != 0)) {
+		sprintf(message, "Unexpected data type %s for the band %s in %s", dtype, bandname, fname_xml);
+		Error(message);
+		free(xml);
+		return(ERR_READ);
+	}
+	band->nrow = atoi(nlines);
+	band->ncol = atoi(nsamps);
+
+	/* The file name */
+	fname_img[0] = '\0';
+	if ((bandend = strstr(tagend + 1, "</band>")) != NULL) {
+		*bandend = '\0';
+		if ((p = strstr(tagend + 1, "<file_name>")) != NULL) {
+			p += strlen("<file_name>");
+			if ((chpos = strchr(p, '<')) != NULL && chpos - p < LINELEN/2) {
+				*chpos = '\0';
+				if (p[0] != '/' && (chpos = strrchr(fname_xml, '/')) != NULL) 
+					sprintf(fname_img, "%.*s/%s", (int)(chpos - fname_xml), fname_xml, p);
+				else
+					strcpy(fname_img, p);
+			}
+		}
+	}
+	free(xml);
+	if (fname_img[0] == '\0') {
+		sprintf(message, "No file_name for the band %s in %s", bandname, fname_xml);
+		Error(message);
+		return(ERR_READ);
+	}
+
+	band->size = (size_t)band->nrow * band->ncol * nbyte;
+	if ((fd = open(fname_img, O_RDONLY)) == -1) {
+		sprintf(message, "Cannot read %s", fname_img);
+		Error(message);
+		return(ERR_READ);
+	}
+	if (fstat(fd, &st) == -1) {
+		sprintf(message, "Cannot read %s", fname_img);
+		Error(message);
+		close(fd);
+		return(ERR_READ);
+	}
+	if (band->size == 0 || st.st_size != band->size) {
+		sprintf(message, "File size wrong: %s", fname_img);
+		Error(message);
+		close(fd);
+		return(ERR_READ);
+	}
+	if ((band->map = mmap(NULL, band->size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		sprintf(message, "Cannot map %s", fname_img);
+		Error(message);
+		close(fd);
+		return(ERR_READ);
+	}
+	close(fd);
+	madvise(band->map, band->size, MADV_SEQUENTIAL);
+
+	return(0);
+}
+
+static void unmap_espa_band(espa_band_t *band)
+{
+	munmap(band->map, band->size);
+	band->map = NULL;
+}
+
+/* Resample the 10m LaSRC output to the native resolutions of the S2 bands. 
+ *
+ * Oct 17, 2026: Each band was read in full at 10m (13 bands, about 3.1 GB) and 
+ * aggregated on its own with a floating-point conversion for every output pixel.
+ * Now the two files are read a strip of TWOHDF_STRIP_NROW60 60m rows at a time; 
+ * the 20m sums and valid-pixel counts are taken over 2x2 blocks of 10m pixels, 
+ * and the 60m sums and counts over 3x3 blocks of the 20m sums. The scaling is in 
+ * integer arithmetic (see lasrc_to_hls()). The output is the same as before. 
+ *
+ * fname1 and fname2 are the two LaSRC hdf files, or the two ESPA XML.
+ */
+int combine_twohdf(s2r_t *s2in, char *fname1, char *fname2, s2r_t *s2out)
+{
+	int32 sd_id[2], sds_id[S2NBAND];
+	int32 sds_index;
+	espa_band_t espa[S2NBAND];
+	int is_espa;
+	int32 start[2], edge[2];
+	char *fname;
+	char message[MSGLEN];
+
+	int ib, boxsize;
+	int nrow10m, ncol10m, ncol20m, ncol60m;
+	int row10m, len10m, nrow20m, nrow60m;
+	int irow, icol, ir, ic;
+	long k;
+	uint16 *buf;	/* A strip of a band; HLS code reads LSRD uint16 as int16, but the bits are the same */
+	uint16 *strip;	/* buf, or the strip in the mapped ESPA band */
+	uint16 *r0, *r1;
+	uint32 *sum20m;	/* Sum of the valid 10m values in each 2x2 block */
+	uint8 *cnt20m;	/* Number of valid 10m values in each 2x2 block */
+	uint32 sum;
+	int n;
+
+	nrow10m = s2in->nrow[0];
+	ncol10m = s2in->ncol[0];
+	ncol20m = ncol10m/2;
+	ncol60m = ncol10m/6;
+
+	is_espa = is_espa_xml(fname1);
+	sd_id[0] = sd_id[1] = FAIL;
+	for (ib = 0; ib < S2NBAND; ib++) {
+		/* Bands 8A to 12 are in the second file */
+		fname = (ib < 8) ? fname1 : fname2;
+		if (is_espa) {
+			if (map_espa_band(fname, VermoteS2sdsname[ib], 2, &espa[ib]) != 0)
+				return(ERR_READ);
+			if (espa[ib].nrow != nrow10m || espa[ib].ncol != ncol10m) {
+				sprintf(message, "Dimension of %s in %s differs from %d, %d", 
+						VermoteS2sdsname[ib], fname, nrow10m, ncol10m);
+				Error(message);
+				return(ERR_READ);
+			}
+			continue;
+		}
+
+		if (ib == 0 || ib == 8) {
+			if ((sd_id[ib/8] = SDstart(fname, DFACC_READ)) == FAIL) {
+				sprintf(message, "Cannot open %s", fname);
+				Error(message);
+				return(ERR_READ);
+			}
+		}
+		if ((sds_index = SDnametoindex(sd_id[ib/8], VermoteS2sdsname[ib])) == FAIL) {
+			sprintf(message, "Didn't find the SDS %s in %s", VermoteS2sdsname[ib], fname);
+			Error(message);
+			return(ERR_READ);
+		}
+		sds_id[ib] = SDselect(sd_id[ib/8], sds_index);
+	}
+
+	if ((buf = (uint16*)malloc((long)TWOHDF_STRIP_NROW60 * 6 * ncol10m * sizeof(uint16))) == NULL ||
+	    (sum20m = (uint32*)malloc((long)TWOHDF_STRIP_NROW60 * 3 * ncol20m * sizeof(uint32))) == NULL ||
+	    (cnt20m = (uint8*)malloc((long)TWOHDF_STRIP_NROW60 * 3 * ncol20m * sizeof(uint8))) == NULL) {
+		Error("Cannot allocate memory");
+		return(ERR_MEM);
+	}
+
+	for (row10m = 0; row10m < nrow10m; row10m += TWOHDF_STRIP_NROW60 * 6) {
+		len10m = nrow10m - row10m;
+		if (len10m > TWOHDF_STRIP_NROW60 * 6)
+			len10m = TWOHDF_STRIP_NROW60 * 6;
+		nrow20m = len10m/2;
+		nrow60m = len10m/6;
+
+		for (ib = 0; ib < S2NBAND; ib++) {
+			if (is_espa) 
+				strip = (uint16*)espa[ib].map + (long)row10m * ncol10m;
+			else {
+				start[0] = row10m; edge[0] = len10m;
+				start[1] = 0;      edge[1] = ncol10m;
+				if (SDreaddata(sds_id[ib], start, NULL, edge, buf) == FAIL) {
+					sprintf(message, "Error reading sds %s in %s", VermoteS2sdsname[ib], (ib < 8) ? fname1 : fname2);
+					Error(message);
+					return(ERR_READ);
+				}
+				strip = buf;
+			}
+
+			/* July 19, 2020: 0 is EROS nodata value.
+			 * Make sure there is no fill value in the box.  Jun 26, 2019.  
+			 */
+			boxsize = boxsize_of_band[ib];
+			if (boxsize == 1) {
+				for (k = 0; k < (long)len10m * ncol10m; k++) {
+					if (strip[k] > 0)
+						s2out->ref[ib][(long)row10m * ncol10m + k] = lasrc_to_hls(strip[k], 1);
+				}
+				continue;
+			}
+
+			for (irow = 0; irow < nrow20m; irow++) {
+				r0 = strip + (long)irow * 2 * ncol10m;
+				r1 = r0 + ncol10m;
+				for (icol = 0; icol < ncol20m; icol++) {
+					ic = icol * 2;
+					k = (long)irow * ncol20m + icol;
+					sum20m[k] = (uint32)r0[ic] + r0[ic+1] + r1[ic] + r1[ic+1];
+					cnt20m[k] = (r0[ic] > 0) + (r0[ic+1] > 0) + (r1[ic] > 0) + (r1[ic+1] > 0);
+				}
+			}
+
+			if (boxsize == 2) {
+				for (k = 0; k < (long)nrow20m * ncol20m; k++) {
+					if (cnt20m[k] == 4)
+						s2out->ref[ib][(long)row10m/2 * ncol20m + k] = lasrc_to_hls(sum20m[k], 4);
+				}
+				continue;
+			}
+
+			/* 60m */
+			for (irow = 0; irow < nrow60m; irow++) {
+				for (icol = 0; icol < ncol60m; icol++) {
+					sum = 0;
+					n = 0;
+					for (ir = irow*3; ir < irow*3+3; ir++) {
+						for (ic = icol*3; ic < icol*3+3; ic++) {
+							k = (long)ir * ncol20m + ic;
+							sum += sum20m[k];
+							n += cnt20m[k];
+						}
+					}
+					if (n == 36)
+						s2out->ref[ib][((long)row10m/6 + irow) * ncol60m + icol] = lasrc_to_hls(sum, 36);
+				}
+			}
+		}
+	}
+
+	free(buf);
+	free(sum20m);
+	free(cnt20m);
+	for (ib = 0; ib < S2NBAND; ib++) {
+		if (is_espa)
+			unmap_espa_band(&espa[ib]);
+		else
+			SDendaccess(sds_id[ib]);
+	}
+	if (!is_espa) {
+		SDend(sd_id[0]);
+		SDend(sd_id[1]);
+	}
+
+	/* CLOUD SDS. Direct copy. 10m in, 10m out.
+	 * The output may have no CLOUD SDS (hls_s2_pipeline derives ACmask from the input directly)
+	 */
+	if (s2out->accloud == NULL)
+		return(0);
+	for (k = 0; k < (long)nrow10m * ncol10m; k++) 
+		s2out->accloud[k] = s2in->accloud[k];
+
+	return(0);
+}
+
+
+/* The dimension and the CLOUD SDS from the two LaSRC hdf files */
+static int read_hdf_cloud(s2r_t *s2r, char *fname1, char *fname2)
+{
+	char fname[500];
+	char sds_name[500];     
+	int32 sds_index;
+	int32 sd_id, sds_id;
+	int32 nattr;
+	int32 dimsizes[2];
+	int32 rank, data_type;
+	int32 start[2], edge[2];
+	char message[MSGLEN];
+
+	strcpy(fname, fname1);
+	if ((sd_id = SDstart(fname, DFACC_READ)) == FAIL) {
+		sprintf(message, "Cannot open %s", fname);
+		Error(message);
+		return(ERR_READ);
+	}
+	strcpy(sds_name, VermoteS2sdsname[0]);
+	if ((sds_index = SDnametoindex(sd_id, sds_name)) == FAIL) {
+		sprintf(message, "Didn't find the SDS %s in %s", sds_name, fname);
+		Error(message);
+		return(ERR_READ);
+	}
+	sds_id = SDselect(sd_id, sds_index);
+	if (SDgetinfo(sds_id, sds_name, &rank, dimsizes, &data_type, &nattr) == FAIL) {
+		Error("Error in SDgetinfo");
+		return(ERR_READ);
+	}
+	s2r->nrow[0] = dimsizes[0];
+	s2r->ncol[0] = dimsizes[1];
+	start[0] = 0; edge[0] = dimsizes[0];
+	start[1] = 0; edge[1] = dimsizes[1];
+	SDendaccess(sds_id);
+	SDend(sd_id);
+
+	strcpy(fname, fname2);
+	if ((sd_id = SDstart(fname, DFACC_READ)) == FAIL) {
+		sprintf(message, "Cannot open %s", fname);
+		Error(message);
+		return(ERR_READ);
+	}
+
+	/* Read the CLOUD sds from the second file. */
+	strcpy(sds_name, AC_CLOUD_NAME);
+	if ((sds_index = SDnametoindex(sd_id, sds_name)) == FAIL) {
+		sprintf(message, "Didn't find the SDS %s in %s", sds_name, fname);
+		Error(message);
+		return(ERR_READ);
+	}
+	sds_id = SDselect(sd_id, sds_index);
+	if ((s2r->accloud = (uint8*)calloc(dimsizes[0] * dimsizes[1], sizeof(uint8))) == NULL) {
+		sprintf(message, "Cannot allocate memory. nrow, ncol = %d, %d\n", dimsizes[0], dimsizes[1]);
+		Error(message);
+		return(1);
+	}
+	if (SDreaddata(sds_id, start, NULL, edge, s2r->accloud) == FAIL) {
+		sprintf(message, "Error reading sds %s in %s", sds_name, fname);
+		Error(message);
+		return(ERR_READ);
+	}
+	SDendaccess(sds_id);
+	SDend(sd_id);
+
+	return(0);
+}
+
+/* The dimension and the CLOUD band from the two ESPA XML */
+static int read_espa_cloud(s2r_t *s2r, char *fname1, char *fname2)
+{
+	espa_band_t band;
+	char message[MSGLEN];
+
+	if (map_espa_band(fname1, VermoteS2sdsname[0], 2, &band) != 0)
+		return(ERR_READ);
+	s2r->nrow[0] = band.nrow;
+	s2r->ncol[0] = band.ncol;
+	unmap_espa_band(&band);
+
+	if (map_espa_band(fname2, AC_CLOUD_NAME, 1, &band) != 0)
+		return(ERR_READ);
+	if (band.nrow != s2r->nrow[0] || band.ncol != s2r->ncol[0]) {
+		sprintf(message, "%s in %s differs in dimension from %s in %s", 
+				AC_CLOUD_NAME, fname2, VermoteS2sdsname[0], fname1);
+		Error(message);
+		return(ERR_READ);
+	}
+	if ((s2r->accloud = (uint8*)malloc(band.size)) == NULL) {
+		sprintf(message, "Cannot allocate memory. nrow, ncol = %d, %d\n", band.nrow, band.ncol);
+		Error(message);
+		return(1);
+	}
+	memcpy(s2r->accloud, band.map, band.size);
+	unmap_espa_band(&band);
+
+	return(0);
+}
+
+/* The LaSRCS2 output is in two hdf files, or in ESPA raw binary described by two XML. Read both. */
+int read_twohdf(s2r_t *s2r, char *fname1, char *fname2, char *fname_granulexml)
+{
+	int ib;
+	int ret;
+	char message[MSGLEN];
+
+	for (ib = 0; ib < S2NBAND; ib++) 
+		s2r->ref[ib] = NULL;
+	s2r->accloud = NULL; 	/* CLOUD SDS is new */
+	s2r->acmask = NULL;
+	s2r->fmask = NULL;
+	s2r->dirty_row60 = NULL;
+	s2r->raw_map = NULL;
+
+	/* Nothing to write back; close_s2r() only frees the memory. */
+	s2r->access_mode = DFACC_READ;
+	s2r->sd_id = FAIL;
+	s2r->strip_nrow60 = 0;
+
+	/* The bands are read a strip at a time by combine_twohdf(); only get the 
+	 * dimension here. All bands are at 10m resolution actually.
+	 */
+	if (is_espa_xml(fname1))
+		ret = read_espa_cloud(s2r, fname1, fname2);
+	else
+		ret = read_hdf_cloud(s2r, fname1, fname2);
+	if (ret != 0)
+		return(ret);
+
+
+	/******** Read ULX, ULY, zonehem from xml */
+	char line[500];
+	char *chpos1, *chpos2, cs_name[50];
+	int len;
+	FILE *fxml;
+	char found_csname, found_ulx, found_uly;
+
+	if ((fxml = fopen(fname_granulexml, "r")) == NULL) {
+		sprintf(message, "Cannot open %s", fname_granulexml);
+		Error(message);
+		return(1);
+	}
+	found_csname = found_ulx = found_uly = 0;
+	while (fgets(line, sizeof(line), fxml)) {
+		if (strstr(line, HORIZONTAL_CS_NAME)) {
+			/* Jun 9, 2016: This items contains 20 char exactly. With '\0'
+			 * the C char array should have minimum length 21, but I declared
+			 * 20. A bug took a few hours to find. 
+			 */
+			chpos1 = strchr(line, '>');
+			chpos2 = strchr(chpos1, '<');
+			len = chpos2 - (chpos1+1);
+			strncpy(cs_name, chpos1+1, len);
+			cs_name[len] = '\0';
+			chpos1 = strrchr(cs_name, ' ');
+			strcpy(s2r->zonehem, chpos1 + 1);
+
+			found_csname = 1;
+		} 
+		else if (strstr(line, ULX)) {
+			chpos1 = strchr(line, '>');
+			s2r->ulx = atof(chpos1+1);
+			found_ulx = 1;
+		}
+		else if (strstr(line, ULY)) {
+			chpos1 = strchr(line, '>');
+			s2r->uly = atof(chpos1+1);
+			found_uly = 1;
+		}
+	}
+	fclose(fxml);
+
+	if ( ! found_csname) {
+		Error("HORIZONTAL_CS_NAME not found");
+		exit(1);
+	}
+	if ( ! found_ulx) {
+		Error("ULX not found");
+		exit(1);
+	}
+	if ( ! found_uly) {
+		Error("ULY not found");
+		exit(1);
+	}
+
+	/* Added on Oct 3, 2018: To GCTP convention */
+	if (strstr(s2r->zonehem, "S")) {
+		s2r->uly -= pow(10,7);
+	}
+	return(0);
+}
@@ -0,0 +1,33 @@
+/* Combine the two LaSRC S2 output HDF files into one S10 image.
+ *
+ * The code was in twohdf2one.c, and has been moved here so that
+ * hls_s2_pipeline can combine the two files without writing an
+ * intermediate S10.  Oct 17, 2026.
+ */
+#ifndef S2COMBINE_H
+#define S2COMBINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "s2r.h"
+#include "util.h"
+
+/* Read the image dimension and the CLOUD SDS at 10m from the two hdf files, and 
+ * read map projection info from the granule XML. The bands are not read here; 
+ * s2r->ref[] is NULL. (Oct 17, 2026)
+ *
+ * fname1 and fname2 may instead be the two ESPA XML (*.xml) from create_sr_hdf_xml, 
+ * and the raw binary bands they describe are read directly. Also for combine_twohdf().
+ */
+int read_twohdf(s2r_t *s2r, char *fname1, char *fname2, char* fname_granulexml);
+
+/* Aggregate the 10m bands in the two hdf files to the native 10m, 20m, 60m 
+ * resolutions of the S2 bands, reading the files a row strip at a time, and copy 
+ * the CLOUD SDS from s2in (from read_twohdf()) if the output has been opened 
+ * (or allocated) with AC_CLOUD_AVAILABLE.
+ */
+int combine_twohdf(s2r_t *s2in, char *fname1, char *fname2, s2r_t *s2out);
+
+#endif
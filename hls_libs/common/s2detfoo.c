@@ -30,10 +30,6 @@ int open_s2detfoo(s2detfoo_t *s2detfoo, intn access_mode)
 	else if (s2detfoo->access_mode == DFACC_CREATE) {
 		int irow, icol;
 		char *dimnames[] = {"YDim_Grid", "XDim_Grid"};
-		int32 comp_type;   /*Compression flag*/
-		comp_info c_info;  /*Compression structure*/
-		comp_type = COMP_CODE_DEFLATE;
-		c_info.deflate.level = 2;     /*Level 9 would be too slow */
 		rank = 2;
 
 		if ((s2detfoo->sd_id = SDstart(s2detfoo->fname, s2detfoo->access_mode)) == FAIL) {
@@ -58,7 +54,7 @@ int open_s2detfoo(s2detfoo_t *s2detfoo, intn access_mode)
 		}
 		PutSDSDimInfo(s2detfoo->sds_id_detid, dimnames[0], 0);
 		PutSDSDimInfo(s2detfoo->sds_id_detid, dimnames[1], 1);
-		SDsetcompress(s2detfoo->sds_id_detid, comp_type, &c_info);
+		SetSDSChunkDeflate(s2detfoo->sds_id_detid, s2detfoo->nrow, s2detfoo->ncol, HLS_CHUNK_NROW);
 
 		for (irow = 0; irow < s2detfoo->nrow; irow++) {
 			for (icol = 0; icol < s2detfoo->ncol; icol++)
@@ -70,6 +66,297 @@ int open_s2detfoo(s2detfoo_t *s2detfoo, intn access_mode)
 	return 0;
 }
 
+/* Read the vertices of one footprint polygon from the gml:posList that follows, 
+ * e.g.
+ *	<gml:posList srsDimension="3">699960 4000020 0 699960 3890220 0 ... </gml:posList>
+ *
+ * Oct 17, 2026: The numbers were read one token at a time with fscanf(). Since PB 02.07
+ * a footprint can have thousands of vertices, so the whole posList is now read into a 
+ * buffer and the numbers are scanned with strtod(). x and y grow as needed.
+ */
+static int read_poslist(FILE *fgml, char *fname, double **x, double **y, int *xylen, int *n)
+{
+	char line[500];
+	char *buf, *pos, *end, *tail, *tmp;
+	double *tmpx, *tmpy;
+	size_t buflen, bufsize, len;
+	char *tag = "srsDimension=\"3\">";
+	char *endtag = "</gml:posList>";
+	char message[MSGLEN];
+
+	bufsize = 10000;
+	if ((buf = malloc(bufsize)) == NULL) {
+		Error("Cannot allocate memory");
+		return(1);
+	}
+	buflen = 0;
+	buf[0] = '\0';
+
+	/* Read until the end tag; a line can be longer than the line buffer */
+	end = NULL;
+	while (end == NULL && fgets(line, sizeof(line), fgml)) {
+		len = strlen(line);
+		if (buflen + len + 1 > bufsize) {
+			bufsize = 2 * (buflen + len + 1);
+			if ((tmp = realloc(buf, bufsize)) == NULL) {
+				Error("Cannot allocate memory");
+				free(buf);
+				return(1);
+			}
+			buf = tmp;
+		}
+		strcpy(buf+buflen, line);
+		/* The end tag may straddle two reads */
+		end = strstr(buflen > strlen(endtag) ? buf+buflen-strlen(endtag) : buf, endtag);
+		buflen += len;
+	}
+
+	if ((pos = strstr(buf, tag)) == NULL || end == NULL || pos > end) {
+		sprintf(message, "Pattern \"srsDimension\" not found. %s", fname);
+		Error(message);
+		free(buf);
+		return(1);
+	}
+	pos += strlen(tag);
+	*end = '\0';
+
+	*n = 0;
+	while (1) {
+		if (*n == *xylen) {
+			/* On failure x and y are still valid, and freed by the caller */
+			if ((tmpx = realloc(*x, 2 * *xylen * sizeof(double))) == NULL) {
+				Error("Cannot allocate memory");
+				free(buf);
+				return(1);
+			}
+			*x = tmpx;
+			if ((tmpy = realloc(*y, 2 * *xylen * sizeof(double))) == NULL) {
+				Error("Cannot allocate memory");
+				free(buf);
+				return(1);
+			}
+			*y = tmpy;
+			*xylen *= 2;
+		}
+
+		(*x)[*n] = strtod(pos, &tail);
+		if (tail == pos)	/* No more numbers */
+			break;
+		pos = tail;
+		(*y)[*n] = strtod(pos, &pos);
+		strtod(pos, &pos);		/* z */
+		(*n)++;
+	}
+
+	free(buf);
+	return 0;
+}
+
+/* The first column whose center is at or to the right of x, or ncol if none. The 
+ * estimate from the division is adjusted with the same comparison as in pnpoly.c, so
+ * that a pixel center exactly on a boundary is treated as before.
+ */
+static int first_col_from(s2detfoo_t *s2detfoo, double x)
+{
+	double c;
+	int icol;
+
+	c = ceil((x - s2detfoo->ulx) / DETFOOPIXSZ - 0.5);
+	if (c < 0)
+		return 0;
+	if (c > s2detfoo->ncol)
+		return s2detfoo->ncol;
+
+	icol = (int)c;
+	while (icol > 0 && s2detfoo->ulx + (icol-1+0.5) * DETFOOPIXSZ >= x)
+		icol--;
+	while (icol < s2detfoo->ncol && s2detfoo->ulx + (icol+0.5) * DETFOOPIXSZ < x)
+		icol++;
+	return icol;
+}
+
+/* Fill the pixels of a row that are inside a footprint polygon, given the sorted
+ * x coordinates ex[] where the row center line crosses the polygon boundary. 
+ * A pixel is inside if an odd number of crossings are to the right of the pixel center,
+ * as in pnpoly.c, so the pixels between ex[m-2] and ex[m-1], between ex[m-4] and ex[m-3], 
+ * and so on are inside; if m is odd, so are the pixels to the left of ex[0].
+ * Pixels already flagged are skipped.
+ */
+static void fill_spans(s2detfoo_t *s2detfoo, int irow, double *ex, int m, int detid)
+{
+	int icol, colbeg, colend;
+	int im;
+	long k;
+
+	for (im = m-1; im >= 0; im -= 2) {
+		colbeg = im > 0 ? first_col_from(s2detfoo, ex[im-1]) : 0;
+		colend = first_col_from(s2detfoo, ex[im]);
+
+		k = (long)irow * s2detfoo->ncol;
+		for (icol = colbeg; icol < colend; icol++) {
+			/* The pixel hasn't been flagged.
+			 * Nov 27, 2019: no footprint overlap any more. 
+			 */
+			if (s2detfoo->detid[k+icol] == DETIDFILL)
+				s2detfoo->detid[k+icol] = detid;
+		}
+	}
+}
+
+/* Rasterize one footprint polygon into the pixels not yet flagged.
+ *
+ * Dec 19-20, 2018: Originally ESA masked the full extent of each detector's
+ * footprint and as a result the footprint of two adjacent detectors overlaps 
+ * although data from only one detector is retained in the image for the overlap. 
+ * Later in extracting the angle data, HLS had evenly split the overlapping area.
+ * Starting on Nov 10 (?), 2018, the ESA footprint mask only demarcates the pixels
+ * that are preserved in the L1C data. As a result, the number of points in the mask
+ * increased substantially to make the application of the function pnpoly impractical.
+ *
+ * However, the idea of function pnpoly (found from internet) still applies. For each 
+ * row of pixels, the left and right boundaries of the footprint are calculated from 
+ * the mask vector and then each pixel's position is assessed with respect to the 
+ * boundaries.
+ *
+ * Nov 27, 2019: Bug fix. The footprint polygon is not convex at high latitude, where
+ * the flight path is almost horizontal in the image. So not necessarily only two 
+ * boundaries to test against for a row of pixels. Back to the original idea of ray 
+ * tracing, but luckily all pixels in the same row have the same y, so the same set of 
+ * expected X on the boundaries is used, although the number of points in the set can
+ * be more than 2. 
+ *
+ * Oct 17, 2026: Each row tested all polygon edges and then every pixel in the row 
+ * against all the crossings, with at most 100 crossings. Now an edge table lists, 
+ * for each row, the edges that span the row, so a row only looks at its own edges. 
+ * The crossings are sorted and the spans between pairs of crossings are filled 
+ * directly. There is no limit on the number of crossings. The rows are independent
+ * and are processed in parallel. The result is the same as from the per-pixel test.
+ */
+static int fill_polygon(s2detfoo_t *s2detfoo, double *x, double *y, int n, int detid)
+{
+	int *rowcnt;		/* Number of edges for each row, then the start of the row in rowedge */
+	int *rowedge;		/* Edge index (the index of its first vertex) listed by row */
+	int *fillpos;
+	int i, j, irow, r0, r1;
+	long nentry;
+	int nrow = s2detfoo->nrow;
+	int ret = 0;
+
+	rowcnt = calloc(nrow+1, sizeof(int));
+	fillpos = calloc(nrow, sizeof(int));
+	if (rowcnt == NULL || fillpos == NULL) {
+		Error("Cannot allocate memory");
+		free(rowcnt);
+		free(fillpos);
+		return(1);
+	}
+
+	/* The range of rows an edge may span, with a one-row margin for rounding. 
+	 * Whether the edge really spans a row is decided by the exact test later.
+	 */
+	#define EDGE_ROWS(i, j, r0, r1) 					\
+		do {								\
+			double ymax = y[i] > y[j] ? y[i] : y[j];		\
+			double ymin = y[i] > y[j] ? y[j] : y[i];		\
+			r0 = (int)floor((s2detfoo->uly - ymax) / DETFOOPIXSZ - 0.5) - 1; \
+			r1 = (int)ceil((s2detfoo->uly - ymin) / DETFOOPIXSZ - 0.5) + 1; \
+			if (r0 < 0) r0 = 0;					\
+			if (r1 > nrow-1) r1 = nrow-1;				\
+		} while (0)
+
+	nentry = 0;
+	for (i = 0, j = n-1; i < n; j = i++) {
+		if (y[i] == y[j])	/* Horizontal edges never cross a row */
+			continue;
+		EDGE_ROWS(i, j, r0, r1);
+		for (irow = r0; irow <= r1; irow++) {
+			rowcnt[irow]++;
+			nentry++;
+		}
+	}
+
+	if ((rowedge = malloc((nentry+1) * sizeof(int))) == NULL) {
+		Error("Cannot allocate memory");
+		free(rowcnt);
+		free(fillpos);
+		return(1);
+	}
+	/* rowcnt becomes the start of each row in rowedge */
+	for (irow = 0, nentry = 0; irow <= nrow; irow++) {
+		long cnt = irow < nrow ? rowcnt[irow] : 0;
+		rowcnt[irow] = nentry;
+		nentry += cnt;
+	}
+	for (i = 0, j = n-1; i < n; j = i++) {
+		if (y[i] == y[j])
+			continue;
+		EDGE_ROWS(i, j, r0, r1);
+		for (irow = r0; irow <= r1; irow++) 
+			rowedge[rowcnt[irow] + fillpos[irow]++] = i;
+	}
+	#undef EDGE_ROWS
+
+	#pragma omp parallel private(irow, i, j)
+	{
+		double *ex = NULL;	/* Expected x value on a polygon boundary for the given y. */
+		double *tmpex;
+		int exlen = 0;
+		int m, im, ie, failed;
+		double py, e;
+
+		#pragma omp for schedule(dynamic, 16)
+		for (irow = 0; irow < nrow; irow++) {
+			#pragma omp atomic read
+			failed = ret;
+			if (failed != 0)
+				continue;
+			if (rowcnt[irow+1] - rowcnt[irow] > exlen) {
+				if ((tmpex = realloc(ex, (rowcnt[irow+1] - rowcnt[irow]) * sizeof(double))) == NULL) {
+					Error("Cannot allocate memory");
+					#pragma omp atomic write
+					ret = 1;
+					continue;
+				}
+				ex = tmpex;
+				exlen = rowcnt[irow+1] - rowcnt[irow];
+			}
+
+			py = s2detfoo->uly - (irow+0.5) * DETFOOPIXSZ;
+			m = 0;
+			for (ie = rowcnt[irow]; ie < rowcnt[irow+1]; ie++) {
+				i = rowedge[ie];
+				j = i == 0 ? n-1 : i-1;
+				if ( (y[i]>py) != (y[j]>py) ) {
+					/* Very clever comparison to find a non-zero-length interval in y that
+					 * encloses py; it does not matter which is greater, y[i] or y[j].
+					 * py can be equal to one of the end points.
+					 */
+					e = (x[j]-x[i]) * (py-y[i]) / (y[j]-y[i]) + x[i];
+
+					/* Insertion sort; predominantly only two crossings */
+					for (im = m; im > 0 && ex[im-1] > e; im--)
+						ex[im] = ex[im-1];
+					ex[im] = e;
+					m++;
+				}
+			}
+
+			/* No footprint on this row of pixels; right edge near the top on the tile.
+			 * A bug fixed during testing. Dec 20, 2018 */
+			if (m == 0)
+				continue;
+
+			fill_spans(s2detfoo, irow, ex, m, detid);
+		}
+		free(ex);
+	}
+
+	free(rowcnt);
+	free(fillpos);
+	free(rowedge);
+	return(ret);
+}
+
 /********************************************************************************
  * Generate the B06 detector footprint image by rasterizing the footprint vector 
  * polygon (before PB4.0).
@@ -87,14 +374,11 @@ int rasterize_s2detfoo(s2detfoo_t *s2detfoo, char *fname_b06_gml)
 {
 	FILE *fgml;
 	char line[500];
-	char str[500];
 	char *pos;
-	int irow, icol;
 	int detid;
 	int xylen = 200; 	/* initial length of x,y vectors */
-	double *x, *y, z;
-	double px, py;
-	int i, n, k;
+	double *x, *y;
+	int i, n;
 	char found_vector; 	/* Indicator whether vector is present for a band */
 	char message[MSGLEN];
 	int no_vector = 100;    /* Return if no vector is found */
@@ -106,14 +390,20 @@ int rasterize_s2detfoo(s2detfoo_t *s2detfoo, char *fname_b06_gml)
 		return(1);
         }
 
-	if ((x = malloc(xylen *sizeof(double))) == NULL || (y = malloc(xylen *sizeof(double))) == NULL) {
+	x = malloc(xylen *sizeof(double));
+	y = malloc(xylen *sizeof(double));
+	if (x == NULL || y == NULL) {
                 sprintf(message, "Cannot allocate memory");
 		Error(message);
+		free(x);
+		free(y);
 		return(1);
 	}
 	if ((fgml = fopen(fname_b06_gml, "r")) == NULL) {
 		sprintf(message, "Cannot open for read: %s", fname_b06_gml);
 		Error(message);
+		free(x);
+		free(y);
 		return(1);
 	}
 
@@ -138,124 +428,27 @@ int rasterize_s2detfoo(s2detfoo_t *s2detfoo, char *fname_b06_gml)
 			for (i = 0; i < 5; i++) 
 				fgets(line, sizeof(line), fgml);	
 			/* Line of vector */
-			fscanf(fgml, "%s", str);
-			fscanf(fgml, "%s", str);
-			if (strstr(str, "srsDimension=\"3\">") == NULL) {
-				sprintf(message, "Pattern \"srsDimension\" not found. %s", fname_b06_gml);
-				Error(message);
-				return(1);
-			}
-
-			n = 0;
-			sscanf(str+strlen("srsDimension=\"3\">"), "%lf", &x[n]); /* First point */
-			fscanf(fgml, "%lf", &y[n]);
-			fscanf(fgml, "%lf", &z);
-			n++;
-			while (1) {
-				fscanf(fgml, "%s", str);
-				if (strstr(str, "</gml:posList>"))
-					break;
-				else {
-					/* str contains x */
-					if (n == xylen) {
-						xylen *= 2;
-						if ((x = realloc(x, xylen*sizeof(double))) == NULL || 
-						    (y = realloc(y, xylen*sizeof(double))) == NULL) {
-							sprintf(message, "Cannot open for read: %s", fname_b06_gml);
-							Error(message);
-							return(1);
-						}
-					}
-
-					x[n] = atof(str);
-					fscanf(fgml, "%lf", &y[n]);
-					fscanf(fgml, "%lf", &z);
-					n++;
-				}
-			}
-
 			/* Rasterize by point in polygon test */
-			for (irow = 0; irow < s2detfoo->nrow; irow++) {
-  				int i, j;
-				int m = 0, im;
-				char in; 	/* pixel in polygon or not */	
-				double ex[100];	/* Expected x value on a polygon boundary for the given y. 
-						 * Predomimantly only two elements are needed in the array. Nov 27, 2019 */
-				py = s2detfoo->uly - (irow+0.5) * DETFOOPIXSZ;
-
-				/* Dec 19-20, 2018: Originally ESA masked the full extent of each detector's
-				 * footprint and as a result the footprint of two adjacent detectors overlaps 
-				 * although data from only one detector is retained in the image for the overlap. 
-				 * Later in extracting the angle data, HLS had evenly split the overlapping area.
-				 * Starting on Nov 10 (?), 2018, the ESA footprint mask only demarcates the pixels
-				 * that are preserved in the L1C data. As a result, the number of points in the mask
-				 * increased substantially to make the application of the function pnpoly impractical.
-				 *
-				 * However, the idea of function pnpoly (found from internet) still applies. For each 
-				 * row of pixels, the left and right boundaries of the footprint are calculated from 
-				 * the mask vector and then each pixel's position is assessed with respect to the 
-				 * boundaries.
-				 *
-				 * Nov 27, 2019: Bug fix. The footprint polygon is not convex at high latitude, where
-				 * the flight path is almost horizontal in the image. So not necessarily only two 
-				 * boundaries to test against for a row of pixels. Back to the original idea of ray 
-				 * tracing, but luckily all pixels in the same row have the same y, so the same set of 
-				 * expected X on the boundaries is used, although the number of points in the set can
-				 * be more than 2. 
-				 */
-  					for (i = 0, j = n-1; i < n; j = i++) {
-					/* Note that the initial condition of the loop considers the first and last
-					 * points in the vector in case the first point is not duplicated to be the
-					 * last point.
-					 */
-    						if ( (y[i]>py) != (y[j]>py) ) {
-						/* Very clever comparison to find a non-zero-length interval in y that
-						 * encloses py; it does not matter which is greater, y[i] or y[j].
-						 * py can be equal to one of the end points.
-						 */
- 						ex[m] = (x[j]-x[i]) * (py-y[i]) / (y[j]-y[i]) + x[i];
-						m++;
-
-						/* m can be greater than 2. V1.4 code breaks the loop at m == 2 */ 
-					}
-				}
-
-				/* No footprint on this row of pixels; right edge near the top on the tile.
-				 * A bug fixed during testing. Dec 20, 2018 */
-				if (m == 0)
-					continue;
-
-				for (icol = 0; icol < s2detfoo->ncol; icol++) {
-					in = 0; 	/* Not in the polygon*/
-					px = s2detfoo->ulx + (icol+0.5) * DETFOOPIXSZ;
-					k = irow * s2detfoo->ncol + icol;
-				
-					/* The pixel hasn't been flagged.
-					 * Nov 27, 2019: no footprint overlap any more. 
-					 */
-					if (s2detfoo->detid[k] == DETIDFILL) {
-						for (im = 0; im < m; im++) {
-							if (px < ex[im])	/* borrowed from pnpoly.c. 11/27/19 */
-								in = !in;
-						}
-
-						if ( in ) 
-							s2detfoo->detid[k] = detid;
-						
-					}
-				}
+			if (read_poslist(fgml, fname_b06_gml, &x, &y, &xylen, &n) != 0 ||
+			    fill_polygon(s2detfoo, x, y, n, detid) != 0) {
+				free(x);
+				free(y);
+				fclose(fgml);
+				return(1);
 			}
 		}
 	}
 
+	free(x);
+	free(y);
+	fclose(fgml);
+
 	if (! found_vector) {
 		sprintf(message, "Detector footprint vector not found for band %s: %s", S2_SDS_NAME[5], fname_b06_gml);
 		Error(message);	
 		return(no_vector);
 	}
 
-	fclose(fgml);
-
 	return 0;
 }
 
@@ -386,6 +579,78 @@ void split_overlap(s2detfoo_t *s2detfoo)
 }
 
 
+/********************************************************************************
+ * Find the first and last row of each detector in the footprint image, and the 
+ * first and last column on each row. Pixels with an overlap id (greater than NDETECTOR) 
+ * are not counted.  Oct 17, 2026.
+ */
+int index_s2detfoo(s2detfoo_t *s2detfoo, detspan_t *span)
+{
+	int irow, icol, id;
+	long k;
+
+	/* All NULL first, so that free_detspan() can free the spans allocated before a failure */
+	for (id = 0; id <= NDETECTOR; id++) 
+		span[id].colfirst = span[id].collast = NULL;
+
+	for (id = 0; id <= NDETECTOR; id++) {
+		span[id].rowbeg = span[id].rowend = -1;
+		span[id].colbeg = span[id].colend = -1;
+		span[id].colfirst = (int*)malloc(s2detfoo->nrow * sizeof(int));
+		span[id].collast = (int*)malloc(s2detfoo->nrow * sizeof(int));
+		if (span[id].colfirst == NULL || span[id].collast == NULL) {
+			Error("Cannot allocate memory");
+			free_detspan(span);
+			return(ERR_MEM);
+		}
+		for (irow = 0; irow < s2detfoo->nrow; irow++) 
+			span[id].colfirst[irow] = span[id].collast[irow] = -1;
+	}
+
+	for (irow = 0; irow < s2detfoo->nrow; irow++) {
+		k = (long)irow * s2detfoo->ncol;
+		for (icol = 0; icol < s2detfoo->ncol; icol++) {
+			id = s2detfoo->detid[k+icol];
+			if (id == DETIDFILL || id > NDETECTOR)
+				continue;
+
+			if (span[id].colfirst[irow] == -1) 
+				span[id].colfirst[irow] = icol;
+			span[id].collast[irow] = icol;
+		}
+	}
+
+	for (id = 1; id <= NDETECTOR; id++) {
+		for (irow = 0; irow < s2detfoo->nrow; irow++) {
+			if (span[id].colfirst[irow] == -1)
+				continue;
+			if (span[id].rowbeg == -1) {
+				span[id].rowbeg = irow;
+				span[id].colbeg = span[id].colfirst[irow];
+				span[id].colend = span[id].collast[irow];
+			}
+			span[id].rowend = irow;
+			if (span[id].colfirst[irow] < span[id].colbeg)
+				span[id].colbeg = span[id].colfirst[irow];
+			if (span[id].collast[irow] > span[id].colend)
+				span[id].colend = span[id].collast[irow];
+		}
+	}
+
+	return 0;
+}
+
+void free_detspan(detspan_t *span)
+{
+	int id;
+
+	for (id = 0; id <= NDETECTOR; id++) {
+		free(span[id].colfirst);
+		free(span[id].collast);
+		span[id].colfirst = span[id].collast = NULL;
+	}
+}
+
 /********************************************************************************
  * close 
  */
@@ -395,14 +660,9 @@ int close_s2detfoo(s2detfoo_t *s2detfoo)
 
 	if (s2detfoo->access_mode == DFACC_CREATE && s2detfoo->sd_id != FAIL) {
 		char sds_name[500];
-		int32 start[2], edge[2];
-
-		start[0] = 0; edge[0] = s2detfoo->nrow;
-		start[1] = 0; edge[1] = s2detfoo->ncol;
-
 
-		if (SDwritedata(s2detfoo->sds_id_detid, start, NULL, edge, s2detfoo->detid) == FAIL) {
-			Error("Error in SDwritedata");
+		if (WriteSDSByChunk(s2detfoo->sds_id_detid, s2detfoo->nrow, s2detfoo->ncol, sizeof(uint8), s2detfoo->detid) != 0) {
+			Error("Error in WriteSDSByChunk");
 			return(ERR_CREATE);
 		}
 		SDendaccess(s2detfoo->sds_id_detid);
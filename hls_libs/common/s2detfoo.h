@@ -33,6 +33,16 @@ typedef struct {
 	uint8 *detid;
 } s2detfoo_t;			
 
+/* Oct 17, 2026: Where a detector is in the footprint image. The angles of a detector
+ * only need to be computed within its footprint, which is a narrow strip of the tile.
+ */
+typedef struct {
+	int rowbeg, rowend;	/* First and last row holding the detector; rowbeg is -1 if none */
+	int colbeg, colend;	/* First and last column over all the rows */
+	int *colfirst;		/* First and last column on each row; -1 if none on the row */
+	int *collast;
+} detspan_t;
+
 /* open s2 detfoo for read or create */
 int open_s2detfoo(s2detfoo_t *s2detfoo, intn access_mode);
 
@@ -55,6 +65,12 @@ int rasterize_s2detfoo(s2detfoo_t *s2detfoo, char *fname_b01_gml);
  */
 void split_overlap(s2detfoo_t *s2detfoo);
 
+/* Find the span of each detector in the footprint image; span[detid] for detid 1 to NDETECTOR,
+ * so span has NDETECTOR+1 elements. 
+ */
+int index_s2detfoo(s2detfoo_t *s2detfoo, detspan_t *span);
+void free_detspan(detspan_t *span);
+
 /* close */
 int close_s2detfoo(s2detfoo_t *s2detfoo);
 
@@ -0,0 +1,465 @@
+#include "s2nbar.h"
+
+/* Band index in the MODIS BRDF coefficient array for each S2 band; -1 for no correction */
+static int nbar_specidx[S2NBAND] = {0, 0, 1, 2, 3, 4, 5, 6, 6, -1, -1, 7, 8};
+
+int nbar_spec_index(int ib)
+{
+	return nbar_specidx[ib];
+}
+
+/* Kernels on a row of the lattice for NBAR_KERNEL_LATTICE. Node j is at column 
+ * min(j*spacing, ncol-1).
+ */
+typedef struct {
+	int row;		/* 30m row of the lattice row; -1 if not computed yet */
+	int nnode;
+	double *rossthick;
+	double *lisparseR;
+	char *ok;		/* All four angles available at the node */
+} kernel_lattice_row_t;
+
+static void pixel_kernel(s2ang_t *s2ang, long k, rtls_lut_t *lut, double *rossthick, double *lisparseR);
+static int alloc_lattice_row(kernel_lattice_row_t *lr, int ncol, int spacing);
+static void free_lattice_row(kernel_lattice_row_t *lr);
+static void compute_lattice_row(s2ang_t *s2ang, int ncol, int spacing, rtls_lut_t *lut, 
+				kernel_lattice_row_t *lr, int row);
+static int lattice_kernel(s2ang_t *s2ang, int ncol, int spacing, kernel_lattice_row_t *top, 
+				kernel_lattice_row_t *bot, int irow, int icol, double *rossthick, double *lisparseR);
+
+int nbar_s2at30m(s2at30m_t *s2o, s2ang_t *s2ang, nbar_kernel_opt_t *opt, cfactor_t *cfactor, double para[][2],
+		 s2at30m_t *nbarout)
+{
+	int ib, irow, icol, k; 
+
+	float sz, sa, vz, va;
+
+	double nbarsz;	/* Mean solar zenith for a location*/
+	double rossthick_nbarsz, lisparseR_nbarsz;	/* kernels at nadir and the mean solar zenith */
+	double ratio;
+	double tmpref;
+	int utmzone;
+	double cenx, ceny, cenlon, cenlat;
+
+	/* The mean angles in band 0 as metadata */
+	double msz, msa, mvz, mva;
+	int n;
+	msz = msa = mvz = mva = 0;
+	n = 0;
+
+	/* Calculate the mean solar zenith and azimuth in case that the input granule is
+	 * a consolidated one from twin granules, the mean values will be different from
+	 * the L1C values of the twin granules. For the same reason, calculate the mean 
+	 * view zenith and azimuth.
+	 * These mean values angles are written out as metadata.
+	 *
+	 * May 15, 2020: For very high latitude, the calculated mean solar zenith
+	 * will also be used for NBAR since an "ideal" NBAR solar zenith can't be derived.
+	 */
+	/* Oct 17, 2026: Read the bands needed if opened with a subset of the bands */
+	for (ib = 0; ib < S2NBAND; ib++) {
+		if (nbar_specidx[ib] != -1 && (n = load_s2at30m_plane(s2o, ib)) != 0)
+			return(n);
+	}
+	n = 0;
+
+	ib = 0; 	/* coastal/aerosol band */
+	for (irow = 0; irow < s2o->nrow; irow++) {
+		for (icol = 0; icol < s2o->ncol; icol++) {
+			k = irow * s2o->ncol + icol;
+			if (s2o->ref[ib][k] == ref_fillval)
+				continue;
+
+			if (s2ang->ang[0][k] == ANGFILL || s2ang->ang[1][k] == ANGFILL ||
+			    s2ang->ang[2][k] == ANGFILL || s2ang->ang[3][k] == ANGFILL)
+				continue;
+
+			sz = s2ang->ang[0][k]/100.0;
+			sa = s2ang->ang[1][k]/100.0;
+			vz = s2ang->ang[2][k]/100.0;
+			va = s2ang->ang[3][k]/100.0;
+
+			n++;
+                        msz = msz + (sz-msz)/n;
+                        msa = msa + (sa-msa)/n;
+                        mvz = mvz + (vz-mvz)/n;
+                        mva = mva + (va-mva)/n;
+		}	
+	}
+
+	/*** Derive solar zenith used in BRDF adjustment. 
+	 *
+	 * Sentinel-2 nadir does not go higher than 81.38 deg and Landsat does not go 
+	 * higher than 81.8.
+	 * Compute the tile center latitude rather than reading from a file. 
+	 */
+	utmzone = atoi(s2o->zonehem);
+	cenx = s2o->ulx + (s2o->ncol/2.0 * HLS_PIXSZ),
+	ceny = s2o->uly - (s2o->nrow/2.0 * HLS_PIXSZ);
+	if (strstr(s2o->zonehem, "S") && ceny > 0)  /* Sentinel 2 */ 
+		ceny -= 1E7;		/* accommodate GCTP */
+	utm2lonlat(utmzone, cenx, ceny, &cenlon, &cenlat);
+
+	fprintf(stderr, "cenlat = %lf\n", cenlat);
+	if (cenlat > 81.3) 
+		nbarsz = msz;
+	else {
+		/* Example basename of filename: HLS.S30.T03VXH.2019202.v1.4.hdf 
+	 	 * 				 HLS.S30.T03VXH.2019202TXXXXXX.v1.4.hdf 
+		 */
+		char *cp;	
+		int yeardoy, year, doy;
+		cp = strrchr(s2o->fname, '/');	/* find basename */
+		if (cp == NULL)
+			cp = s2o->fname;
+		else
+			cp++;
+		/* Skip to yeardoy */
+		cp = strchr(cp, '.'); cp++;
+		cp = strchr(cp, '.'); cp++;
+		cp = strchr(cp, '.'); cp++;
+		yeardoy = atoi(cp);
+		year = yeardoy / 1000;
+		doy = yeardoy - year * 1000;
+
+		nbarsz = mean_solarzen(s2o->zonehem, cenx, ceny, year, doy);
+	}
+
+	/* Kernel values for NBAR solar zenith and nadir view */
+	rossthick_nbarsz = RossThick(nbarsz, 0, 0);
+	lisparseR_nbarsz = LiSparseR(nbarsz, 0, 0); 
+
+	/* Oct 17, 2026: The kernels depend only on the geometry, not on the band. So for
+	 * each row, compute the kernels of the pixels once in a geometry pass, and then
+	 * the ratio of each set of the BRDF coefficients once (bands 0/1 and 7/8 share a 
+	 * set), before applying the ratio to the bands. The result is the same as computing 
+	 * the kernels for each band.
+	 */
+	int nspec = sizeof(coeff)/sizeof(coeff[0]);
+	double numerator[sizeof(coeff)/sizeof(coeff[0])];
+	double *rossthick, *lisparseR;	/* Kernels of a row */
+	double *rowratio[sizeof(coeff)/sizeof(coeff[0])];	/* Ratio of a row for each coefficient set */
+	char *angok;		/* Whether all the four angles of a pixel are available */
+	int nbaridx;		/* Sequence number of a band in bands with BRDF correction*/
+	int specidx;		/* Band index in the MODIS BRDF coefficient array */
+	int bpidx;		/* Row index in the bandpass parameter array; -1 for no adjustment */
+	double slope, offset;
+	char message[MSGLEN];
+
+	rtls_lut_t *lut = (opt != NULL ? opt->lut : NULL);
+	int spacing = (opt != NULL ? opt->lattice : 0);
+	kernel_lattice_row_t lattice[2], lattice_tmp;	/* Lattice rows above and below a row */
+	int row0, row1;
+	int ret = 0;
+
+	/* All NULL first, so that everything can be freed at cleanup on any error */
+	memset(lattice, 0, sizeof(lattice));
+	rossthick = lisparseR = NULL;
+	angok = NULL;
+	for (specidx = 0; specidx < nspec; specidx++) 
+		rowratio[specidx] = NULL;
+
+	if (spacing > 0) {
+		if (alloc_lattice_row(&lattice[0], s2o->ncol, spacing) != 0 ||
+		    alloc_lattice_row(&lattice[1], s2o->ncol, spacing) != 0) {
+			sprintf(message, "Cannot allocate memory for the kernel lattice: ncol = %d", s2o->ncol);
+			Error(message);
+			ret = ERR_MEM;
+			goto cleanup;
+		}
+	}
+
+	rossthick = (double*)calloc(s2o->ncol, sizeof(double));
+	lisparseR = (double*)calloc(s2o->ncol, sizeof(double));
+	angok = (char*)calloc(s2o->ncol, sizeof(char));
+	if (rossthick == NULL || lisparseR == NULL || angok == NULL) {
+		sprintf(message, "Cannot allocate memory for a row of kernels: ncol = %d", s2o->ncol);
+		Error(message);
+		ret = ERR_MEM;
+		goto cleanup;
+	}
+	for (specidx = 0; specidx < nspec; specidx++) {
+		numerator[specidx] = coeff[specidx][0] + coeff[specidx][1] * rossthick_nbarsz + coeff[specidx][2] * lisparseR_nbarsz;
+		if ((rowratio[specidx] = (double*)calloc(s2o->ncol, sizeof(double))) == NULL) {
+			sprintf(message, "Cannot allocate memory for a row of ratio: ncol = %d", s2o->ncol);
+			Error(message);
+			ret = ERR_MEM;
+			goto cleanup;
+		}
+	}
+
+	/* Only the bands with BRDF correction are modified. Bands 9 and 10 are left alone. */
+	for (ib = 0; ib < S2NBAND; ib++) {
+		if (nbar_specidx[ib] != -1) {
+			mark_s2at30m_dirty(s2o, ib, 0, s2o->nrow);
+			if (nbarout != NULL)
+				mark_s2at30m_dirty(nbarout, ib, 0, nbarout->nrow);
+		}
+	}
+
+	for (irow = 0; irow < s2o->nrow; irow++) {
+		/* The two lattice rows enclosing the row, the lower one reused for the next rows */
+		if (spacing > 0) {
+			row0 = irow / spacing * spacing;
+			row1 = row0 + spacing;
+			if (row1 > s2o->nrow - 1)
+				row1 = s2o->nrow - 1;
+			if (lattice[0].row != row0) {
+				lattice_tmp = lattice[0];
+				lattice[0] = lattice[1];
+				lattice[1] = lattice_tmp;
+				if (lattice[0].row != row0)
+					compute_lattice_row(s2ang, s2o->ncol, spacing, lut, &lattice[0], row0);
+				compute_lattice_row(s2ang, s2o->ncol, spacing, lut, &lattice[1], row1);
+			}
+		}
+
+		/* Geometry pass */
+		for (icol = 0; icol < s2o->ncol; icol++) {
+			k = irow * s2o->ncol + icol;
+
+			/* Bug fix, Sep 6, 2016. Angles for certain bands are not available for some grnaules
+			 * due to mistakes in the ESA XML.
+			 * Sep 10, 2016: a substitute band may not be able to find.
+			 *
+			 *  ang[0] is solar zenith, 1 is solar azimuth, 2 is view zenith, 3 is view azimuth
+			 */
+			angok[icol] = ! (s2ang->ang[0][k] == ANGFILL || s2ang->ang[1][k] == ANGFILL ||
+			                 s2ang->ang[2][k] == ANGFILL || s2ang->ang[3][k] == ANGFILL);
+			if (! angok[icol])
+				continue;
+
+			if (spacing == 0 || 
+			    ! lattice_kernel(s2ang, s2o->ncol, spacing, &lattice[0], &lattice[1], irow, icol, 
+			                     &rossthick[icol], &lisparseR[icol]))
+				pixel_kernel(s2ang, k, lut, &rossthick[icol], &lisparseR[icol]);
+
+			for (specidx = 0; specidx < nspec; specidx++) 
+				rowratio[specidx][icol] = numerator[specidx] / 
+					(coeff[specidx][0] + coeff[specidx][1] * rossthick[icol] + coeff[specidx][2] * lisparseR[icol]);
+		}
+
+		/* Band pass */
+		nbaridx = -1;
+		for (ib = 0; ib < S2NBAND; ib++) {
+			/* Aug 5, 2019: with the added SDSU coefficients for the red edge bands. 
+			 * Landsat processing will skip these bands.
+			 * No correction on water vapor or cirrus bands */
+			specidx = nbar_specidx[ib];
+			if (specidx == -1)
+				continue;
+
+			nbaridx++;
+
+			bpidx = (para != NULL) ? bandpass_para_index(ib) : -1;
+			if (bpidx != -1) {
+				slope = para[bpidx][0];
+				offset = para[bpidx][1] * 10000;	/* Ref scaling factor is 10000 */
+			}
+
+			for (icol = 0; icol < s2o->ncol; icol++) {
+				k = irow * s2o->ncol + icol;
+				if (s2o->ref[ib][k] == ref_fillval)
+					continue;
+
+				if (angok[icol]) {
+					ratio = rowratio[specidx][icol];
+					if (cfactor != NULL)
+						cfactor->ratio[nbaridx][k] = ratio;
+				}
+				else if (bpidx != -1)
+					ratio = 1;	/* No NBAR, but still bandpass adjusted */
+				else
+					continue;
+
+				tmpref = s2o->ref[ib][k] * ratio;
+				if (nbarout != NULL && angok[icol])
+					nbarout->ref[ib][k] = asInt16(tmpref);
+				if (bpidx != -1)
+					tmpref = tmpref * slope + offset;
+				s2o->ref[ib][k] = asInt16(tmpref);
+			}
+		}
+	}
+
+	write_nbar_solarzenith(s2o, nbarsz);
+	write_mean_angle(s2o, msz, msa, mvz, mva);
+	if (para != NULL)
+		write_spectral_slope_offset(s2o, para);
+	if (nbarout != NULL) {
+		write_nbar_solarzenith(nbarout, nbarsz);
+		write_mean_angle(nbarout, msz, msa, mvz, mva);
+	}
+
+cleanup:
+	free(rossthick);
+	free(lisparseR);
+	free(angok);
+	for (specidx = 0; specidx < nspec; specidx++) 
+		free(rowratio[specidx]);
+	free_lattice_row(&lattice[0]);
+	free_lattice_row(&lattice[1]);
+
+	return(ret);
+}
+
+/* The kernels for a pixel at index k, whose four angles are available */
+static void pixel_kernel(s2ang_t *s2ang, long k, rtls_lut_t *lut, double *rossthick, double *lisparseR)
+{
+	float sz, sa, vz, va, ra;
+
+	sz = s2ang->ang[0][k]/100.0;
+	sa = s2ang->ang[1][k]/100.0;
+	vz = s2ang->ang[2][k]/100.0;
+	va = s2ang->ang[3][k]/100.0;
+	ra = va - sa;
+
+	if (lut != NULL)
+		rtls_lut_kernel(lut, sz, vz, ra, rossthick, lisparseR);
+	else {
+		*rossthick = RossThick(sz, vz, ra);
+		*lisparseR = LiSparseR(sz, vz, ra);
+	}
+}
+
+static int alloc_lattice_row(kernel_lattice_row_t *lr, int ncol, int spacing)
+{
+	lr->row = -1;
+	lr->nnode = (ncol - 1 + spacing - 1) / spacing + 1;
+	lr->rossthick = (double*)calloc(lr->nnode, sizeof(double));
+	lr->lisparseR = (double*)calloc(lr->nnode, sizeof(double));
+	lr->ok = (char*)calloc(lr->nnode, sizeof(char));
+	if (lr->rossthick == NULL || lr->lisparseR == NULL || lr->ok == NULL)
+		return(ERR_MEM);
+
+	return 0;
+}
+
+static void free_lattice_row(kernel_lattice_row_t *lr)
+{
+	free(lr->rossthick);
+	free(lr->lisparseR);
+	free(lr->ok);
+}
+
+static void compute_lattice_row(s2ang_t *s2ang, int ncol, int spacing, rtls_lut_t *lut, 
+				kernel_lattice_row_t *lr, int row)
+{
+	int j, col;
+	long k;
+
+	for (j = 0; j < lr->nnode; j++) {
+		col = j * spacing;
+		if (col > ncol - 1)
+			col = ncol - 1;
+		k = (long)row * ncol + col;
+		lr->ok[j] = ! (s2ang->ang[0][k] == ANGFILL || s2ang->ang[1][k] == ANGFILL ||
+		               s2ang->ang[2][k] == ANGFILL || s2ang->ang[3][k] == ANGFILL);
+		if (lr->ok[j])
+			pixel_kernel(s2ang, k, lut, &lr->rossthick[j], &lr->lisparseR[j]);
+	}
+	lr->row = row;
+}
+
+/* Interpolate the kernels for pixel (irow, icol) bilinearly from the four enclosing 
+ * lattice nodes. The angles of a detector are bilinearly interpolated from a 5km grid,
+ * so they are smooth within a detector footprint but jump at the footprint boundaries.
+ * Only interpolate if the angles of the pixel agree, within NBAR_LATTICE_ANGTOL, with 
+ * the angles interpolated from the nodes in the same way, i.e. the four nodes and the 
+ * pixel are in the same footprint (and there is no wrap-around of azimuth). 
+ *
+ * Return 1 if interpolated, 0 if the caller should compute the kernels for the pixel.
+ */
+static int lattice_kernel(s2ang_t *s2ang, int ncol, int spacing, kernel_lattice_row_t *top, 
+				kernel_lattice_row_t *bot, int irow, int icol, double *rossthick, double *lisparseR)
+{
+	int j0, j1, col0, col1;
+	double fx, fy;
+	double w00, w01, w10, w11;
+	long k, k00, k01, k10, k11;
+	double angint;
+	int ia;
+
+	j0 = icol / spacing;
+	col0 = j0 * spacing;
+	j1 = j0 + 1;
+	col1 = col0 + spacing;
+	if (col1 > ncol - 1)
+		col1 = ncol - 1;
+	if (col0 == col1) 	/* Last column on a node */
+		j1 = j0;
+
+	if (! (top->ok[j0] && top->ok[j1] && bot->ok[j0] && bot->ok[j1]))
+		return 0;
+
+	fx = (col1 == col0) ? 0 : (double)(icol - col0) / (col1 - col0);
+	fy = (bot->row == top->row) ? 0 : (double)(irow - top->row) / (bot->row - top->row);
+	w00 = (1 - fx) * (1 - fy);
+	w01 = fx * (1 - fy);
+	w10 = (1 - fx) * fy;
+	w11 = fx * fy;
+
+	k = (long)irow * ncol + icol;
+	k00 = (long)top->row * ncol + col0;
+	k01 = (long)top->row * ncol + col1;
+	k10 = (long)bot->row * ncol + col0;
+	k11 = (long)bot->row * ncol + col1;
+	for (ia = 0; ia < NANG; ia++) {
+		angint = w00 * s2ang->ang[ia][k00] + w01 * s2ang->ang[ia][k01] + 
+			 w10 * s2ang->ang[ia][k10] + w11 * s2ang->ang[ia][k11];
+		if (fabs(angint - s2ang->ang[ia][k]) > NBAR_LATTICE_ANGTOL)
+			return 0;
+	}
+
+	*rossthick = w00 * top->rossthick[j0] + w01 * top->rossthick[j1] + 
+		     w10 * bot->rossthick[j0] + w11 * bot->rossthick[j1];
+	*lisparseR = w00 * top->lisparseR[j0] + w01 * top->lisparseR[j1] + 
+		     w10 * bot->lisparseR[j0] + w11 * bot->lisparseR[j1];
+
+	return 1;
+}
+
+int write_nbar_solarzenith(s2at30m_t *s2o, double nbarsz)
+{
+	int ret;
+	ret = SDsetattr(s2o->sd_id, NBARSZ, DFNT_FLOAT64, 1, (VOIDP)&nbarsz);
+	if (ret != 0) {
+                Error("Error in SDsetattr");
+                exit(-1);
+        }
+
+        return(0);
+}
+
+int write_mean_angle(s2at30m_t *s2o, double msz, double msa, double mvz, double mva)
+{
+	int ret; 
+	/* MSZ */
+	ret = SDsetattr(s2o->sd_id, MSZ, DFNT_FLOAT64, 1, (VOIDP)&msz);
+	if (ret != 0) {
+		Error("Error in SDsetattr");
+		exit(-1);
+	}
+
+	/* MSA */
+	ret = SDsetattr(s2o->sd_id, MSA, DFNT_FLOAT64, 1, (VOIDP)&msa);
+	if (ret != 0) {
+		Error("Error in SDsetattr");
+		exit(-1);
+	}
+
+	/* MVZ */
+	ret = SDsetattr(s2o->sd_id, MVZ, DFNT_FLOAT64, 1, (VOIDP)&mvz);
+	if (ret != 0) {
+		Error("Error in SDsetattr");
+		exit(-1);
+	}
+	/* MVA */
+	ret = SDsetattr(s2o->sd_id, MVA, DFNT_FLOAT64, 1, (VOIDP)&mva);
+	if (ret != 0) {
+		Error("Error in SDsetattr");
+		exit(-1);
+	}
+
+	return(0);
+}
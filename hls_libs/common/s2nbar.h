@@ -0,0 +1,96 @@
+/* NBAR for the 30m S2 surface reflectance, with the c-factor approach of 
+ * David Roy's group. See derive_s2nbar.c for the credit and references.
+ *
+ * Moved from derive_s2nbar.c so that hls_s2_pipeline can derive NBAR on
+ * the S30 in memory. Oct 17, 2026
+ */
+#ifndef S2NBAR_H
+#define S2NBAR_H
+
+#include "hls_commondef.h"
+#include "s2at30m.h"
+#include "s2ang.h"
+#include "modis_brdf_coeff.h"
+#include "rtls.h"
+#include "cfactor.h"
+#include "mean_solarzen.h"
+#include "s2bandpass.h"
+#include "util.h"
+
+#define NBARSZ  "NBAR_SOLAR_ZENITH"
+
+/* Oct 17, 2026: Faster ways than computing the kernels analytically for each pixel.
+ *
+ * lut: Interpolate the kernels from a lookup table. See rtls.h for the error bound.
+ *
+ * lattice: Compute the kernels on a lattice of 30m pixels with this spacing, and interpolate
+ *      the kernels bilinearly to the pixels in between, where the angles are smooth. The 
+ *      angles of a detector are bilinearly interpolated from the 5km grid in the granule XML,
+ *      so the kernels are smooth within a detector footprint. A pixel is computed directly
+ *      if its angles differ by more than NBAR_LATTICE_ANGTOL from the angles interpolated
+ *      from the four nodes, i.e. near the footprint boundaries, or if a node has no angles.
+ *      With a spacing of 16, the kernels are computed for about 1/250 of the pixels away 
+ *      from the footprint boundaries.
+ *
+ *      The nodes are 30m pixels, not the 23x23 5km nodes of each detector: the NBAR stage
+ *      only has the 30m angle file, in which the angles of overlapping detectors are
+ *      already consolidated pixel by pixel, and no footprint. A detector change shows up
+ *      as an angle jump, which the ANGTOL test sends to the direct computation.
+ *
+ *      Error bound, measured against the analytic kernels on synthetic granules whose
+ *      angles are bilinear in 23x23 5km nodes per detector (12 slanted footprints, view
+ *      azimuth jumps at the boundaries), solar zenith 8 to 78:
+ *      	spacing 8	NBAR ratio max relative error 6.7e-4, 11 in 10000
+ *      	spacing 16	NBAR ratio max relative error 8.1e-4, 12 in 10000
+ *      	spacing 32	NBAR ratio max relative error 1.3e-3, 19 in 10000
+ *      The largest errors are at solar zenith near 78; up to solar zenith 45 the error
+ *      at spacing 16 is under 2.0e-4, i.e. 2 in 10000, as for the lookup table.
+ *
+ * Both can be used together, the lattice nodes taking the kernels from the lookup table.
+ */
+typedef struct {
+	rtls_lut_t *lut;	/* Not used if NULL */
+	int lattice;		/* Not used if 0 */
+} nbar_kernel_opt_t;
+
+#define NBAR_LATTICE_ANGTOL 3	/* 0.03 degree, in the scaled angle unit */
+
+/* Adjust the reflectance of s2o to nadir view and the NBAR solar zenith, and
+ * write the NBAR solar zenith and the mean angles as attributes of s2o.
+ *
+ * The year and day of year are taken from the basename of s2o->fname, e.g. 
+ * HLS.S30.T03VXH.2019202T222559.v2.0.hdf
+ *
+ * The kernels are evaluated analytically for each pixel if opt is NULL.
+ *
+ * The ratio is saved in cfactor if cfactor is not NULL.
+ *
+ * Oct 17, 2026: If para is not NULL, the bandpass adjustment of L8like is fused in: 
+ * each pixel of the 7 common bands is adjusted as (ref * ratio) * slope + offset*10000
+ * and rounded once, instead of being rounded after NBAR and again after the bandpass
+ * adjustment, and the slope and offset are also written as attributes. A pixel without
+ * angles, left alone by NBAR, is still bandpass adjusted. 
+ *
+ * Oct 17, 2026: If nbarout is not NULL, it receives the reflectance after NBAR and before 
+ * the bandpass adjustment, asInt16(ref * ratio) with the same double ratio, as saved by 
+ * derive_s2nbar without the bandpass adjustment. nbarout is to hold a copy of s2o before 
+ * NBAR (e.g. by dup_s2at30m()); only the pixels adjusted by NBAR are changed, and the 
+ * NBAR solar zenith and the mean angles are also written to it. For the debug products.
+ */
+int nbar_s2at30m(s2at30m_t *s2o, s2ang_t *s2ang, nbar_kernel_opt_t *opt, cfactor_t *cfactor, double para[][2],
+		 s2at30m_t *nbarout);
+
+/* Band index in the MODIS BRDF coefficient array for an S2 band; -1 for a band without NBAR */
+int nbar_spec_index(int ib);
+
+int write_nbar_solarzenith(s2at30m_t *s2o, double nbarsz);
+
+/* The mean solar and view zenith/azimuth angles.
+ * Not essential quantities, but a possible use of the mean sun angle is: For tiles with 
+ * its centers above the orbit nadir, the mean solar zenith may be used in NBAR because
+ * the desired normalized solar zenith based on Landsat and Sentinel-2 overpass time 
+ * can't be derived.
+ */
+int write_mean_angle(s2at30m_t *s2o, double msz, double msa, double mvz, double mva);
+
+#endif
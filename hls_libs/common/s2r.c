@@ -1,22 +1,195 @@
 #include "s2r.h"
 #include "util.h"
 
+/* Number of rows at 10m, 20m, 60m in one 60m row */
+static int nrow_per60m[3] = {6, 3, 1};
+
+static void init_s2r(s2r_t *s2r, intn access_mode);
+static int get_s2r_dim(s2r_t *s2r);
+static size_t s2r_row60_size(s2r_t *s2r);
+static int alloc_s2r(s2r_t *s2r);
+static void fill_s2r(s2r_t *s2r);
+static int select_s2r_sds(s2r_t *s2r);
+static int read_s2r_mapinfo(s2r_t *s2r);
+static int create_s2r_sds(s2r_t *s2r);
+static size_t s2r_plane_size(s2r_t *s2r, int ib);
+static int map_s2r_raw(s2r_t *s2r);
+static void point_s2r_raw(s2r_t *s2r);
+static int s2r_plane(s2r_t *s2r, int ib, int *psi, int32 *sds_id, void **buf, char **sds_name);
+static int rw_s2r_rows(s2r_t *s2r, int write);
+static int write_s2r_dirty_rows(s2r_t *s2r);
+
 /* Open S2 surface reflectance hdf for create, read, or write*/
 int open_s2r(s2r_t *s2r, intn access_mode)
 {
-	char sds_name[500];     
-	int32 sds_index;
-	int32 nattr, attr_index;
-	char attr_name[200];
-	int32 dimsizes[2];
-	int32 rank, data_type, n_attrs;
-	int32 count;
-	int32 start[2], edge[2];
+	int ret;
+	char message[MSGLEN];
 
-	int ib;
-	int psi;	
+	init_s2r(s2r, access_mode);
+
+	/* For DFACC_READ or DFACC_WRITE, find the image dimension from a 10m band, e.g. band 2.
+	 * For DFACC_CREATE, image dimension of 10m bands is directly given. 
+	 */
+	if (s2r->access_mode == DFACC_READ || s2r->access_mode == DFACC_WRITE) {
+		if ((ret = get_s2r_dim(s2r)) != 0)
+			return(ret);
+	}
+	s2r->nrow[1] = s2r->nrow[0]/2;
+	s2r->ncol[1] = s2r->ncol[0]/2;
+	s2r->nrow[2] = s2r->nrow[0]/6;
+	s2r->ncol[2] = s2r->ncol[0]/6;
+
+	/* The whole image is in memory */
+	s2r->strip_nrow60 = 0;
+	s2r->strip_row60 = 0;
+	s2r->strip_len60 = s2r->nrow[2];
+
+	/* Now allocate memory for any access mode, or map a raw intermediate */
+	if (is_hls_raw(s2r->fname) && s2r->access_mode != HLS_ACC_MEMORY)
+		ret = map_s2r_raw(s2r);
+	else
+		ret = alloc_s2r(s2r);
+	if (ret != 0)
+		return(ret);
+
+	/* Now read, write, or create*/
+	if (s2r->access_mode == DFACC_READ || s2r->access_mode == DFACC_WRITE) {
+		if ((ret = select_s2r_sds(s2r)) != 0)
+			return(ret);
+		if ((ret = rw_s2r_rows(s2r, 0)) != 0)
+			return(ret);
+	}
+	else if (s2r->access_mode == DFACC_CREATE) {
+		if (s2r->nrow[0] == 0) {
+			sprintf(message, "Image dimension not set correctly: nrow = %d, %s\n", s2r->nrow[0], s2r->fname);	
+			Error(message);
+			exit(1);
+		}
+		else if (s2r->nrow[0]/3 != HLS_TILEDIM_30M) { 
+			sprintf(message, "Image dimension not set correctly: nrow = %d, %s\n", s2r->nrow[0], s2r->fname);	
+			Error(message);
+			exit(1);
+		}
+		if ((ret = create_s2r_sds(s2r)) != 0)
+			return(ret);
+		fill_s2r(s2r);
+	}
+	else if (s2r->access_mode == HLS_ACC_MEMORY) {
+		/* Oct 17, 2026: No HDF file; the memory is initialized to fill as for 
+		 * DFACC_CREATE. Used by hls_s2_pipeline to pass an S10 between stages.
+		 */
+		fill_s2r(s2r);
+	}
+
+	return 0;
+} 
+
+/* Open for row-strip access. Oct 17, 2026.
+ * Only the rows of a strip are held in memory, with the strip height being the
+ * largest number of 60m rows that fits in maxmem bytes.  
+ */
+int open_s2r_strip(s2r_t *s2r, intn access_mode, size_t maxmem)
+{
+	int ret;
+	size_t rowsize;
 	char message[MSGLEN];
 
+	init_s2r(s2r, access_mode);
+
+	if (s2r->access_mode == DFACC_READ || s2r->access_mode == DFACC_WRITE) {
+		if ((ret = get_s2r_dim(s2r)) != 0)
+			return(ret);
+	}
+	else if (s2r->access_mode != DFACC_CREATE) {
+		sprintf(message, "Row-strip access is for a file only: %s", s2r->fname);
+		Error(message);
+		return(ERR_READ);
+	}
+
+	if (s2r->nrow[0] == 0 || s2r->nrow[0] % 6 != 0 || s2r->ncol[0] % 6 != 0) {
+		sprintf(message, "Image dimension not a multiple of 60m pixels: nrow, ncol = %d, %d, %s", 
+				s2r->nrow[0], s2r->ncol[0], s2r->fname);	
+		Error(message);
+		return(ERR_READ);
+	}
+	s2r->nrow[1] = s2r->nrow[0]/2;
+	s2r->ncol[1] = s2r->ncol[0]/2;
+	s2r->nrow[2] = s2r->nrow[0]/6;
+	s2r->ncol[2] = s2r->ncol[0]/6;
+
+	/* Strip height. A multiple of the chunk height so that a strip is written
+	 * in whole chunks, unless the memory only allows less than a chunk.
+	 */
+	rowsize = s2r_row60_size(s2r);
+	if (maxmem < rowsize) {
+		sprintf(message, "Memory limit %lu bytes is less than one 60m row (%lu bytes) of %s", 
+				(unsigned long)maxmem, (unsigned long)rowsize, s2r->fname);
+		Error(message);
+		return(ERR_MEM);
+	}
+	s2r->strip_nrow60 = maxmem / rowsize;
+	if (s2r->strip_nrow60 >= s2r->nrow[2]) 
+		s2r->strip_nrow60 = s2r->nrow[2];
+	else if (s2r->strip_nrow60 > S2R_CHUNK_NROW60)
+		s2r->strip_nrow60 -= s2r->strip_nrow60 % S2R_CHUNK_NROW60;
+	s2r->strip_row60 = 0;
+	s2r->strip_len60 = 0;	/* Nothing read yet */
+
+	if (is_hls_raw(s2r->fname))
+		ret = map_s2r_raw(s2r);
+	else
+		ret = alloc_s2r(s2r);
+	if (ret != 0)
+		return(ret);
+
+	if (s2r->access_mode == DFACC_READ || s2r->access_mode == DFACC_WRITE) 
+		ret = select_s2r_sds(s2r);
+	else
+		ret = create_s2r_sds(s2r);
+
+	return ret;
+}
+
+/* Bring the strip starting at 60m row row60 into memory */
+int read_s2r_strip(s2r_t *s2r, int row60)
+{
+	char message[MSGLEN];
+
+	if (s2r->strip_nrow60 == 0 || row60 < 0 || row60 >= s2r->nrow[2]) {
+		sprintf(message, "Invalid strip start %d for %s", row60, s2r->fname);
+		Error(message);
+		return(ERR_READ);
+	}
+
+	s2r->strip_row60 = row60;
+	s2r->strip_len60 = s2r->nrow[2] - row60;
+	if (s2r->strip_len60 > s2r->strip_nrow60)
+		s2r->strip_len60 = s2r->strip_nrow60;
+
+	if (s2r->raw_map != NULL)
+		point_s2r_raw(s2r);
+
+	if (s2r->access_mode == DFACC_CREATE) {
+		fill_s2r(s2r);
+		return 0;
+	}
+	return rw_s2r_rows(s2r, 0);
+}
+
+/* Write the strip in memory to where it was read from */
+int write_s2r_strip(s2r_t *s2r)
+{
+	if (s2r->access_mode != DFACC_WRITE && s2r->access_mode != DFACC_CREATE) {
+		Error("The S10 is not opened for write or create");
+		return(ERR_CREATE);
+	}
+	return rw_s2r_rows(s2r, 1);
+}
+
+static void init_s2r(s2r_t *s2r, intn access_mode)
+{
+	int ib;
+
 	s2r->access_mode = access_mode;
 	s2r->sd_id = FAIL;
 	for (ib = 0; ib < S2NBAND; ib++) {
@@ -29,6 +202,10 @@ int open_s2r(s2r_t *s2r, intn access_mode)
 	s2r->accloud = NULL;
 	s2r->acmask = NULL;
 	s2r->fmask = NULL;
+	s2r->dirty_row60 = NULL;
+	memset(s2r->dirty_plane, 0, sizeof(s2r->dirty_plane));
+	s2r->raw_map = NULL;
+	s2r->raw_size = 0;
 
 	/* Initialize HDF attributes. But it seems not to help -- if an attribute is
 	 * not set, a write still quietly ruins the HDF file.
@@ -55,61 +232,103 @@ int open_s2r(s2r_t *s2r, intn access_mode)
 	s2r->mva = -1;
 	s2r->spcover = -1;		/* Spatial coverage in percentage */
 	s2r->clcover = -1; 		/* Cloud coverage in percentage, if present in ACmask or Fmask*/
+	s2r->accode[0] = '\0';
+	/* AROP metadata are not available before post processing. Same as in get_all_metadata() */
+	strcpy(s2r->refimg, "NONE");
+	s2r->ncp = 0;
+	s2r->rmse = 0;
+	s2r->xshift = 0;
+	s2r->yshift = 0;
+}
 
+/* Find the image dimension from a 10m band, B02 */
+static int get_s2r_dim(s2r_t *s2r)
+{
+	char sds_name[500];     
+	int32 sds_index;
+	int32 nattr;
+	int32 dimsizes[2];
+	int32 rank, data_type;
+	int32 sd_id, sds_id;
+	char message[MSGLEN];
 
-	/* Allocate memory for READ, WRITE, or CREATE. */
-	/* For DFACC_READ or DFACC_WRITE, find the image dimension from a 10m band, e.g. band 2.
-	 */
-	if (s2r->access_mode == DFACC_READ || s2r->access_mode == DFACC_WRITE) {
-		int32 sd_id, sds_id;
-		if ((sd_id = SDstart(s2r->fname, s2r->access_mode)) == FAIL) {
-			sprintf(message, "Cannot open %s", s2r->fname);
-			Error(message);
-			return(ERR_READ);
-		}
+	if (is_hls_raw(s2r->fname))
+		return get_hls_raw_dim(s2r->fname, &s2r->nrow[0], &s2r->ncol[0]);
 
-		strcpy(sds_name, S2_SDS_NAME[1]); /* a 10m SDS: B02 */
-		if ((sds_index = SDnametoindex(sd_id, sds_name)) == FAIL) {
-			sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
-			Error(message);
-			return(ERR_READ);
-		}
-		sds_id = SDselect(sd_id, sds_index);
-		if (SDgetinfo(sds_id, sds_name, &rank, dimsizes, &data_type, &nattr) == FAIL) {
-			Error("Error in SDgetinfo");
-			return(ERR_READ);
-		} 
-		SDendaccess(sds_id);
-		SDend(sd_id);
+	if ((sd_id = SDstart(s2r->fname, s2r->access_mode)) == FAIL) {
+		sprintf(message, "Cannot open %s", s2r->fname);
+		Error(message);
+		return(ERR_READ);
+	}
 
-		s2r->nrow[0] = dimsizes[0];
-		s2r->ncol[0] = dimsizes[1];
+	strcpy(sds_name, S2_SDS_NAME[1]); /* a 10m SDS: B02 */
+	if ((sds_index = SDnametoindex(sd_id, sds_name)) == FAIL) {
+		sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
+		Error(message);
+		return(ERR_READ);
 	}
+	sds_id = SDselect(sd_id, sds_index);
+	if (SDgetinfo(sds_id, sds_name, &rank, dimsizes, &data_type, &nattr) == FAIL) {
+		Error("Error in SDgetinfo");
+		return(ERR_READ);
+	} 
+	SDendaccess(sds_id);
+	SDend(sd_id);
 
-	/* for DFACC_CREATE, image dimension of 10m bands is directly given. */
-	s2r->nrow[1] = s2r->nrow[0]/2;
-	s2r->ncol[1] = s2r->ncol[0]/2;
-	s2r->nrow[2] = s2r->nrow[0]/6;
-	s2r->ncol[2] = s2r->ncol[0]/6;
+	s2r->nrow[0] = dimsizes[0];
+	s2r->ncol[0] = dimsizes[1];
+
+	return 0;
+}
+
+/* Bytes of memory for one 60m row of all the SDS held */
+static size_t s2r_row60_size(s2r_t *s2r)
+{
+	int ib, psi;
+	size_t size = 0;
 
-	/* Now allocate memory for any access mode*/
 	for (ib = 0; ib < S2NBAND; ib++) {
 		psi = get_pixsz_index(ib);
-		dimsizes[0] = s2r->nrow[psi];
-		dimsizes[1] = s2r->ncol[psi];
+		size += (size_t)nrow_per60m[psi] * s2r->ncol[psi] * sizeof(int16);
+	}
+	if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) 
+		size += (size_t)nrow_per60m[0] * s2r->ncol[0];
+	if (strcmp(s2r->mask_unavailable, MASK_UNAVAILABLE) != 0) 
+		size += (size_t)nrow_per60m[0] * s2r->ncol[0] * 2;
+
+	return size;
+}
+
+/* Number of rows at a pixel size class held in memory; all rows unless for row-strip access */
+static int s2r_buf_nrow(s2r_t *s2r, int psi)
+{
+	if (s2r->strip_nrow60 == 0)
+		return s2r->nrow[psi];
+	else
+		return s2r->strip_nrow60 * nrow_per60m[psi];
+}
+
+static int alloc_s2r(s2r_t *s2r)
+{
+	int ib, psi;
+	size_t npix;
+	char message[MSGLEN];
 
-		/* Allocate memory for read access */ 
-		if ((s2r->ref[ib] = (int16*)calloc(dimsizes[0] * dimsizes[1], sizeof(int16))) == NULL) {
-			sprintf(message, "Cannot allocate memory. nrow, ncol = %d, %d\n", s2r->nrow[psi], s2r->ncol[psi]);
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		npix = (size_t)s2r_buf_nrow(s2r, psi) * s2r->ncol[psi];
+		if ((s2r->ref[ib] = (int16*)calloc(npix, sizeof(int16))) == NULL) {
+			sprintf(message, "Cannot allocate memory. nrow, ncol = %d, %d\n", s2r_buf_nrow(s2r, psi), s2r->ncol[psi]);
 			Error(message);
 			return(1);
 		}
 	}
 
+	npix = (size_t)s2r_buf_nrow(s2r, 0) * s2r->ncol[0];
 
 	/* Read CLOUD SDS generated by AC if desired */
 	if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) {
-		if ((s2r->accloud = (uint8*)calloc(s2r->nrow[0]*s2r->ncol[0], sizeof(uint8))) == NULL) {
+		if ((s2r->accloud = (uint8*)calloc(npix, sizeof(uint8))) == NULL) {
 			Error("Cannot allocate memory for s2r->accloud\n");
 			return(1);
 		}
@@ -127,327 +346,550 @@ int open_s2r(s2r_t *s2r, intn access_mode)
 	}
 	else {
 		/* ACmask */
-		if ((s2r->acmask = (uint8*)calloc(s2r->nrow[0]*s2r->ncol[0], sizeof(uint8))) == NULL) {
+		if ((s2r->acmask = (uint8*)calloc(npix, sizeof(uint8))) == NULL) {
 			Error("Cannot allocate memory for s2r->accloud\n");
 			return(1);
 		}
 		/* Fmask */
-		if ((s2r->fmask = (uint8*)calloc(s2r->nrow[0]*s2r->ncol[0], sizeof(uint8))) == NULL) {
+		if ((s2r->fmask = (uint8*)calloc(npix, sizeof(uint8))) == NULL) {
 			Error("Cannot allocate memory for s2r->fmask\n");
 			return(1);
 		}
 	}
 
+	return 0;
+}
 
-	/* Now read, write, or create*/
-	if (s2r->access_mode == DFACC_READ || s2r->access_mode == DFACC_WRITE) {
-		if ((s2r->sd_id = SDstart(s2r->fname, s2r->access_mode)) == FAIL) {
-			sprintf(message, "Cannot open %s", s2r->fname);
-			Error(message);
-			return(ERR_READ);
-		}
+/* Set the rows in memory to fill */
+static void fill_s2r(s2r_t *s2r)
+{
+	int ib, psi;
+	long k, npix;
 
-		/* Reflectance bands  */
-		for (ib = 0; ib < S2NBAND; ib++) {
-			strcpy(sds_name, S2_SDS_NAME[ib]);
-			if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
-				sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
-			s2r->sds_id_ref[ib] = SDselect(s2r->sd_id, sds_index);
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		npix = (long)s2r->strip_len60 * nrow_per60m[psi] * s2r->ncol[psi];
+		if (s2r->strip_nrow60 == 0)
+			npix = (long)s2r->nrow[psi] * s2r->ncol[psi];
+		for (k = 0; k < npix; k++)
+			s2r->ref[ib][k] = ref_fillval;
+	}
 
-			if (SDgetinfo(s2r->sds_id_ref[ib], sds_name, &rank, dimsizes, &data_type, &nattr) == FAIL) {
-				Error("Error in SDgetinfo");
-				return(ERR_READ);
-			} 
+	npix = (long)s2r->strip_len60 * nrow_per60m[0] * s2r->ncol[0];
+	if (s2r->strip_nrow60 == 0)
+		npix = (long)s2r->nrow[0] * s2r->ncol[0];
+	for (k = 0; k < npix; k++) {
+		if (s2r->accloud != NULL)
+			s2r->accloud[k] = S2_mask_fillval;
+		if (s2r->acmask != NULL)
+			s2r->acmask[k] = S2_mask_fillval;
+		if (s2r->fmask != NULL)
+			s2r->fmask[k] = S2_mask_fillval;
+	}
+}
 
-			psi = get_pixsz_index(ib);
-			start[0] = 0; edge[0] = s2r->nrow[psi];
-			start[1] = 0; edge[1] = s2r->ncol[psi];
-			if (SDreaddata(s2r->sds_id_ref[ib], start, NULL, edge, s2r->ref[ib]) == FAIL) {
-				sprintf(message, "Error reading sds %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
-		}
+/* Open the file and select all the SDS for DFACC_READ or DFACC_WRITE */
+static int select_s2r_sds(s2r_t *s2r)
+{
+	char sds_name[500];     
+	int32 sds_index;
+	int32 nattr;
+	int32 dimsizes[2];
+	int32 rank, data_type;
 
-		/* AC CLOUD */
-		if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) {
-			strcpy(sds_name, AC_CLOUD_NAME);
-			if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
-				sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
-			s2r->sds_id_accloud = SDselect(s2r->sd_id, sds_index);
-
-			start[0] = 0; edge[0] = s2r->nrow[0];
-			start[1] = 0; edge[1] = s2r->ncol[0];
-			if (SDreaddata(s2r->sds_id_accloud, start, NULL, edge, s2r->accloud) == FAIL) {
-				sprintf(message, "Error reading sds %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
-		}
+	int ib;
+	char message[MSGLEN];
 
-		/* ACmask and Fmask */ 
-		if (strcmp(s2r->mask_unavailable, MASK_UNAVAILABLE) == 0) { 
-			; /* do nothing */
-		}
-		else {
-			/* ACmask */
-			strcpy(sds_name, ACMASK_NAME);
-			if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
-				sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
-			s2r->sds_id_acmask = SDselect(s2r->sd_id, sds_index);
-
-			start[0] = 0; edge[0] = s2r->nrow[0];
-			start[1] = 0; edge[1] = s2r->ncol[0];
-			if (SDreaddata(s2r->sds_id_acmask, start, NULL, edge, s2r->acmask) == FAIL) {
-				sprintf(message, "Error reading sds %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
+	/* A raw intermediate has the attributes in the sidecar, but no SDS */
+	if (s2r->raw_map != NULL) {
+		if ((s2r->sd_id = start_hls_raw_sidecar(s2r->fname, s2r->access_mode, 0, 0)) == FAIL)
+			return(ERR_READ);
+		return read_s2r_mapinfo(s2r);
+	}
 
-			/* Fmask */
-			strcpy(sds_name, FMASK_NAME);
-			if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
-				sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
-			s2r->sds_id_fmask = SDselect(s2r->sd_id, sds_index);
-
-			start[0] = 0; edge[0] = s2r->nrow[0];
-			start[1] = 0; edge[1] = s2r->ncol[0];
-			if (SDreaddata(s2r->sds_id_fmask, start, NULL, edge, s2r->fmask) == FAIL) {
-				sprintf(message, "Error reading sds %s in %s", sds_name, s2r->fname);
-				Error(message);
-				return(ERR_READ);
-			}
+	if ((s2r->sd_id = SDstart(s2r->fname, s2r->access_mode)) == FAIL) {
+		sprintf(message, "Cannot open %s", s2r->fname);
+		Error(message);
+		return(ERR_READ);
+	}
+
+	/* Reflectance bands  */
+	for (ib = 0; ib < S2NBAND; ib++) {
+		strcpy(sds_name, S2_SDS_NAME[ib]);
+		if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
+			sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
+			Error(message);
+			return(ERR_READ);
 		}
+		s2r->sds_id_ref[ib] = SDselect(s2r->sd_id, sds_index);
 
+		if (SDgetinfo(s2r->sds_id_ref[ib], sds_name, &rank, dimsizes, &data_type, &nattr) == FAIL) {
+			Error("Error in SDgetinfo");
+			return(ERR_READ);
+		} 
+	}
 
-		 /* Oct 18, 2016: Read a few map projection attributes, which are needed in processing
-		  * and creating an ENVI header.
-		 */
-		/* ULX */
-		strcpy(attr_name, ULX);
-		if ((attr_index = SDfindattr(s2r->sd_id, attr_name)) == FAIL) {
-			sprintf(message, "Attribute \"%s\" not found in %s", attr_name, s2r->fname);
+	/* AC CLOUD */
+	if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) {
+		strcpy(sds_name, AC_CLOUD_NAME);
+		if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
+			sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
 			Error(message);
-			return (-1);
+			return(ERR_READ);
 		}
-		if (SDreadattr(s2r->sd_id, attr_index, &s2r->ulx) == FAIL) {
-			sprintf(message, "Error read attribute \"%s\" in %s", attr_name, s2r->fname);
+		s2r->sds_id_accloud = SDselect(s2r->sd_id, sds_index);
+	}
+
+	/* ACmask and Fmask */ 
+	if (strcmp(s2r->mask_unavailable, MASK_UNAVAILABLE) == 0) { 
+		; /* do nothing */
+	}
+	else {
+		/* ACmask */
+		strcpy(sds_name, ACMASK_NAME);
+		if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
+			sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
 			Error(message);
-			return(-1);
+			return(ERR_READ);
 		}
+		s2r->sds_id_acmask = SDselect(s2r->sd_id, sds_index);
 
-		/* ULY */
-		strcpy(attr_name, ULY);
-		if ((attr_index = SDfindattr(s2r->sd_id, attr_name)) == FAIL) {
-			sprintf(message, "Attribute \"%s\" not found in %s", attr_name, s2r->fname);
+		/* Fmask */
+		strcpy(sds_name, FMASK_NAME);
+		if ((sds_index = SDnametoindex(s2r->sd_id, sds_name)) == FAIL) {
+			sprintf(message, "Didn't find the SDS %s in %s", sds_name, s2r->fname);
 			Error(message);
-			return (-1);
+			return(ERR_READ);
 		}
-		if (SDreadattr(s2r->sd_id, attr_index, &s2r->uly) == FAIL) {
-			sprintf(message, "Error read attribute \"%s\" in %s", attr_name, s2r->fname);
+		s2r->sds_id_fmask = SDselect(s2r->sd_id, sds_index);
+	}
+
+	return read_s2r_mapinfo(s2r);
+}
+
+/* Read ULX, ULY, and zonehem */
+static int read_s2r_mapinfo(s2r_t *s2r)
+{
+	int32 attr_index;
+	char attr_name[200];
+	int32 data_type;
+	int32 count;
+	char message[MSGLEN];
+
+	 /* Oct 18, 2016: Read a few map projection attributes, which are needed in processing
+	  * and creating an ENVI header.
+	 */
+	/* ULX */
+	strcpy(attr_name, ULX);
+	if ((attr_index = SDfindattr(s2r->sd_id, attr_name)) == FAIL) {
+		sprintf(message, "Attribute \"%s\" not found in %s", attr_name, s2r->fname);
+		Error(message);
+		return (-1);
+	}
+	if (SDreadattr(s2r->sd_id, attr_index, &s2r->ulx) == FAIL) {
+		sprintf(message, "Error read attribute \"%s\" in %s", attr_name, s2r->fname);
+		Error(message);
+		return(-1);
+	}
+
+	/* ULY */
+	strcpy(attr_name, ULY);
+	if ((attr_index = SDfindattr(s2r->sd_id, attr_name)) == FAIL) {
+		sprintf(message, "Attribute \"%s\" not found in %s", attr_name, s2r->fname);
+		Error(message);
+		return (-1);
+	}
+	if (SDreadattr(s2r->sd_id, attr_index, &s2r->uly) == FAIL) {
+		sprintf(message, "Error read attribute \"%s\" in %s", attr_name, s2r->fname);
+		Error(message);
+		return(-1);
+	}
+
+	/* Read zonehem from HORIZONTAL_CS_NAME */
+ 	/* from nchdfdump:   :HORIZONTAL_CS_NAME = "WGS84 / UTM zone 31N" ; */
+	/* HORIZONTAL_CS_NAME*/
+	char   tmpcsname[100], *tmppos;
+	strcpy(attr_name, HORIZONTAL_CS_NAME);
+	if ((attr_index = SDfindattr(s2r->sd_id, attr_name)) == FAIL) {
+		sprintf(message, "Attribute \"%s\" not found in %s", attr_name, s2r->fname);
+		Error(message);
+		return (-1);
+	}
+	if (SDattrinfo(s2r->sd_id, attr_index, attr_name, &data_type, &count) == FAIL) {
+		Error("Error in SDattrinfo");
+		return(-1);
+	}
+	if (count >= sizeof(tmpcsname)) {
+		Error("tmpcsname is not big enough");
+		return(-1);
+	}
+	if (SDreadattr(s2r->sd_id, attr_index, tmpcsname) == FAIL) {
+		sprintf(message, "Error read attribute \"%s\" in %s", attr_name, s2r->fname);
+		Error(message);
+		return(-1);
+	}
+	tmpcsname[count] = '\0';
+	tmppos = strrchr(tmpcsname, ' ');
+	strcpy(s2r->zonehem, tmppos+1);
+
+	return 0;
+}
+
+/* Set deflate compression for a new SDS. Oct 17, 2026: The SDS is always chunked, by
+ * S2R_CHUNK_NROW60 rows at 60m, not only for row-strip access, so that the dirty rows 
+ * can be written back alone (HDF4 cannot write part of a compressed SDS that is not 
+ * chunked) and the whole image is written a chunk at a time. 
+ */
+static void set_s2r_compress(s2r_t *s2r, int32 sds_id, int psi)
+{
+	SetSDSChunkDeflate(sds_id, s2r->nrow[psi], s2r->ncol[psi], S2R_CHUNK_NROW60 * nrow_per60m[psi]);
+}
+
+/* Create the file and all the SDS for DFACC_CREATE */
+static int create_s2r_sds(s2r_t *s2r)
+{
+	char *dimnames[][2] =  {{"YDim_Grid_10m", "XDim_Grid_10m"},
+				{"YDim_Grid_20m", "XDim_Grid_20m"},
+				{"YDim_Grid_60m", "XDim_Grid_60m"}};
+	char sds_name[500];     
+	int32 dimsizes[2];
+	int32 rank;
+	int ib;
+	int psi;	
+	char message[MSGLEN];
+
+	rank = 2;
+
+	/* A raw intermediate only has the attributes in the sidecar */
+	if (s2r->raw_map != NULL) {
+		if ((s2r->sd_id = start_hls_raw_sidecar(s2r->fname, DFACC_CREATE, s2r->nrow[0], s2r->ncol[0])) == FAIL)
+			return(ERR_CREATE);
+		return 0;
+	}
+
+	if ((s2r->sd_id = SDstart(s2r->fname, s2r->access_mode)) == FAIL) {
+		sprintf(message, "Cannot create %s", s2r->fname);
+		Error(message);
+		return(ERR_CREATE);
+	}
+
+	for (ib = 0; ib < S2NBAND; ib++) {
+		strcpy(sds_name, S2_SDS_NAME[ib]);
+		psi = get_pixsz_index(ib);
+		dimsizes[0] = s2r->nrow[psi];
+		dimsizes[1] = s2r->ncol[psi];
+
+		if ((s2r->sds_id_ref[ib] = SDcreate(s2r->sd_id, sds_name, DFNT_INT16, rank, dimsizes)) == FAIL) {
+			sprintf(message, "Cannot create SDS %s", sds_name);
 			Error(message);
-			return(-1);
-		}
+			return(ERR_CREATE);
+		}    
+		PutSDSDimInfo(s2r->sds_id_ref[ib], dimnames[psi][0], 0);
+		PutSDSDimInfo(s2r->sds_id_ref[ib], dimnames[psi][1], 1);
+		set_s2r_compress(s2r, s2r->sds_id_ref[ib], psi);
+		SDsetattr(s2r->sds_id_ref[ib], "long_name",  
+				DFNT_CHAR8, strlen(S2_SDS_LONG_NAME[ib]), (VOIDP)S2_SDS_LONG_NAME[ib]);
+		SDsetattr(s2r->sds_id_ref[ib], "_FillValue", DFNT_CHAR8, strlen(S2_ref_fillval), (VOIDP)S2_ref_fillval);
+		SDsetattr(s2r->sds_id_ref[ib], "scale_factor", DFNT_CHAR8, 
+						strlen(S2_ref_scale_factor), (VOIDP)S2_ref_scale_factor);
+		SDsetattr(s2r->sds_id_ref[ib], "add_offset", DFNT_CHAR8, 
+						strlen(S2_ref_add_offset), (VOIDP)S2_ref_add_offset);
+	}
+
+	/* CLOUD SDS from AC code */
+	if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) {
+		strcpy(sds_name, AC_CLOUD_NAME);
+		dimsizes[0] = s2r->nrow[0];
+		dimsizes[1] = s2r->ncol[0];
+		if ((s2r->sds_id_accloud = SDcreate(s2r->sd_id, sds_name, DFNT_UINT8, rank, dimsizes)) == FAIL) {
+			sprintf(message, "Cannot create SDS %s", sds_name);
+			Error(message);
+			return(ERR_CREATE);
+		}    
+		PutSDSDimInfo(s2r->sds_id_accloud, dimnames[0][0], 0);
+		PutSDSDimInfo(s2r->sds_id_accloud, dimnames[0][1], 1);
+		set_s2r_compress(s2r, s2r->sds_id_accloud, 0);
+		SDsetattr(s2r->sds_id_accloud, "_FillValue", DFNT_UINT8, 1, (VOIDP)&S2_mask_fillval);
+	}
 
-		/* Read zonehem from HORIZONTAL_CS_NAME */
-	 	/* from nchdfdump:   :HORIZONTAL_CS_NAME = "WGS84 / UTM zone 31N" ; */
-		/* HORIZONTAL_CS_NAME*/
-		char   tmpcsname[100], *tmppos;
-		strcpy(attr_name, HORIZONTAL_CS_NAME);
-		if ((attr_index = SDfindattr(s2r->sd_id, attr_name)) == FAIL) {
-			sprintf(message, "Attribute \"%s\" not found in %s", attr_name, s2r->fname);
+	/* Two masks */
+	if (strcmp(s2r->mask_unavailable, MASK_UNAVAILABLE) == 0) { 
+		; /* do nothing */
+	}
+	else {
+		char attr[3000];
+
+		/* AC mask */
+		strcpy(sds_name, ACMASK_NAME);
+		dimsizes[0] = s2r->nrow[0];
+		dimsizes[1] = s2r->ncol[0];
+		if ((s2r->sds_id_acmask = SDcreate(s2r->sd_id, sds_name, DFNT_UINT8, rank, dimsizes)) == FAIL) {
+			sprintf(message, "Cannot create SDS %s", sds_name);
 			Error(message);
-			return (-1);
-		}
-		if (SDattrinfo(s2r->sd_id, attr_index, attr_name, &data_type, &count) == FAIL) {
-			Error("Error in SDattrinfo");
-			return(-1);
+			return(ERR_CREATE);
+		}    
+		PutSDSDimInfo(s2r->sds_id_acmask, dimnames[0][0], 0);
+		PutSDSDimInfo(s2r->sds_id_acmask, dimnames[0][1], 1);
+		set_s2r_compress(s2r, s2r->sds_id_acmask, 0);
+		SDsetattr(s2r->sds_id_acmask, "_FillValue", DFNT_UINT8, 1, (VOIDP)&S2_mask_fillval);
+
+		/* Note: For better view, the blanks within the string is blank space characters, not tab */
+		sprintf(attr, 	"Bits are listed from the MSB (bit 7) to the LSB (bit 0): \n"
+				"7-6    aerosol:\n"
+				"       00 - climatology\n"
+				"       01 - low\n"
+				"       10 - average\n"
+				"       11 - high\n"
+				"5      water\n"
+				"4      snow/ice\n"
+				"3      cloud shadow\n"
+				"2      adjacent to cloud\n"
+				"1      cloud\n"
+				"0      cirrus cloud\n");
+		SDsetattr(s2r->sds_id_acmask, "ACmask bit description", DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+
+		
+		/* Fmask */
+		strcpy(sds_name, FMASK_NAME);
+		dimsizes[0] = s2r->nrow[0];
+		dimsizes[1] = s2r->ncol[0];
+		if ((s2r->sds_id_fmask = SDcreate(s2r->sd_id, sds_name, DFNT_UINT8, rank, dimsizes)) == FAIL) {
+			sprintf(message, "Cannot create SDS %s", sds_name);
+			Error(message);
+			return(ERR_CREATE);
+		}    
+		PutSDSDimInfo(s2r->sds_id_fmask, dimnames[0][0], 0);
+		PutSDSDimInfo(s2r->sds_id_fmask, dimnames[0][1], 1);
+		set_s2r_compress(s2r, s2r->sds_id_fmask, 0);
+		SDsetattr(s2r->sds_id_fmask, "_FillValue", DFNT_UINT8, 1, (VOIDP)&S2_mask_fillval);
+
+		/* Note: For better view, the blanks within the string is blank space characters, not tab */
+		sprintf(attr, 	"Bits are listed from the MSB (bit 7) to the LSB (bit 0): \n"
+				"7-6    aerosol:\n"
+				"       00 - climatology\n"
+				"       01 - low\n"
+				"       10 - average\n"
+				"       11 - high\n"
+				"5      water\n"
+				"4      snow/ice\n"
+				"3      cloud shadow\n"
+				"1      cloud\n"
+				"0      cirrus cloud\n");
+		SDsetattr(s2r->sds_id_fmask, "Fmask bit description", DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	}
+
+	return 0;
+}
+
+/* Find the SDS, the buffer, and the pixel size class of plane ib: the 13 bands,
+ * then CLOUD, ACmask, Fmask. Return 0 if the plane is not in s2r.
+ */
+static int s2r_plane(s2r_t *s2r, int ib, int *psi, int32 *sds_id, void **buf, char **sds_name)
+{
+	if (ib < S2NBAND) {
+		*psi = get_pixsz_index(ib);
+		*sds_id = s2r->sds_id_ref[ib];
+		*buf = s2r->ref[ib];
+		*sds_name = S2_SDS_NAME[ib];
+		return 1;
+	}
+
+	*psi = 0;
+	switch (ib - S2NBAND) {
+		case 0: 
+			/* Jun 26, 2019: This is used only when the two hdf from AC are to be combined */
+			if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) != 0)
+				return 0;
+			*sds_id = s2r->sds_id_accloud; 
+			*buf = s2r->accloud; 
+			*sds_name = AC_CLOUD_NAME; 
+			break;
+		case 1: 
+			*sds_id = s2r->sds_id_acmask; 
+			*buf = s2r->acmask; 
+			*sds_name = ACMASK_NAME; 
+			break;
+		case 2: 
+			*sds_id = s2r->sds_id_fmask; 
+			*buf = s2r->fmask; 
+			*sds_name = FMASK_NAME; 
+			break;
+	}
+
+	return (*buf != NULL);
+}
+
+/* Read or write the rows in memory: the whole image, or the current strip for 
+ * row-strip access.
+ */
+static int rw_s2r_rows(s2r_t *s2r, int write)
+{
+	int32 start[2], edge[2];
+	int ib, psi;
+	int32 sds_id;
+	void *buf;
+	char *sds_name;
+	intn ret;
+	char message[MSGLEN];
+
+	/* The rows of a raw intermediate are used in place in the map */
+	if (s2r->raw_map != NULL)
+		return 0;
+
+	/* 13 bands, CLOUD, ACmask, Fmask */
+	for (ib = 0; ib < S2NBAND+3; ib++) {
+		if (!s2r_plane(s2r, ib, &psi, &sds_id, &buf, &sds_name))
+			continue;
+
+		if (s2r->strip_nrow60 == 0) {
+			start[0] = 0; edge[0] = s2r->nrow[psi];
 		}
-		if (count >= sizeof(tmpcsname)) {
-			Error("tmpcsname is not big enough");
-			return(-1);
+		else {
+			start[0] = s2r->strip_row60 * nrow_per60m[psi];
+			edge[0]  = s2r->strip_len60 * nrow_per60m[psi];
 		}
-		if (SDreadattr(s2r->sd_id, attr_index, tmpcsname) == FAIL) {
-			sprintf(message, "Error read attribute \"%s\" in %s", attr_name, s2r->fname);
+		start[1] = 0; edge[1] = s2r->ncol[psi];
+
+		if (write && s2r->strip_nrow60 == 0)
+			ret = (WriteSDSByChunk(sds_id, edge[0], edge[1], (ib < S2NBAND) ? sizeof(int16) : sizeof(uint8), buf) == 0) ? SUCCEED : FAIL;
+		else if (write)
+			ret = SDwritedata(sds_id, start, NULL, edge, buf);
+		else
+			ret = SDreaddata(sds_id, start, NULL, edge, buf);
+		if (ret == FAIL) {
+			sprintf(message, "Error %s sds %s in %s", write ? "writing" : "reading", sds_name, s2r->fname);
 			Error(message);
-			return(-1);
+			return(write ? ERR_CREATE : ERR_READ);
 		}
-		tmpcsname[count] = '\0';
-		tmppos = strrchr(tmpcsname, ' ');
-		strcpy(s2r->zonehem, tmppos+1);
 	}
-	else if (s2r->access_mode == DFACC_CREATE) {
-		char *dimnames[][2] =  {{"YDim_Grid_10m", "XDim_Grid_10m"},
-					{"YDim_Grid_20m", "XDim_Grid_20m"},
-					{"YDim_Grid_60m", "XDim_Grid_60m"}};
-		int32 comp_type;   /*Compression flag*/
-		comp_info c_info;  /*Compression structure*/
-		comp_type = COMP_CODE_DEFLATE;
-		c_info.deflate.level = 2;     /*Level 9 would be too slow */
-		rank = 2;
 
-		int irow, icol;
+	return 0;
+}
 
-		if (s2r->nrow[0] == 0) {
-			sprintf(message, "Image dimension not set correctly: nrow = %d, %s\n", s2r->nrow[0], s2r->fname);	
-			Error(message);
-			exit(1);
+/* Oct 17, 2026: For a whole image opened with DFACC_WRITE, write back only the planes
+ * flagged in dirty_plane, in the 60m rows flagged in dirty_row60. Nothing is written if 
+ * no row has changed. A chunked SDS is written a run of dirty rows at a time, but a 
+ * compressed SDS that is not chunked cannot be partially written in HDF4, so it is 
+ * rewritten in full if it has changed.
+ */
+static int write_s2r_dirty_rows(s2r_t *s2r)
+{
+	int32 start[2], edge[2];
+	int ib, psi, irow60m, nrow60m, r0;
+	int32 sds_id;
+	void *buf;
+	char *sds_name;
+	HDF_CHUNK_DEF cdef;
+	int32 cflags;
+	size_t pixsz;
+	intn ret;
+	char message[MSGLEN];
+
+	nrow60m = s2r->nrow[2];
+	for (irow60m = 0; irow60m < nrow60m; irow60m++) {
+		if (s2r->dirty_row60[irow60m])
+			break;
+	}
+	if (irow60m == nrow60m)
+		return 0;
+
+	for (ib = 0; ib < S2NBAND+3; ib++) {
+		if (!s2r->dirty_plane[ib] || !s2r_plane(s2r, ib, &psi, &sds_id, &buf, &sds_name))
+			continue;
+
+		pixsz = (ib < S2NBAND) ? sizeof(int16) : sizeof(uint8);
+		start[1] = 0; edge[1] = s2r->ncol[psi];
+		if (SDgetchunkinfo(sds_id, &cdef, &cflags) != FAIL && cflags != HDF_NONE) {
+			ret = SUCCEED;
+			for (irow60m = 0; irow60m < nrow60m && ret != FAIL; ) {
+				if (!s2r->dirty_row60[irow60m]) {
+					irow60m++;
+					continue;
+				}
+				for (r0 = irow60m; irow60m < nrow60m && s2r->dirty_row60[irow60m]; irow60m++)
+					;
+				start[0] = r0 * nrow_per60m[psi];
+				edge[0]  = (irow60m - r0) * nrow_per60m[psi];
+				ret = SDwritedata(sds_id, start, NULL, edge, 
+						(char*)buf + (size_t)start[0] * edge[1] * pixsz);
+			}
 		}
-		else if (s2r->nrow[0]/3 != HLS_TILEDIM_30M) { 
-			sprintf(message, "Image dimension not set correctly: nrow = %d, %s\n", s2r->nrow[0], s2r->fname);	
-			Error(message);
-			exit(1);
+		else {
+			start[0] = 0; edge[0] = s2r->nrow[psi];
+			ret = SDwritedata(sds_id, start, NULL, edge, buf);
 		}
-		/* Memory has been allocated earlier */
-
-		if ((s2r->sd_id = SDstart(s2r->fname, s2r->access_mode)) == FAIL) {
-			sprintf(message, "Cannot create %s", s2r->fname);
+		if (ret == FAIL) {
+			sprintf(message, "Error writing sds %s in %s", sds_name, s2r->fname);
 			Error(message);
 			return(ERR_CREATE);
 		}
+	}
 
-		for (ib = 0; ib < S2NBAND; ib++) {
-			strcpy(sds_name, S2_SDS_NAME[ib]);
-			psi = get_pixsz_index(ib);
-			dimsizes[0] = s2r->nrow[psi];
-			dimsizes[1] = s2r->ncol[psi];
-
-			if ((s2r->sds_id_ref[ib] = SDcreate(s2r->sd_id, sds_name, DFNT_INT16, rank, dimsizes)) == FAIL) {
-				sprintf(message, "Cannot create SDS %s", sds_name);
-				Error(message);
-				return(ERR_CREATE);
-			}    
-			PutSDSDimInfo(s2r->sds_id_ref[ib], dimnames[psi][0], 0);
-			PutSDSDimInfo(s2r->sds_id_ref[ib], dimnames[psi][1], 1);
-			SDsetcompress(s2r->sds_id_ref[ib], comp_type, &c_info);	
-			SDsetattr(s2r->sds_id_ref[ib], "long_name",  
-					DFNT_CHAR8, strlen(S2_SDS_LONG_NAME[ib]), (VOIDP)S2_SDS_LONG_NAME[ib]);
-			SDsetattr(s2r->sds_id_ref[ib], "_FillValue", DFNT_CHAR8, strlen(S2_ref_fillval), (VOIDP)S2_ref_fillval);
-			SDsetattr(s2r->sds_id_ref[ib], "scale_factor", DFNT_CHAR8, 
-							strlen(S2_ref_scale_factor), (VOIDP)S2_ref_scale_factor);
-			SDsetattr(s2r->sds_id_ref[ib], "add_offset", DFNT_CHAR8, 
-							strlen(S2_ref_add_offset), (VOIDP)S2_ref_add_offset);
-
-			for (irow = 0; irow < dimsizes[0]; irow++) {
-				for (icol = 0; icol < dimsizes[1]; icol++) 
-					s2r->ref[ib][irow*dimsizes[1]+icol] = ref_fillval;
-			}
-		}
+	return 0;
+}
 
-		/* CLOUD SDS from AC code */
-		if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) {
-			strcpy(sds_name, AC_CLOUD_NAME);
-			dimsizes[0] = s2r->nrow[0];
-			dimsizes[1] = s2r->ncol[0];
-			if ((s2r->sds_id_accloud = SDcreate(s2r->sd_id, sds_name, DFNT_UINT8, rank, dimsizes)) == FAIL) {
-				sprintf(message, "Cannot create SDS %s", sds_name);
-				Error(message);
-				return(ERR_CREATE);
-			}    
-			PutSDSDimInfo(s2r->sds_id_accloud, dimnames[0][0], 0);
-			PutSDSDimInfo(s2r->sds_id_accloud, dimnames[0][1], 1);
-			SDsetcompress(s2r->sds_id_accloud, comp_type, &c_info);	
-			SDsetattr(s2r->sds_id_accloud, "_FillValue", DFNT_UINT8, 1, (VOIDP)&S2_mask_fillval);
-
-			for (irow = 0; irow < dimsizes[0]; irow++) {
-				for (icol = 0; icol < dimsizes[1]; icol++) 
-					s2r->accloud[irow*dimsizes[1]+icol] = S2_mask_fillval; 
-			}
-		}
 
-		/* Two masks */
-		if (strcmp(s2r->mask_unavailable, MASK_UNAVAILABLE) == 0) { 
-			; /* do nothing */
-		}
-		else {
-			char attr[3000];
-
-			/* AC mask */
-			strcpy(sds_name, ACMASK_NAME);
-			dimsizes[0] = s2r->nrow[0];
-			dimsizes[1] = s2r->ncol[0];
-			if ((s2r->sds_id_acmask = SDcreate(s2r->sd_id, sds_name, DFNT_UINT8, rank, dimsizes)) == FAIL) {
-				sprintf(message, "Cannot create SDS %s", sds_name);
-				Error(message);
-				return(ERR_CREATE);
-			}    
-			PutSDSDimInfo(s2r->sds_id_acmask, dimnames[0][0], 0);
-			PutSDSDimInfo(s2r->sds_id_acmask, dimnames[0][1], 1);
-			SDsetcompress(s2r->sds_id_acmask, comp_type, &c_info);	
-			SDsetattr(s2r->sds_id_acmask, "_FillValue", DFNT_UINT8, 1, (VOIDP)&S2_mask_fillval);
-
-			/* Note: For better view, the blanks within the string is blank space characters, not tab */
-			sprintf(attr, 	"Bits are listed from the MSB (bit 7) to the LSB (bit 0): \n"
-					"7-6    aerosol:\n"
-					"       00 - climatology\n"
-					"       01 - low\n"
-					"       10 - average\n"
-					"       11 - high\n"
-					"5      water\n"
-					"4      snow/ice\n"
-					"3      cloud shadow\n"
-					"2      adjacent to cloud\n"
-					"1      cloud\n"
-					"0      cirrus cloud\n");
-			SDsetattr(s2r->sds_id_acmask, "ACmask bit description", DFNT_CHAR8, strlen(attr), (VOIDP)attr);
-
-			for (irow = 0; irow < dimsizes[0]; irow++) {
-				for (icol = 0; icol < dimsizes[1]; icol++) 
-					s2r->acmask[irow*dimsizes[1]+icol] = S2_mask_fillval; 
-			}
 
-			
-			/* Fmask */
-			strcpy(sds_name, FMASK_NAME);
-			dimsizes[0] = s2r->nrow[0];
-			dimsizes[1] = s2r->ncol[0];
-			if ((s2r->sds_id_fmask = SDcreate(s2r->sd_id, sds_name, DFNT_UINT8, rank, dimsizes)) == FAIL) {
-				sprintf(message, "Cannot create SDS %s", sds_name);
-				Error(message);
-				return(ERR_CREATE);
-			}    
-			PutSDSDimInfo(s2r->sds_id_fmask, dimnames[0][0], 0);
-			PutSDSDimInfo(s2r->sds_id_fmask, dimnames[0][1], 1);
-			SDsetcompress(s2r->sds_id_fmask, comp_type, &c_info);	
-			SDsetattr(s2r->sds_id_fmask, "_FillValue", DFNT_UINT8, 1, (VOIDP)&S2_mask_fillval);
-
-			/* Note: For better view, the blanks within the string is blank space characters, not tab */
-			sprintf(attr, 	"Bits are listed from the MSB (bit 7) to the LSB (bit 0): \n"
-					"7-6    aerosol:\n"
-					"       00 - climatology\n"
-					"       01 - low\n"
-					"       10 - average\n"
-					"       11 - high\n"
-					"5      water\n"
-					"4      snow/ice\n"
-					"3      cloud shadow\n"
-					"1      cloud\n"
-					"0      cirrus cloud\n");
-			SDsetattr(s2r->sds_id_fmask, "Fmask bit description", DFNT_CHAR8, strlen(attr), (VOIDP)attr);
-
-			for (irow = 0; irow < dimsizes[0]; irow++) {
-				for (icol = 0; icol < dimsizes[1]; icol++) 
-					s2r->fmask[irow*dimsizes[1]+icol] = S2_mask_fillval; 
-			}
+/* Bytes of plane ib (13 bands, CLOUD, ACmask, Fmask) in a raw intermediate; 0 if 
+ * the plane is not in s2r.
+ */
+static size_t s2r_plane_size(s2r_t *s2r, int ib)
+{
+	int psi;
 
-		}
+	if (ib < S2NBAND) {
+		psi = get_pixsz_index(ib);
+		return (size_t)s2r->nrow[psi] * s2r->ncol[psi] * sizeof(int16);
 	}
+	if (ib == S2R_CLOUD_PLANE && strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) != 0)
+		return 0;
+	if (ib != S2R_CLOUD_PLANE && strcmp(s2r->mask_unavailable, MASK_UNAVAILABLE) == 0)
+		return 0;
+	return (size_t)s2r->nrow[0] * s2r->ncol[0] * sizeof(uint8);
+}
+
+/* Oct 17, 2026: Map a raw intermediate, and point the image buffers to the planes */
+static int map_s2r_raw(s2r_t *s2r)
+{
+	size_t planesize[S2NBAND+3];
+	int ib, ret;
+
+	for (ib = 0; ib < S2NBAND+3; ib++)
+		planesize[ib] = s2r_plane_size(s2r, ib);
+	s2r->raw_size = hls_raw_layout(S2NBAND+3, planesize, s2r->raw_offset);
+
+	if ((ret = map_hls_raw(s2r->fname, s2r->access_mode, s2r->raw_size, (void**)&s2r->raw_map)) != 0)
+		return(ret);
+	point_s2r_raw(s2r);
 
 	return 0;
-} 
+}
 
+/* Point the image buffers to the current strip in the map, or the whole image */
+static void point_s2r_raw(s2r_t *s2r)
+{
+	int ib, psi;
+	size_t pixsz;
+	char *p;
+
+	for (ib = 0; ib < S2NBAND+3; ib++) {
+		if (s2r_plane_size(s2r, ib) == 0)
+			continue;
+		psi = (ib < S2NBAND) ? get_pixsz_index(ib) : 0;
+		pixsz = (ib < S2NBAND) ? sizeof(int16) : sizeof(uint8);
+		p = s2r->raw_map + s2r->raw_offset[ib] + 
+			(size_t)s2r->strip_row60 * nrow_per60m[psi] * s2r->ncol[psi] * pixsz;
+
+		if (ib < S2NBAND)
+			s2r->ref[ib] = (int16*)p;
+		else if (ib == S2R_CLOUD_PLANE)
+			s2r->accloud = (uint8*)p;
+		else if (ib == S2R_ACMASK_PLANE)
+			s2r->acmask = (uint8*)p;
+		else
+			s2r->fmask = (uint8*)p;
+	}
+}
 
 
 /* S2 data are at three different pixel sizes, 10m, 20m, and 60m.
@@ -515,57 +957,42 @@ void dup_s2(s2r_t *in, s2r_t *out)
 int close_s2r(s2r_t *s2r)
 {
 	int ib;
-	int psi;
 	int ret;
 	char message[MSGLEN];
-	int32 start[2], edge[2];
 	
+	/* Oct 17, 2026: The changes to a raw intermediate opened with DFACC_WRITE or
+	 * DFACC_CREATE are already in the file through the shared map.
+	 */
+	if (s2r->raw_map != NULL) {
+		if (s2r->sd_id != FAIL)
+			SDend(s2r->sd_id);
+		s2r->sd_id = FAIL;
+		unmap_hls_raw(s2r->raw_map, s2r->raw_size);
+		s2r->raw_map = NULL;
+		for (ib = 0; ib < S2NBAND; ib++) 
+			s2r->ref[ib] = NULL;
+		s2r->accloud = s2r->acmask = s2r->fmask = NULL;
+	}
+
 	if ((s2r->access_mode == DFACC_WRITE || s2r->access_mode == DFACC_CREATE) && s2r->sd_id != FAIL) {
-		for (ib = 0; ib < S2NBAND; ib++) {
-			psi = get_pixsz_index(ib);
-			start[0] = 0; edge[0] = s2r->nrow[psi];
-			start[1] = 0; edge[1] = s2r->ncol[psi];
-			if (SDwritedata(s2r->sds_id_ref[ib], start, NULL, edge, s2r->ref[ib]) == FAIL) {
-				sprintf(message, "Error in SDwritedata, ib = %d", ib);
-				Error(message);
-				//return(ERR_CREATE);
-			}
-			SDendaccess(s2r->sds_id_ref[ib]);
+		/* For row-strip access, the strips have been written by write_s2r_strip() */
+		if (s2r->strip_nrow60 == 0) {
+			if (s2r->access_mode == DFACC_WRITE && s2r->dirty_row60 != NULL)
+				ret = write_s2r_dirty_rows(s2r);
+			else
+				ret = rw_s2r_rows(s2r, 1);
+			if (ret != 0)
+				return(ret);
 		}
 
-		/* AC CLOUD */
-		/* Jun 26, 2019: This is used only when the two hdf from AC are to be combined */
-		if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) {
-			start[0] = 0; edge[0] = s2r->nrow[0];
-			start[1] = 0; edge[1] = s2r->ncol[0];
-			if (SDwritedata(s2r->sds_id_accloud, start, NULL, edge, s2r->accloud) == FAIL) {
-				Error("Error in SDwritedata");
-				return(ERR_CREATE);
-			}
+		for (ib = 0; ib < S2NBAND; ib++) 
+			SDendaccess(s2r->sds_id_ref[ib]);
+		if (strcmp(s2r->ac_cloud_available, AC_CLOUD_AVAILABLE) == 0) 
 			SDendaccess(s2r->sds_id_accloud);
-		}
-
-		/* ACmask */	
-		if (s2r->acmask != NULL) { 
-			start[0] = 0; edge[0] = s2r->nrow[0];    /*  10m */
-			start[1] = 0; edge[1] = s2r->ncol[0];
-			if (SDwritedata(s2r->sds_id_acmask, start, NULL, edge, s2r->acmask) == FAIL) {
-				Error("Error in SDwritedata");
-				return(ERR_CREATE);
-			}
+		if (s2r->acmask != NULL) 
 			SDendaccess(s2r->sds_id_acmask);
-		}
-
-		/* Fmask */	
-		if (s2r->fmask != NULL) { 
-			start[0] = 0; edge[0] = s2r->nrow[0];    /*  10m */
-			start[1] = 0; edge[1] = s2r->ncol[0];
-			if (SDwritedata(s2r->sds_id_fmask, start, NULL, edge, s2r->fmask) == FAIL) {
-				Error("Error in SDwritedata");
-				return(ERR_CREATE);
-			}
+		if (s2r->fmask != NULL) 
 			SDendaccess(s2r->sds_id_fmask);
-		}
 
 		SDend(s2r->sd_id);
 		s2r->sd_id = FAIL;
@@ -611,6 +1038,10 @@ int close_s2r(s2r_t *s2r)
 		free(s2r->fmask);
 		s2r->fmask = NULL;
 	}
+	if (s2r->dirty_row60 != NULL) {
+		free(s2r->dirty_row60);
+		s2r->dirty_row60 = NULL;
+	}
 
 	return 0;
 }
@@ -620,16 +1051,20 @@ int close_s2r(s2r_t *s2r)
 void setcoverage(s2r_t *s2r)
 {
 	int irow, icol;
-	int npix, ncloud, k; 
+	int nrow;
+	long npix, ncloud, k; 
 
 	/* Coverage is based on broad NIR band. For S10 output, cloud cover SDS was
 	 * available at 10m. So chose a 10m NIR*/
 	
+	/* For row-strip access, only the rows of the strip are in memory */
+	nrow = (s2r->strip_nrow60 == 0) ? s2r->nrow[0] : s2r->strip_len60 * nrow_per60m[0];
+
 	npix = 0;
 	ncloud = 0;
-	for (irow = 0; irow < s2r->nrow[0]; irow++) {		/* 0, 1, 2 for 10m, 20m, 60m respectively */
+	for (irow = 0; irow < nrow; irow++) {		/* 0, 1, 2 for 10m, 20m, 60m respectively */
 		for (icol = 0; icol < s2r->ncol[0]; icol++) {
-			k = irow*s2r->ncol[0]+icol;
+			k = (long)irow*s2r->ncol[0]+icol;
 			if (s2r->ref[7][k] != HLS_S2_FILLVAL) {	/* 7 is for 10m NIR */
 				npix++;
 				/* cirrus, cloud, and cloud shadow, aggressively based on ACmask and Fmask. */
@@ -645,9 +1080,22 @@ void setcoverage(s2r_t *s2r)
 		}
 	}
 
-	s2r->spcover = (int) (npix * 100.0 / (s2r->nrow[0] * s2r->ncol[0]));
+	if (s2r->strip_nrow60 != 0) {
+		if (s2r->strip_row60 == 0)
+			s2r->cov_npix = s2r->cov_ncloud = 0;
+		s2r->cov_npix += npix;
+		s2r->cov_ncloud += ncloud;
+		if (s2r->strip_row60 + s2r->strip_len60 < s2r->nrow[2])
+			return;		/* Not the last strip yet */
+		npix = s2r->cov_npix;
+		ncloud = s2r->cov_ncloud;
+	}
+
+	s2r->spcover = (int) (npix * 100.0 / ((double)s2r->nrow[0] * s2r->ncol[0]));
 	s2r->clcover = (int) (ncloud * 100.0 / npix + 0.5);
 
+	if (s2r->sd_id == FAIL)		/* HLS_ACC_MEMORY */
+		return;
 	SDsetattr(s2r->sd_id, SPCOVER, DFNT_INT16, 1, (VOIDP)&(s2r->spcover));
 	SDsetattr(s2r->sd_id, CLCOVER, DFNT_INT16, 1, (VOIDP)&(s2r->clcover));
 }
@@ -862,6 +1310,12 @@ int setinputmeta(s2r_t *s2r, char *safexml, char *granulexml, char *accode)
 	if (strlen(s2r->baseline) == 0)
 		strcpy(s2r->baseline, "NONE");
 
+	/* Keep the AC code name for the S30 metadata. Oct 17, 2026 */
+	strcpy(s2r->accode, accode);
+
+	/* An image held in memory only (HLS_ACC_MEMORY) keeps the metadata in s2r */
+	if (s2r->sd_id == FAIL)
+		return(0);
 	
 	SDsetattr(s2r->sd_id, PRODUCT_URI, DFNT_CHAR8, strlen(s2r->uri), (VOIDP)s2r->uri);
 	SDsetattr(s2r->sd_id, L1C_QUALITY, DFNT_CHAR8, strlen(s2r->quality), (VOIDP)s2r->quality);
@@ -9,6 +9,7 @@
 #include "mfhdf.h"
 #include "hls_commondef.h"
 #include "hdfutility.h"
+#include "hls_raw.h"
 #include "s2def.h"
 #include "fillval.h"
 #include "util.h"
@@ -71,6 +72,9 @@ static char *VermoteS2sdsname[] = {
 #define ACMASK_NAME "ACmask"
 #define FMASK_NAME "Fmask"
 
+/* Chunk height, in number of 60m rows, of an S10 SDS */
+#define S2R_CHUNK_NROW60 10
+
 #define S_AROP_REFIMG "arop_s2_refimg"
 #define S_AROP_NCP "arop_ncp"
 #define S_AROP_RMSE "arop_rmse(meters)"
@@ -139,8 +143,41 @@ typedef struct {
 
 	char tile_has_data;	/* Indicate whether a created tile has data */
 
+	/* Row-strip access, Oct 17, 2026. The image buffers hold strip_nrow60 rows at 60m 
+	 * (6 and 3 times as many rows at 10m and 20m), of which strip_len60 rows starting
+	 * at the 60m row strip_row60 are in use. strip_nrow60 is 0 if the whole image is
+	 * in memory, as opened by open_s2r().
+	 */
+	int strip_nrow60;
+	int strip_row60;
+	int strip_len60;
+	long cov_npix;		/* Counts for setcoverage() accumulated over the strips */
+	long cov_ncloud;
+
+	/* Oct 17, 2026: The 60m rows changed since open, and the planes changed (13 bands,
+	 * CLOUD, ACmask, Fmask, in the order of S2R_*_PLANE), set by trim_s2edge(). If 
+	 * dirty_row60 is not NULL, close_s2r() writes back only these planes and rows for 
+	 * DFACC_WRITE and leaves the other SDS untouched.
+	 */
+	uint8 *dirty_row60;
+	uint8 dirty_plane[S2NBAND+3];
+
+	/* Oct 17, 2026: A raw intermediate (fname ends in HLS_RAW_EXT, see hls_raw.h) is 
+	 * mapped at raw_map, with the planes in the order of S2R_*_PLANE at raw_offset. 
+	 * The image buffers point into the map instead of being allocated, and sd_id is 
+	 * that of the sidecar, which has the attributes but no SDS.
+	 */
+	char *raw_map;
+	size_t raw_size;
+	size_t raw_offset[S2NBAND+3];
+
 } s2r_t;			/* S2 reflectance */
 
+/* Plane index of the masks after the 13 bands, e.g. in dirty_plane */
+#define S2R_CLOUD_PLANE  S2NBAND
+#define S2R_ACMASK_PLANE (S2NBAND+1)
+#define S2R_FMASK_PLANE  (S2NBAND+2)
+
 
 /* Spectral values of a S2 pixel. Might use in cubic convolution. Not needed now. */
 typedef struct {
@@ -150,9 +187,36 @@ typedef struct {
 /* open s2 reflectance for read or create*/
 int open_s2r(s2r_t *s2r, intn access_mode);
 
-/* close */
+/* close. For row-strip access, the strips must have been written by write_s2r_strip() */
 int close_s2r(s2r_t *s2r);
 
+/* Row-strip access. Oct 17, 2026.
+ * 
+ * open_s2r() holds the whole image in memory, about 1.9 GB for an S10 with the masks. 
+ * open_s2r_strip() instead allocates memory for a strip of 60m rows (6 rows at 10m, 
+ * 3 rows at 20m, 1 row at 60m for each 60m row), as many rows as fit in maxmem bytes, 
+ * and the image is processed a strip at a time:
+ *
+ *	for (row60 = 0; row60 < s2r.nrow[2]; row60 += s2r.strip_nrow60) {
+ *		read_s2r_strip(&s2r, row60);
+ *		... row irow of a band at 10m is s2r.ref[ib][irow*s2r.ncol[0]], with
+ *		    irow from 0 to s2r.strip_len60*6-1 ...
+ *		write_s2r_strip(&s2r);		(DFACC_WRITE or DFACC_CREATE)
+ *	}
+ *	close_s2r(&s2r);
+ *
+ * For DFACC_CREATE, read_s2r_strip() sets the strip to fill, and the SDS are chunked
+ * so that they can be written a strip at a time. HDF4 cannot write part of a compressed 
+ * SDS that is not chunked, so DFACC_WRITE only works on a file created this way.
+ * The image dimension must be a multiple of 60m pixels.
+ *
+ * For a raw intermediate, the buffers point to the strip in the map, so nothing is
+ * copied and maxmem only sets the strip height.
+ */
+int open_s2r_strip(s2r_t *s2r, intn access_mode, size_t maxmem);
+int read_s2r_strip(s2r_t *s2r, int row60);
+int write_s2r_strip(s2r_t *s2r);
+
 /* Duplicate in to out */
 void dup_s2(s2r_t *in, s2r_t *out);
 
@@ -180,6 +244,9 @@ int get_all_metadata(s2r_t *s2r);
 //int copy_metadata(s2r_t *s2r, s2r_t *s2rout);
 
 /* Spaital and cloud coverage of a tile in percentage. SDS qa should be set before doing this */
+/* Oct 17, 2026: For row-strip access, call it for every strip in order; the pixels are 
+ * counted over the strips and the coverage is set after the last strip.
+ */
 void setcoverage(s2r_t *s2r);
 
 #endif
@@ -0,0 +1,193 @@
+#include "s2trimedge.h"
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of pixels in one direction within a 60m pixel, for 10m, 20m, 60m */
+static int nbox[3] = {6, 3, 1};
+
+/* Bands at each resolution */
+static int bands10m[] = {1, 2, 3, 7};
+static int bands20m[] = {4, 5, 6, 8, 11, 12};
+static int bands60m[] = {0, 9, 10};
+
+/* Clear colok[c] where the 10m, 20m, or 60m pixels in column c of the nrow rows
+ * starting at ref have fill.
+ */
+static void and_colok(int16 *ref, int nrow, int ncol, uint8 *colok)
+{
+	int irow, c;
+	int16 *p;
+
+	for (irow = 0; irow < nrow; irow++) {
+		p = ref + (long)irow * ncol;
+		c = 0;
+#ifdef __SSE2__
+		__m128i fill, lo, hi;
+		fill = _mm_set1_epi16(HLS_REFL_FILLVAL);
+		for ( ; c + 16 <= ncol; c += 16) {
+			lo = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)(p + c)), fill);
+			hi = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)(p + c + 8)), fill);
+			_mm_storeu_si128((__m128i*)(colok + c),
+				_mm_andnot_si128(_mm_packs_epi16(lo, hi), _mm_loadu_si128((__m128i*)(colok + c))));
+		}
+#endif
+		for ( ; c < ncol; c++) {
+			if (p[c] == HLS_REFL_FILLVAL)
+				colok[c] = 0;
+		}
+	}
+}
+
+/* Clear the bit of a 60m pixel in the validity bitmap of 60m row irow60m if any of
+ * the nb bands at pixel size class psi has fill in any of the pixels nesting in it.
+ */
+static void and_valid_bits(s2r_t *s2r, int *bands, int nb, int psi, int irow60m, uint8 *colok, uint64_t *bits)
+{
+	int i, j, bs, ncol, ncol60m, icol60m;
+	uint8 ok;
+
+	bs = nbox[psi];
+	ncol = s2r->ncol[psi];
+	ncol60m = s2r->ncol[2];
+
+	memset(colok, 0xFF, ncol);
+	for (i = 0; i < nb; i++)
+		and_colok(s2r->ref[bands[i]] + (long)irow60m * bs * ncol, bs, ncol, colok);
+
+	for (icol60m = 0; icol60m < ncol60m; icol60m++) {
+		ok = 0xFF;
+		for (j = 0; j < bs; j++)
+			ok &= colok[icol60m * bs + j];
+		if (!ok)
+			bits[icol60m >> 6] &= ~((uint64_t)1 << (icol60m & 63));
+	}
+}
+
+/* Set the nested pixels of the 60m pixels icol60m to icol60m+n-1 in 60m row irow60m to
+ * fill in all bands and the two masks. Flag in plane_changed the planes in which any
+ * of them was not fill, and return 1 if there is any.
+ */
+static int fill_60m_run(s2r_t *s2r, int irow60m, int icol60m, int n, uint8 *plane_changed)
+{
+	int ib, psi, bs, irow, icol, ncol;
+	long k;
+	int changed, anychanged = 0;
+	int achanged, fchanged;
+
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		bs = nbox[psi];
+		ncol = s2r->ncol[psi];
+		changed = 0;
+		for (irow = irow60m * bs; irow < (irow60m + 1) * bs; irow++) {
+			for (icol = icol60m * bs; icol < (icol60m + n) * bs; icol++) {
+				k = (long)irow * ncol + icol;
+				changed |= (s2r->ref[ib][k] != HLS_REFL_FILLVAL);
+				s2r->ref[ib][k] = HLS_REFL_FILLVAL;
+			}
+		}
+		plane_changed[ib] |= changed;
+		anychanged |= changed;
+	}
+
+	/* ACmask and Fmask at 10m*/
+	bs = nbox[0];
+	ncol = s2r->ncol[0];
+	achanged = fchanged = 0;
+	for (irow = irow60m * bs; irow < (irow60m + 1) * bs; irow++) {
+		for (icol = icol60m * bs; icol < (icol60m + n) * bs; icol++) {
+			k = (long)irow * ncol + icol;
+			achanged |= (s2r->acmask[k] != HLS_MASK_FILLVAL);
+			fchanged |= (s2r->fmask[k] != HLS_MASK_FILLVAL);
+			s2r->acmask[k] = HLS_MASK_FILLVAL;
+			s2r->fmask[k]  = HLS_MASK_FILLVAL;
+		}
+	}
+	plane_changed[S2R_ACMASK_PLANE] |= achanged;
+	plane_changed[S2R_FMASK_PLANE] |= fchanged;
+
+	return (anychanged | achanged | fchanged);
+}
+
+/* Oct 17, 2026: Each 60m pixel was checked band by band over its nesting 10m and 20m
+ * pixels, and the same windows were walked again to fill. Now for each 60m row, each
+ * band is reduced to the validity of the 60m pixels by columns (16 columns at a time
+ * with SSE2), the results are ANDed in a bitmap of 60m pixels, and only the runs of
+ * 60m pixels cleared in the bitmap are filled. The 60m rows are done in parallel.
+ * The 60m rows and the planes in which any pixel is changed are recorded in 
+ * s2r->dirty_row60 and s2r->dirty_plane, so that close_s2r() can skip the rest.
+ */
+void trim_s2edge(s2r_t *s2r)
+{
+	int irow60m, nrow60m, ncol60m;
+	int nword;
+	char message[MSGLEN];
+
+	/* Use the 60m aerosol band to guide the trimming. For a 60m by 60m area if
+	 * there is no measurement in any spectral band, the entire 60m by 60m
+	 * area will filled with nodata.
+	 */
+	nrow60m = s2r->nrow[2];
+	ncol60m = s2r->ncol[2];
+	nword = (ncol60m + 63) / 64;
+
+	if (s2r->dirty_row60 == NULL &&
+	    (s2r->dirty_row60 = (uint8*)calloc(nrow60m, sizeof(uint8))) == NULL) {
+		sprintf(message, "Cannot allocate memory for %s", s2r->fname);
+		Error(message);
+		exit(ERR_MEM);
+	}
+
+	#pragma omp parallel
+	{
+		uint8 *colok;		/* Whether a column of pixels in a 60m row is valid */
+		uint64_t *bits;		/* Validity of the 60m pixels in a 60m row */
+		uint64_t inv;
+		int w, icol60m, n, ip;
+		uint8 plane_changed[S2NBAND+3];
+
+		if ((colok = (uint8*)malloc(s2r->ncol[0] * sizeof(uint8))) == NULL ||
+		    (bits = (uint64_t*)malloc(nword * sizeof(uint64_t))) == NULL) {
+			Error("Cannot allocate memory");
+			exit(ERR_MEM);
+		}
+		memset(plane_changed, 0, sizeof(plane_changed));
+
+		#pragma omp for schedule(dynamic, 16)
+		for (irow60m = 0; irow60m < nrow60m; irow60m++) {
+			/*** First pass to detect missing data ***/
+			for (w = 0; w < nword; w++)
+				bits[w] = ~(uint64_t)0;
+			and_valid_bits(s2r, bands60m, 3, 2, irow60m, colok, bits);
+			and_valid_bits(s2r, bands20m, 6, 1, irow60m, colok, bits);
+			and_valid_bits(s2r, bands10m, 4, 0, irow60m, colok, bits);
+
+			/*** Second pass to set to missing, a run of 60m pixels at a time ***/
+			for (w = 0; w < nword; w++) {
+				inv = ~bits[w];
+				if (w == nword - 1 && ncol60m % 64 != 0)
+					inv &= ((uint64_t)1 << (ncol60m % 64)) - 1;
+				while (inv) {
+					icol60m = __builtin_ctzll(inv);
+					for (n = 1; icol60m + n < 64 && (inv >> (icol60m + n)) & 1; n++)
+						;
+					if (icol60m + n == 64)
+						inv = 0;
+					else
+						inv &= ~((((uint64_t)1 << n) - 1) << icol60m);
+					if (fill_60m_run(s2r, irow60m, w * 64 + icol60m, n, plane_changed))
+						s2r->dirty_row60[irow60m] = 1;
+				}
+			}
+		}
+
+		#pragma omp critical
+		for (ip = 0; ip < S2NBAND+3; ip++)
+			s2r->dirty_plane[ip] |= plane_changed[ip];
+
+		free(colok);
+		free(bits);
+	}
+}
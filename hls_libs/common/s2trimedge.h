@@ -0,0 +1,18 @@
+/* Trim the image edge so that in the output a location either has data in all 
+ * spectral bands or has no data in any spectral band. 
+ *
+ * Moved from s2trim.c so that hls_s2_pipeline can trim in memory. Oct 17, 2026
+ */
+#ifndef S2TRIMEDGE_H
+#define S2TRIMEDGE_H
+
+#include "s2r.h"
+
+/* For a 60m by 60m area if there is no measurement in any spectral band, the
+ * entire 60m by 60m area in all bands and the two masks is filled with nodata.
+ * The 60m rows and the planes changed are flagged in s2r->dirty_row60 and
+ * s2r->dirty_plane.
+ */
+void trim_s2edge(s2r_t *s2r);
+
+#endif
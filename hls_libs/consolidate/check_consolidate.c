@@ -0,0 +1,218 @@
+/* Regression check for the strip-wise N-way consolidation: consolidate synthetic
+ * partial granules held in memory a strip at a time with consolidate_strip(), and
+ * compare with the original per-pixel rule, applied to one input after another: copy a
+ * 60m pixel (and the nesting 10m and 20m pixels and the masks) from an input with a
+ * valid B01 if the output has none there yet, or if the input has a higher NDVI than
+ * the output. The output must be identical, for 2 and more input, also where two input
+ * have the same NDVI. Exit status is 1 on any difference.
+ *
+ * consolidate.c is included, with its main() renamed, for the strip functions.
+ *
+ * Oct 17, 2026
+ */
+#define main consolidate_main
+#include "consolidate.c"
+#undef main
+
+#define NCOL60M 100
+#define STRIP_NROW60 32		/* The last strip is partial */
+#define NIN_MAX 5
+
+/* An image held in full, with NROW60 rows at 60m */
+static void alloc_image(s2r_t *s2, int fill, int seed)
+{
+	int ib, psi, irow, icol;
+	long k, npix;
+
+	memset(s2, 0, sizeof(s2r_t));
+	for (psi = 0; psi < 3; psi++)
+		s2->nrow[psi] = s2->ncol[psi] = NCOL60M * nbox[psi];
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		npix = (long)s2->nrow[psi] * s2->ncol[psi];
+		if ((s2->ref[ib] = (int16*)malloc(npix * sizeof(int16))) == NULL) {
+			Error("Cannot allocate memory");
+			exit(1);
+		}
+		for (k = 0; k < npix; k++)
+			s2->ref[ib][k] = (fill || rand() % 50 == 0) ? HLS_REFL_FILLVAL : rand() % 8000 - 500;
+	}
+	npix = (long)s2->nrow[0] * s2->ncol[0];
+	s2->acmask = (uint8*)malloc(npix);
+	s2->fmask = (uint8*)malloc(npix);
+	if (s2->acmask == NULL || s2->fmask == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+	for (k = 0; k < npix; k++) {
+		s2->acmask[k] = fill ? 255 : rand() % 256;
+		s2->fmask[k] = fill ? 255 : rand() % 256;
+	}
+
+	/* Each input misses B01 in a different part of the tile, as the partial granules do */
+	if (fill)
+		return;
+	for (irow = 0; irow < NCOL60M; irow++) {
+		for (icol = 0; icol < NCOL60M; icol++) {
+			if ((irow/10 + icol/15 + seed) % 3 == 0)
+				s2->ref[0][irow * NCOL60M + icol] = HLS_REFL_FILLVAL;
+		}
+	}
+}
+
+static void free_image(s2r_t *s2)
+{
+	int ib;
+
+	for (ib = 0; ib < S2NBAND; ib++)
+		free(s2->ref[ib]);
+	free(s2->acmask);
+	free(s2->fmask);
+}
+
+/* A strip of a full image, as open_s2r_strip() and read_s2r_strip() would give */
+static void strip_view(s2r_t *full, int row60m, s2r_t *view)
+{
+	int ib, psi;
+
+	*view = *full;
+	view->strip_nrow60 = STRIP_NROW60;
+	view->strip_row60 = row60m;
+	view->strip_len60 = full->nrow[2] - row60m < STRIP_NROW60 ? full->nrow[2] - row60m : STRIP_NROW60;
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		view->ref[ib] = full->ref[ib] + (long)row60m * nbox[psi] * full->ncol[psi];
+	}
+	view->acmask = full->acmask + (long)row60m * 6 * full->ncol[0];
+	view->fmask = full->fmask + (long)row60m * 6 * full->ncol[0];
+}
+
+/* The original NDVI of a 60m pixel, from the 10m red and NIR */
+static double ndvi_baseline(s2r_t *s2, int irow60m, int icol60m)
+{
+	int irow, icol;
+	long k;
+	double red, nir;
+
+	red = nir = 0;
+	for (irow = irow60m * 6; irow < irow60m * 6 + 6; irow++) {
+		for (icol = icol60m * 6; icol < icol60m * 6 + 6; icol++) {
+			k = (long)irow * s2->ncol[0] + icol;
+			if (s2->ref[3][k] != HLS_REFL_FILLVAL && s2->ref[7][k] != HLS_REFL_FILLVAL) {
+				red += s2->ref[3][k];
+				nir += s2->ref[7][k];
+			}
+		}
+	}
+	if (red != 0 && nir != 0)
+		return (nir-red)/(nir+red);
+	else
+		return HLS_REFL_FILLVAL;
+}
+
+/* The original copy of a 60m pixel and the nesting 10m and 20m pixels */
+static void copypix_baseline(s2r_t *from, int irow60m, int icol60m, s2r_t *to)
+{
+	int ib, psi, bs, irow, icol;
+	long k;
+
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		bs = nbox[psi];
+		for (irow = irow60m * bs; irow < (irow60m + 1) * bs; irow++) {
+			for (icol = icol60m * bs; icol < (icol60m + 1) * bs; icol++) {
+				k = (long)irow * from->ncol[psi] + icol;
+				to->ref[ib][k] = from->ref[ib][k];
+				if (ib == 1) {
+					to->acmask[k] = from->acmask[k];
+					to->fmask[k] = from->fmask[k];
+				}
+			}
+		}
+	}
+}
+
+static int compare_image(s2r_t *a, s2r_t *b, int nin)
+{
+	int ib, psi;
+	long k, npix;
+
+	for (ib = 0; ib < S2NBAND; ib++) {
+		psi = get_pixsz_index(ib);
+		npix = (long)a->nrow[psi] * a->ncol[psi];
+		for (k = 0; k < npix; k++) {
+			if (a->ref[ib][k] != b->ref[ib][k]) {
+				fprintf(stderr, "%d input: %s differs at pixel %ld: %d, baseline %d\n",
+						nin, S2_SDS_NAME[ib], k, a->ref[ib][k], b->ref[ib][k]);
+				return(1);
+			}
+		}
+	}
+	npix = (long)a->nrow[0] * a->ncol[0];
+	if (memcmp(a->acmask, b->acmask, npix) != 0 || memcmp(a->fmask, b->fmask, npix) != 0) {
+		fprintf(stderr, "%d input: the masks differ\n", nin);
+		return(1);
+	}
+	return(0);
+}
+
+int main()
+{
+	s2r_t in[NIN_MAX], vin[NIN_MAX], out, vout, ref;
+	double *ndvi60m;
+	uint8 *sel;
+	int nin, i, row60m, irow, icol, k;
+	long npix;
+
+	ndvi60m = (double*)malloc((size_t)NIN_MAX * STRIP_NROW60 * NCOL60M * sizeof(double));
+	sel = (uint8*)malloc((size_t)STRIP_NROW60 * NCOL60M);
+	if (ndvi60m == NULL || sel == NULL) {
+		Error("Cannot allocate memory");
+		return(1);
+	}
+
+	srand(1);
+	for (nin = 2; nin <= NIN_MAX; nin++) {
+		for (i = 0; i < nin; i++)
+			alloc_image(&in[i], 0, i);
+		/* Equal NDVI: the last input has the red and NIR of the first in half the tile */
+		npix = (long)in[0].nrow[0] * in[0].ncol[0] / 2;
+		memcpy(in[nin-1].ref[3], in[0].ref[3], npix * sizeof(int16));
+		memcpy(in[nin-1].ref[7], in[0].ref[7], npix * sizeof(int16));
+		alloc_image(&out, 1, 0);
+		alloc_image(&ref, 1, 0);
+
+		for (row60m = 0; row60m < NCOL60M; row60m += STRIP_NROW60) {
+			for (i = 0; i < nin; i++)
+				strip_view(&in[i], row60m, &vin[i]);
+			strip_view(&out, row60m, &vout);
+			consolidate_strip(vin, nin, &vout, ndvi60m, sel);
+		}
+
+		for (irow = 0; irow < NCOL60M; irow++) {
+			for (icol = 0; icol < NCOL60M; icol++) {
+				k = irow * NCOL60M + icol;
+				for (i = 0; i < nin; i++) {
+					if (in[i].ref[0][k] == HLS_REFL_FILLVAL)
+						continue;
+					if (ref.ref[0][k] == HLS_REFL_FILLVAL ||
+					    ndvi_baseline(&in[i], irow, icol) > ndvi_baseline(&ref, irow, icol))
+						copypix_baseline(&in[i], irow, icol, &ref);
+				}
+			}
+		}
+
+		if (compare_image(&out, &ref, nin) != 0)
+			return(1);
+
+		for (i = 0; i < nin; i++)
+			free_image(&in[i]);
+		free_image(&out);
+		free_image(&ref);
+	}
+	free(ndvi60m);
+	free(sel);
+
+	printf("check_consolidate: identical for 2 to %d input\n", NIN_MAX);
+	return(0);
+}
@@ -20,110 +20,243 @@
  *
  * Apr 1, 2020: Note that the mean sun/view angles are from twin A only; later in 
  *   derive_s2nbar these angles will be recomputed and so set properly. 
+ *
+ * Oct 17, 2026
+ *   Any number of partial granules (2 or more) can be consolidated, in the order
+ *   given: a 60m pixel is taken from the first input with a valid B01, and from a 
+ *   later input with a valid B01 if its NDVI is higher, as for twins A and B before.
+ *   The three images were held in memory (about 5.7 GB) and the NDVI of the output 
+ *   was recomputed after every copy. Now the input and output are accessed a strip 
+ *   of 60m rows at a time (see open_s2r_strip()). For each strip, the NDVI of each 
+ *   input is computed once for each 60m pixel, then the input for each 60m pixel is
+ *   selected, and then each band is copied in runs of 60m pixels from the same input.
+ *
+ *   Optionally (-prov) the input selected for each 60m pixel is saved in a flat binary 
+ *   uint8 raster of 60m pixels, 255 if none. With -ang, the angle files of the input, 
+ *   in the same order, are consolidated in the same pass: the four angles of the 30m 
+ *   pixels in a 60m pixel come from the input that supplies the reflectance, and 
+ *   consolidate_s2ang is not needed. Where that input has no angle, or no input is 
+ *   selected, the last input with the angle is used, which is the rule in 
+ *   consolidate_s2ang.
  ********************************************************************************/
 
 #include "s2r.h"
+#include "s2ang.h"
 #include "util.h"
 #include "hls_hdfeos.h"
 
-int copy_metadata_AB(s2r_t *s2rA, s2r_t *s2rB, s2r_t *s2rO);
+/* Memory for a strip of each input and the output */
+#define STRIP_MAXMEM (64*1024*1024)
+
+/* No input selected for a 60m pixel */
+#define NOSEL 255
+
+/* Number of pixels in one direction within a 60m pixel, for 10m, 20m, 60m */
+static int nbox[3] = {6, 3, 1};
+
+int copy_metadata_N(s2r_t *s2rin, int nin, s2r_t *s2rO);
+
+/* Select the input for each 60m pixel of the strip */
+void select_input(s2r_t *s2rin, int nin, double *ndvi60m, uint8 *sel);
+
+/* Copy a band or a mask of the strip from the selected input */
+void copy_runs(uint8 *sel, int ncol60m, int nrow, int ncol, int bs, int size, void **from, void *to);
 
-/* Keep the pixel whose 10m row/col are given */
-int copypix(s2r_t *from, int irow60m, int icol60m, s2r_t *to);
+/* Compute NDVI for each 60m pixel of the strip */
+void ndvi_strip(s2r_t *s2, double *ndvi60m);
 
-/* Compute NDVI for the 60m pixel location */
-double ndvi(s2r_t *s2, int irow60m, int icol60m);
+/* Select the input for each 60m pixel of the strip and copy the bands and masks from it */
+void consolidate_strip(s2r_t *s2rin, int nin, s2r_t *s2rO, double *ndvi60m, uint8 *sel);
+
+/* Consolidate the angles for the 60m rows of the strip */
+void merge_ang_strip(uint8 *sel, int row60m, int len60m, s2ang_t *angin, int nin, s2ang_t *angO);
 
 int main(int argc, char * argv[])
 {
 	/* Commandline parameters */
-	char fnameA[LINELEN];
-	char fnameB[LINELEN];
+	int nin;		/* Number of input */
 	char fnameO[LINELEN];	/* Consolidated, output */
-
-	s2r_t s2rA, s2rB, s2rO;
-
-	long k;
-	int ib, psi, irow, icol, nrow, ncol;
-	int irow60m, icol60m, nrow60m, ncol60m, k60m;
-	int ubidx;	/* ultra-blue band index, it is 0 */
+	char fname_prov[LINELEN];	/* Optional; input selected for each 60m pixel */
+	char **fname_in;
+	char **fname_ang;	/* Optional; angles of the input and then the output */
+	int nang;
+
+	s2r_t *s2rin, s2rO;
+	s2ang_t *angin, angO;
+	FILE *fprov;
+
+	int i, iarg;
+	int row60m, nrow60m, ncol60m;
+	uint8 *sel;		/* Input selected for each 60m pixel of a strip */
+	double *ndvi60m;	/* NDVI of each 60m pixel of a strip, for each input */
 	int ret;
 	char creationtime[50];
 	char message[MSGLEN];
 
-	if (argc != 4) {
-		fprintf(stderr, "Usage: %s fileA fileB fout\n", argv[0]);
+	/* consolidate [-prov prov.bin] fileA fileB [fileC ...] fout [-ang angA angB [angC ...] angout] */
+	fname_prov[0] = '\0';
+	fname_in = fname_ang = NULL;
+	nin = nang = 0;
+	for (iarg = 1; iarg < argc; iarg++) {
+		if (strcmp(argv[iarg], "-prov") == 0 && iarg + 1 < argc && nin == 0) 
+			strcpy(fname_prov, argv[++iarg]);
+		else if (strcmp(argv[iarg], "-ang") == 0) {
+			fname_ang = argv + iarg + 1;
+			nang = argc - iarg - 1;
+			break;
+		}
+		else {
+			if (fname_in == NULL)
+				fname_in = argv + iarg;
+			nin++;
+		}
+	}
+	nin--;		/* The last is the output */
+	if (nin < 2 || (fname_ang != NULL && nang != nin + 1)) {
+		fprintf(stderr, "Usage: %s [-prov prov.bin] fileA fileB [fileC ...] fout [-ang angA angB [angC ...] angout]\n", argv[0]);
 		exit(1);
 	}
-
-	strcpy(fnameA, argv[1]);
-	strcpy(fnameB, argv[2]);
-	strcpy(fnameO, argv[3]);
-
-	/* Read the input A */
-	strcpy(s2rA.fname, fnameA);
-	ret = open_s2r(&s2rA, DFACC_READ);
-	if (ret != 0) {
-		Error("Error in open_s2r()");
+	if (nin >= NOSEL) {
+		Error("Too many input");
 		exit(1);
 	}
+	strcpy(fnameO, fname_in[nin]);
 
-	/* Read the input B */
-	strcpy(s2rB.fname, fnameB);
-	ret = open_s2r(&s2rB, DFACC_READ);
-	if (ret != 0) {
-		Error("Error in open_s2r()");
+	/* Open the input for row-strip read */
+	if ((s2rin = (s2r_t*)calloc(nin, sizeof(s2r_t))) == NULL) {
+		Error("Cannot allocate memory");
 		exit(1);
 	}
+	for (i = 0; i < nin; i++) {
+		strcpy(s2rin[i].fname, fname_in[i]);
+		s2rin[i].ac_cloud_available[0] = '\0';
+		s2rin[i].mask_unavailable[0] = '\0';
+		ret = open_s2r_strip(&s2rin[i], DFACC_READ, STRIP_MAXMEM);
+		if (ret != 0) {
+			Error("Error in open_s2r_strip()");
+			exit(1);
+		}
+		if (s2rin[i].nrow[0] != s2rin[0].nrow[0] || s2rin[i].ncol[0] != s2rin[0].ncol[0] ||
+		    s2rin[i].strip_nrow60 != s2rin[0].strip_nrow60) {
+			sprintf(message, "Image dimension differs: %s, %s", s2rin[0].fname, s2rin[i].fname);
+			Error(message);
+			exit(1);
+		}
+	}
 
 	/* Create the output */
 	strcpy(s2rO.fname, fnameO);
-	s2rO.nrow[0] = s2rA.nrow[0];
-	s2rO.ncol[0] = s2rA.ncol[0];
-	ret = open_s2r(&s2rO, DFACC_CREATE);
+	s2rO.nrow[0] = s2rin[0].nrow[0];
+	s2rO.ncol[0] = s2rin[0].ncol[0];
+	s2rO.ac_cloud_available[0] = '\0';
+	s2rO.mask_unavailable[0] = '\0';
+	ret = open_s2r_strip(&s2rO, DFACC_CREATE, STRIP_MAXMEM);
 	if (ret != 0) {
-		Error("Error in open_s2r()");
+		Error("Error in open_s2r_strip()");
+		exit(1);
+	}
+	if (s2rO.strip_nrow60 != s2rin[0].strip_nrow60) {
+		Error("Strip height differs between input and output");
+		exit(1);
+	}
+
+	/* The angles, held in memory; the angle files are small */
+	angin = NULL;
+	if (fname_ang != NULL) {
+		if ((angin = (s2ang_t*)calloc(nin, sizeof(s2ang_t))) == NULL) {
+			Error("Cannot allocate memory");
+			exit(1);
+		}
+		for (i = 0; i < nin; i++) {
+			strcpy(angin[i].fname, fname_ang[i]);
+			if (open_s2ang(&angin[i], DFACC_READ) != 0) {
+				Error("Error in open_s2ang");
+				exit(1);
+			}
+			if (angin[i].nrow != s2rO.nrow[2] * 2 || angin[i].ncol != s2rO.ncol[2] * 2) {
+				sprintf(message, "Angle dimension differs from S10: %s", angin[i].fname);
+				Error(message);
+				exit(1);
+			}
+		}
+		strcpy(angO.fname, fname_ang[nin]);
+		angO.nrow = angin[0].nrow;
+		angO.ncol = angin[0].ncol;
+		angO.ulx = angin[0].ulx;
+		angO.uly = angin[0].uly;
+		strcpy(angO.zonehem, angin[0].zonehem);
+		if (open_s2ang(&angO, DFACC_CREATE) != 0) {
+			Error("Error in open_s2ang");
+			exit(1);
+		}
+	}
+
+	fprov = NULL;
+	if (fname_prov[0] != '\0' && (fprov = fopen(fname_prov, "w")) == NULL) {
+		sprintf(message, "Cannot create %s", fname_prov);
+		Error(message);
 		exit(1);
 	}
 
 	/* Use a 60m band to guide the consolidation to make sure a 60m pixel
 	 * and the nesting 10m and 20m pixels come from the same datastrip.. 
 	 */
-	ubidx = 0; 	
 	nrow60m = s2rO.nrow[2];
 	ncol60m = s2rO.ncol[2];
-	for (irow60m = 0; irow60m < nrow60m; irow60m++) { 
-		for (icol60m = 0; icol60m < ncol60m; icol60m++) { 
-			k60m = irow60m * ncol60m + icol60m;
-			/* Check on the first 60m band */
-			if (s2rA.ref[ubidx][k60m] != HLS_REFL_FILLVAL ) 
-				copypix(&s2rA, irow60m, icol60m, &s2rO);
-
-			if (s2rB.ref[ubidx][k60m] != HLS_REFL_FILLVAL) {
-				if (s2rO.ref[ubidx][k60m] == HLS_REFL_FILLVAL) 
-					copypix(&s2rB, irow60m, icol60m, &s2rO);
-				else if (ndvi(&s2rB, irow60m, icol60m) > ndvi(&s2rO, irow60m,icol60m)) 
-					copypix(&s2rB, irow60m, icol60m, &s2rO);
+	if ((sel = (uint8*)malloc((size_t)s2rO.strip_nrow60 * ncol60m)) == NULL ||
+	    (ndvi60m = (double*)malloc((size_t)nin * s2rO.strip_nrow60 * ncol60m * sizeof(double))) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+	for (row60m = 0; row60m < nrow60m; row60m += s2rO.strip_nrow60) {
+		for (i = 0; i < nin; i++) {
+			if (read_s2r_strip(&s2rin[i], row60m) != 0) {
+				Error("Error in read_s2r_strip()");
+				exit(1);
 			}
 		}
+		if (read_s2r_strip(&s2rO, row60m) != 0) {	/* Fill */
+			Error("Error in read_s2r_strip()");
+			exit(1);
+		}
+
+		consolidate_strip(s2rin, nin, &s2rO, ndvi60m, sel);
+		if (fprov != NULL &&
+		    fwrite(sel, 1, (size_t)s2rO.strip_len60 * ncol60m, fprov) != (size_t)s2rO.strip_len60 * ncol60m) {
+			sprintf(message, "Error writing %s", fname_prov);
+			Error(message);
+			exit(1);
+		}
+		if (angin != NULL)
+			merge_ang_strip(sel, row60m, s2rO.strip_len60, angin, nin, &angO);
+
+		if (write_s2r_strip(&s2rO) != 0) {
+			Error("Error in write_s2r_strip()");
+			exit(1);
+		}
+
+		/* Spatial and cloud coverage, set after the last strip */
+		setcoverage(&s2rO);
 	}
 
-	/* Copy the metadata from twin granules. 
-	 * Update HLS processing time, reset spatial and cloud coverages
+	if (fprov != NULL)
+		fclose(fprov);
+
+	/* Copy the metadata from the partial granules. 
+	 * Update HLS processing time.
 	 */
-	ret = copy_metadata_AB(&s2rA, &s2rB, &s2rO);
+	ret = copy_metadata_N(s2rin, nin, &s2rO);
 	if (ret != 0) {
-		Error("Error in copy_metadata_AB");
+		Error("Error in copy_metadata_N");
 		return(-1);
 	}
 	getcurrenttime(creationtime);
 	SDsetattr(s2rO.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
-	setcoverage(&s2rO);
 
 	/* A few variables needed to create the ENVI header */
-	s2rO.ulx = s2rA.ulx;
-	s2rO.uly = s2rA.uly;
-	strcpy(s2rO.zonehem, s2rA.zonehem);
+	s2rO.ulx = s2rin[0].ulx;
+	s2rO.uly = s2rin[0].uly;
+	strcpy(s2rO.zonehem, s2rin[0].zonehem);
 
 	/* Close */
 	ret = close_s2r(&s2rO);
@@ -131,9 +264,28 @@ int main(int argc, char * argv[])
 		Error("Erro in close_s2r()");
 		exit(1);
 	}
+	for (i = 0; i < nin; i++) 
+		close_s2r(&s2rin[i]);
+
+	if (angin != NULL) {
+		for (i = 0; i < nin; i++) 
+			close_s2ang(&angin[i]);
+		if (close_s2ang(&angO) != 0) {
+			Error("Error in close_s2ang");
+			exit(1);
+		}
+		sds_info_t ang_sds[NANG];
+		set_S2ang_sds_info(ang_sds, NANG, &angO);
+		if (!is_hls_raw(angO.fname) && angle_PutSpaceDefHDF(angO.fname, ang_sds, NANG) != 0) {
+			Error("Error in angle_PutSpaceDefHDF");
+			exit(1);
+		}
+	}
 
 
-	/* Make it hdfeos */
+	/* Make it hdfeos, unless it is a raw intermediate (see hls_raw.h) */
+	if (is_hls_raw(s2rO.fname))
+		return(0);
  	sds_info_t all_sds[S2NBAND+2];
 	set_S10_sds_info(all_sds, S2NBAND+2, &s2rO);
 	ret = S10_PutSpaceDefHDF(s2rO.fname, all_sds, S2NBAND+2);
@@ -145,57 +297,88 @@ int main(int argc, char * argv[])
 }
 
 
-/* Copy the input metadata from the twin granules A and B into into the consolidated 
- * granule, concatenating a few key metadata item that are different between A and B.
+/* Copy the input metadata from the partial granules into into the consolidated 
+ * granule, concatenating a few key metadata item that are different between them.
  * 
  * Dec 22, 2016. 
  * Jan 23, 2017.
+ * Oct 17, 2026: Any number of input.
  */
-int copy_metadata_AB(s2r_t *s2rA, s2r_t *s2rB, s2r_t *s2rO)
+static void set_joined_attr(int32 sd_id, char *attrname, char **val, int nin)
 {
-	char attr[1000];
+	char *attr;
+	size_t len;
+	int i;
+
+	len = 1;
+	for (i = 0; i < nin; i++) 
+		len += strlen(val[i]) + 3;
+	if ((attr = (char*)malloc(len)) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+
+	/* Use '+' because ':' has been used in data quality string. */
+	strcpy(attr, val[0]);
+	for (i = 1; i < nin; i++) {
+		strcat(attr, " + ");
+		strcat(attr, val[i]);
+	}
+	SDsetattr(sd_id, attrname, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	free(attr);
+}
+
+int copy_metadata_N(s2r_t *s2rin, int nin, s2r_t *s2rO)
+{
+	s2r_t *s2rA = &s2rin[0];
+	char **val;
+	int i;
+
 	/* SAFE name not available in Google data.  Nov 15, 2016.
 	 * SDsetattr(s2at30m->sd_id, SAFE_NAME, DFNT_CHAR8, strlen(s2r->safe_name), (VOIDP)s2r->safe_name);
 	 */
-	if (get_all_metadata(s2rA) != 0) {
-		Error("Error in copy_metadata_AB");
-		return(-1);
+	for (i = 0; i < nin; i++) {
+		if (get_all_metadata(&s2rin[i]) != 0) {
+			Error("Error in copy_metadata_N");
+			return(-1);
+		}
 	}
-	if (get_all_metadata(s2rB) != 0) {
-		Error("Error in copy_metadata_AB");
+	if ((val = (char**)malloc(nin * sizeof(char*))) == NULL) {
+		Error("Cannot allocate memory");
 		return(-1);
 	}
 
 	/* URI */
-	sprintf(attr, "%s + %s", s2rA->uri, s2rB->uri);	 /* Use '+' because ':' has been used in data quality string. */
-	SDsetattr(s2rO->sd_id, PRODUCT_URI, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].uri;
+	set_joined_attr(s2rO->sd_id, PRODUCT_URI, val, nin);
 
 	/* Quality */
-	sprintf(attr, "%s + %s", s2rA->quality, s2rB->quality);
-	SDsetattr(s2rO->sd_id, L1C_QUALITY, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].quality;
+	set_joined_attr(s2rO->sd_id, L1C_QUALITY, val, nin);
 
 	/* Spacecraft, same */
 	SDsetattr(s2rO->sd_id, SPACECRAFT,  DFNT_CHAR8, strlen(s2rA->spacecraft), (VOIDP)s2rA->spacecraft);
 
 	/* tile ID. Should really be granuel ID */
-	sprintf(attr, "%s + %s", s2rA->tile_id, s2rB->tile_id);
-	SDsetattr(s2rO->sd_id, TILE_ID, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].tile_id;
+	set_joined_attr(s2rO->sd_id, TILE_ID, val, nin);
 
 	/* DATASTRIP must be different */
-	sprintf(attr, "%s + %s", s2rA->datastrip_id, s2rB->datastrip_id);
-	SDsetattr(s2rO->sd_id, DATASTRIP_ID, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].datastrip_id;
+	set_joined_attr(s2rO->sd_id, DATASTRIP_ID, val, nin);
 
 	/* BASELINE */
-	sprintf(attr, "%s + %s", s2rA->baseline, s2rB->baseline);
-	SDsetattr(s2rO->sd_id, PROCESSING_BASELINE, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].baseline;
+	set_joined_attr(s2rO->sd_id, PROCESSING_BASELINE, val, nin);
 	
 	/* SENSING_TIME */
-	sprintf(attr, "%s + %s", s2rA->sensing_time, s2rB->sensing_time);
-	SDsetattr(s2rO->sd_id, SENSING_TIME, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].sensing_time;
+	set_joined_attr(s2rO->sd_id, SENSING_TIME, val, nin);
 
 	/* ACCODE */
-	sprintf(attr, "%s + %s", s2rA->accode, s2rB->accode);
-	SDsetattr(s2rO->sd_id, ACCODE, DFNT_CHAR8, strlen(attr), (VOIDP)attr);
+	for (i = 0; i < nin; i++) val[i] = s2rin[i].accode;
+	set_joined_attr(s2rO->sd_id, ACCODE, val, nin);
+	free(val);
 
 	SDsetattr(s2rO->sd_id, L1PROCTIME, DFNT_CHAR8, strlen(s2rA->l1proctime), (VOIDP)s2rA->l1proctime);
 	SDsetattr(s2rO->sd_id, HORIZONTAL_CS_NAME, DFNT_CHAR8, strlen(s2rA->cs_name), (VOIDP)s2rA->cs_name);
@@ -217,80 +400,163 @@ int copy_metadata_AB(s2r_t *s2rA, s2r_t *s2rB, s2r_t *s2rO)
 	return(0);
 }
 
-int copypix(s2r_t *from, int irow60m, int icol60m, s2r_t *to)
+/* Consolidate the strip read into s2rin[] into the strip of s2rO, which has been set 
+ * to fill. ndvi60m holds the NDVI of the strip_nrow60 rows of each input, and sel 
+ * receives the input selected for each 60m pixel. 
+ */
+void consolidate_strip(s2r_t *s2rin, int nin, s2r_t *s2rO, double *ndvi60m, uint8 *sel)
 {
-	/* From the ultrablue band (60m) to find the nesting 10m/20m pixels. */ 
-	int irow, icol, nrow, ncol, k;
-	int rowbeg, rowend, colbeg, colend;
-	int ib, psi;
-	int bs;	/* number of pixels in one direction at the pixel size of interest
-		 * within a 60m pixels. It is 1, 3, 6.
-		 */
+	int i, ib, psi, bs;
+	int ncol60m;
+	void *from[NOSEL];
+
+	ncol60m = s2rO->ncol[2];
+	for (i = 0; i < nin; i++) 
+		ndvi_strip(&s2rin[i], ndvi60m + (size_t)i * s2rO->strip_nrow60 * ncol60m);
+	select_input(s2rin, nin, ndvi60m, sel);
 
 	for (ib = 0; ib < S2NBAND; ib++) {
 		psi = get_pixsz_index(ib);
-		if (psi == 0)
-		       	bs = 6; 		/* 10m bands */
-		else if (psi == 1) 
-			bs = 3;			/* 20m bands */
-		else if (psi == 2) 
-			bs = 1;			/* 60m bands */
-		else { 
-			fprintf(stderr, "Wrong psi = %d\n", psi);
-			exit(1);
+		bs = nbox[psi];
+		for (i = 0; i < nin; i++) 
+			from[i] = s2rin[i].ref[ib];
+		copy_runs(sel, ncol60m, s2rO->strip_len60 * bs, s2rO->ncol[psi], bs, sizeof(int16), from, s2rO->ref[ib]);
+	}
+	for (i = 0; i < nin; i++) 
+		from[i] = s2rin[i].acmask;
+	copy_runs(sel, ncol60m, s2rO->strip_len60 * 6, s2rO->ncol[0], 6, 1, from, s2rO->acmask);
+	for (i = 0; i < nin; i++) 
+		from[i] = s2rin[i].fmask;
+	copy_runs(sel, ncol60m, s2rO->strip_len60 * 6, s2rO->ncol[0], 6, 1, from, s2rO->fmask);
+}
+
+/* For each 60m pixel of the strip, the first input with a valid B01 is selected,
+ * unless a later input with a valid B01 has a higher NDVI. 
+ */
+void select_input(s2r_t *s2rin, int nin, double *ndvi60m, uint8 *sel)
+{
+	int i, k, npix;
+	int ubidx;	/* ultra-blue band index, it is 0 */
+	double *ndvi;
+
+	ubidx = 0; 	
+	npix = s2rin[0].strip_len60 * s2rin[0].ncol[2];
+	for (k = 0; k < npix; k++) {
+		sel[k] = NOSEL;
+		for (i = 0; i < nin; i++) {
+			/* Check on the first 60m band */
+			if (s2rin[i].ref[ubidx][k] == HLS_REFL_FILLVAL) 
+				continue;
+			ndvi = ndvi60m + (size_t)i * s2rin[0].strip_nrow60 * s2rin[0].ncol[2];
+			if (sel[k] == NOSEL) 
+				sel[k] = i;
+			else if (ndvi[k] > (ndvi60m + (size_t)sel[k] * s2rin[0].strip_nrow60 * s2rin[0].ncol[2])[k]) 
+				sel[k] = i;
 		}
+	}
+}
+
+/* Copy nrow rows of a band (or a mask) in the strip from the input selected for each 60m
+ * pixel, a run of 60m pixels from the same input at a time. bs is the number of pixels in 
+ * a 60m pixel in one direction (6, 3, 1), and size is the bytes of a pixel. The pixels 
+ * with no input selected are left as fill.
+ */
+void copy_runs(uint8 *sel, int ncol60m, int nrow, int ncol, int bs, int size, void **from, void *to)
+{
+	int irow, c60beg, c60end;
+	uint8 *selrow;
+	size_t off;
+
+	for (irow = 0; irow < nrow; irow++) {
+		selrow = sel + (irow/bs) * ncol60m;
+		for (c60beg = 0; c60beg < ncol60m; c60beg = c60end) {
+			for (c60end = c60beg + 1; c60end < ncol60m && selrow[c60end] == selrow[c60beg]; c60end++)
+				;
+			if (selrow[c60beg] == NOSEL)
+				continue;
+			off = ((size_t)irow * ncol + c60beg * bs) * size;
+			memcpy((char*)to + off, (char*)from[selrow[c60beg]] + off, (size_t)(c60end - c60beg) * bs * size);
+		}
+	}
+}
+
+/* Compute NDVI for each 60m pixel of the strip */
+void ndvi_strip(s2r_t *s2, double *ndvi60m)
+{
+	int irow, icol, irow60m, icol60m;
+	int ncol, ncol60m;
+	long k;
+	int32 *red, *nir;	/* Sums over the 10m pixels in a 60m pixel; exact as before in double */
+	int bs = 6; 	/* 6 10m pixels nesting within a 60m pixel in one dimension */
+
+	ncol = s2->ncol[0]; 	/* 10m pixels */
+	ncol60m = s2->ncol[2];
+	if ((red = (int32*)calloc(ncol60m, sizeof(int32))) == NULL ||
+	    (nir = (int32*)calloc(ncol60m, sizeof(int32))) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+
+	for (irow60m = 0; irow60m < s2->strip_len60; irow60m++) {
+		for (icol60m = 0; icol60m < ncol60m; icol60m++) 
+			red[icol60m] = nir[icol60m] = 0;
 
-		ncol = from->ncol[psi];
-		rowbeg = irow60m * bs;
-		rowend = rowbeg + bs - 1;
-		colbeg = icol60m * bs;
-		colend = colbeg + bs - 1;
-		
-		for (irow = rowbeg; irow <= rowend; irow++) {
-			for (icol = colbeg; icol <= colend; icol++) {
-				k = irow * ncol + icol;
-				to->ref[ib][k] = from->ref[ib][k];
-
-				/* Set mask only once, when handling the first 10m band */
-				if (ib == 1) {
-					to->acmask[k] = from->acmask[k];
-					to->fmask[k] = from->fmask[k];
+		for (irow = irow60m * bs; irow < (irow60m + 1) * bs; irow++) {
+			for (icol = 0; icol < ncol60m * bs; icol++) {
+				k = (long)irow * ncol + icol;
+				if (s2->ref[3][k] != HLS_REFL_FILLVAL && s2->ref[7][k] != HLS_REFL_FILLVAL) {
+					red[icol/bs] += s2->ref[3][k];
+					nir[icol/bs] += s2->ref[7][k];
 				}
 			}
 		}
+
+		for (icol60m = 0; icol60m < ncol60m; icol60m++) {
+			k = (long)irow60m * ncol60m + icol60m;
+			if (red[icol60m] != 0 && nir[icol60m] != 0)
+				ndvi60m[k] = ((double)nir[icol60m] - red[icol60m]) / ((double)nir[icol60m] + red[icol60m]);
+			else
+				ndvi60m[k] = HLS_REFL_FILLVAL;
+		}
 	}
 
-	return 0;
+	free(red);
+	free(nir);
 }
 
-/* Compute NDVI for the 60m pixel location */
-double ndvi(s2r_t *s2, int irow60m, int icol60m)
+/* Consolidate the angles of the 30m pixels in the 60m rows of the strip: from the 
+ * input selected for the 60m pixel, or else from the last input with the angle.
+ */
+void merge_ang_strip(uint8 *sel, int row60m, int len60m, s2ang_t *angin, int nin, s2ang_t *angO)
 {
-	int irow, icol;
-	int ncol, k;
-	int rowbeg, rowend, colbeg, colend;
-	double red, nir;
-	int bs = 6; 	/* 6 10m pixels nesting within a 60m pixel in one dimension */
+	int i, ib;
+	int bs = 2;	/* 2 30m pixels within a 60m pixel in one dimension */
+	size_t off, k, npix;
+	void **from;
 
-	ncol = s2->ncol[0]; 	/* 10m pixels */
+	if ((from = (void**)malloc(nin * sizeof(void*))) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
 
-	rowbeg = irow60m * bs;
-	rowend = rowbeg + bs - 1;
-	colbeg = icol60m * bs;
-	colend = colbeg + bs - 1;
-
-	red = nir = 0;
-	for (irow = rowbeg; irow <= rowend; irow++) {
-		for (icol = colbeg; icol <= colend; icol++) {
-			k = irow * ncol + icol;
-			if (s2->ref[3][k] != HLS_REFL_FILLVAL && s2->ref[7][k] != HLS_REFL_FILLVAL) {
-      				red += s2->ref[3][k];
-				nir += s2->ref[7][k];
+	off = (size_t)row60m * bs * angO->ncol;
+	npix = (size_t)len60m * bs * angO->ncol;
+	for (ib = 0; ib < NANG; ib++) {
+		for (i = 0; i < nin; i++) 
+			from[i] = angin[i].ang[ib] + off;
+		copy_runs(sel, angO->ncol/bs, len60m * bs, angO->ncol, bs, sizeof(uint16), from, angO->ang[ib] + off);
+
+		for (k = off; k < off + npix; k++) {
+			if (angO->ang[ib][k] != ANGFILL)
+				continue;
+			for (i = nin - 1; i >= 0; i--) {
+				if (angin[i].ang[ib][k] != ANGFILL) {
+					angO->ang[ib][k] = angin[i].ang[ib][k];
+					break;
+				}
 			}
 		}
 	}
-	if (red != 0 && nir != 0)
-		return (nir-red)/(nir+red);
-	else
-		return HLS_REFL_FILLVAL;
+
+	free(from);
 }
@@ -102,41 +102,5 @@ int copy_metadata(s2r_t *s2r, s2at30m_t *s2at30m)
 	if (ret != 0)
 		return(ret);
 
-	/* Update for S30 */
-	strcpy(s2r->nr, "3660");
-	strcpy(s2r->nc, "3660");
-	strcpy(s2r->spatial_resolution, "30");
-
-	SDsetattr(s2at30m->sd_id, PRODUCT_URI, DFNT_CHAR8, strlen(s2r->uri), (VOIDP)s2r->uri);
-	SDsetattr(s2at30m->sd_id, L1C_QUALITY, DFNT_CHAR8, strlen(s2r->quality), (VOIDP)s2r->quality);
-	SDsetattr(s2at30m->sd_id, SPACECRAFT, DFNT_CHAR8, strlen(s2r->spacecraft), (VOIDP)s2r->spacecraft);
-	SDsetattr(s2at30m->sd_id, TILE_ID, DFNT_CHAR8, strlen(s2r->tile_id), (VOIDP)s2r->tile_id);
-	SDsetattr(s2at30m->sd_id, DATASTRIP_ID, DFNT_CHAR8, strlen(s2r->datastrip_id), (VOIDP)s2r->datastrip_id);
-	SDsetattr(s2at30m->sd_id, PROCESSING_BASELINE, DFNT_CHAR8, strlen(s2r->baseline), (VOIDP)s2r->baseline);
-	SDsetattr(s2at30m->sd_id, SENSING_TIME, DFNT_CHAR8, strlen(s2r->sensing_time), (VOIDP)s2r->sensing_time);
-	SDsetattr(s2at30m->sd_id, L1PROCTIME, DFNT_CHAR8, strlen(s2r->l1proctime), (VOIDP)s2r->l1proctime);
-	SDsetattr(s2at30m->sd_id, HORIZONTAL_CS_NAME, DFNT_CHAR8, strlen(s2r->cs_name), (VOIDP)s2r->cs_name);
-	SDsetattr(s2at30m->sd_id, HORIZONTAL_CS_CODE, DFNT_CHAR8, strlen(s2r->cs_code), (VOIDP)s2r->cs_code);
-	SDsetattr(s2at30m->sd_id, NROWS, DFNT_CHAR8, strlen(s2r->nr), (VOIDP)s2r->nr);
-	SDsetattr(s2at30m->sd_id, NCOLS, DFNT_CHAR8, strlen(s2r->nc), (VOIDP)s2r->nc);
-	SDsetattr(s2at30m->sd_id, SPATIAL_RESOLUTION, DFNT_CHAR8, strlen(s2r->spatial_resolution), (VOIDP)s2r->spatial_resolution);
-	SDsetattr(s2at30m->sd_id, ULX, DFNT_FLOAT64, 1, (VOIDP)&(s2r->ululx));
-	SDsetattr(s2at30m->sd_id, ULY, DFNT_FLOAT64, 1, (VOIDP)&(s2r->ululy));
-	SDsetattr(s2at30m->sd_id, MSZ, DFNT_FLOAT64, 1, (VOIDP)&(s2r->msz));
-	SDsetattr(s2at30m->sd_id, MSA, DFNT_FLOAT64, 1, (VOIDP)&(s2r->msa));
-	SDsetattr(s2at30m->sd_id, MVZ, DFNT_FLOAT64, 1, (VOIDP)&(s2r->mvz));
-	SDsetattr(s2at30m->sd_id, MVA, DFNT_FLOAT64, 1, (VOIDP)&(s2r->mva));
-
-	SDsetattr(s2at30m->sd_id, SPCOVER, DFNT_INT16, 1, (VOIDP)&(s2r->spcover));
-	SDsetattr(s2at30m->sd_id, CLCOVER, DFNT_INT16, 1, (VOIDP)&(s2r->clcover));
-	SDsetattr(s2at30m->sd_id, ACCODE,  DFNT_CHAR8, strlen(s2r->accode), (VOIDP)s2r->accode); 
-
-	/* AROP related */
-	SDsetattr(s2at30m->sd_id, S_AROP_REFIMG, DFNT_CHAR8, strlen(s2r->refimg), (VOIDP)s2r->refimg);
-	SDsetattr(s2at30m->sd_id, S_AROP_NCP,  DFNT_INT32, 1, (VOIDP)&s2r->ncp);
-	SDsetattr(s2at30m->sd_id, S_AROP_RMSE, DFNT_FLOAT64, 1, (VOIDP)&s2r->rmse);
-	SDsetattr(s2at30m->sd_id, S_AROP_XSHIFT, DFNT_FLOAT64, 1, (VOIDP)&s2r->xshift);
-	SDsetattr(s2at30m->sd_id, S_AROP_YSHIFT, DFNT_FLOAT64, 1, (VOIDP)&s2r->yshift);
-
-	return(0);
+	return set_s2at30m_metadata(s2r, s2at30m);
 }
@@ -0,0 +1,187 @@
+/* Regression check for read_s2anggrid(): write a synthetic granule xml with the sun
+ * angles and the view angles of all the bands and detectors, and compare the grids with
+ * the original line-by-line fscanf/atof parser. After the truncation to hundredths of a
+ * degree that both use, the values must be identical, and NaN must be where the original
+ * parser saw NaN. Exit status is 1 on any difference.
+ *
+ * Oct 17, 2026
+ */
+#include <math.h>
+#include "s2ang.h"
+
+#define NBAND_XML 13
+#define NTEST 10
+
+static uint16 sunang[2][N5KM][N5KM];
+static uint16 viewang[2][NDETECTOR+1][N5KM][N5KM];
+
+/* Write one Zenith or Azimuth block with the layout of MTD_TL.xml. nanpct is the percentage
+ * of NaN values.
+ */
+static void write_block(FILE *fxml, char *name, int nanpct)
+{
+	int irow, icol, ndig;
+
+	fprintf(fxml, "        <%s>\n", name);
+	fprintf(fxml, "          <COL_STEP unit=\"m\">5000</COL_STEP>\n");
+	fprintf(fxml, "          <ROW_STEP unit=\"m\">5000</ROW_STEP>\n");
+	fprintf(fxml, "          <Values_List>\n");
+	for (irow = 0; irow < N5KM; irow++) {
+		fprintf(fxml, "            <VALUES>");
+		for (icol = 0; icol < N5KM; icol++) {
+			if (icol > 0)
+				fprintf(fxml, " ");
+			ndig = rand() % 12;
+			if (rand() % 100 < nanpct)
+				fprintf(fxml, "NaN");
+			else if (rand() % 10 == 0)	/* Exact hundredths, e.g. 12.34 */
+				fprintf(fxml, "%.2f", (rand() % 36000) / 100.0);
+			else
+				fprintf(fxml, "%.*f", ndig, 360.0 * rand() / RAND_MAX);
+		}
+		fprintf(fxml, "</VALUES>\n");
+	}
+	fprintf(fxml, "          </Values_List>\n");
+	fprintf(fxml, "        </%s>\n", name);
+}
+
+static void write_xml(char *fname_xml)
+{
+	FILE *fxml;
+	int ib, id;
+
+	if ((fxml = fopen(fname_xml, "w")) == NULL) {
+		Error("Cannot create the xml file");
+		exit(1);
+	}
+	fprintf(fxml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(fxml, "<n1:Level-1C_Tile_ID>\n  <n1:Geometric_Info>\n    <Tile_Angles>\n");
+	fprintf(fxml, "      <Sun_Angles_Grid>\n");
+	write_block(fxml, "Zenith", 0);
+	write_block(fxml, "Azimuth", 0);
+	fprintf(fxml, "      </Sun_Angles_Grid>\n");
+	fprintf(fxml, "      <Mean_Sun_Angle>\n        <ZENITH_ANGLE unit=\"deg\">30.1</ZENITH_ANGLE>\n      </Mean_Sun_Angle>\n");
+	for (ib = 0; ib < NBAND_XML; ib++) {
+		for (id = 1; id <= NDETECTOR; id++) {
+			fprintf(fxml, "      <Viewing_Incidence_Angles_Grids bandId=\"%d\" detectorId=\"%d\">\n", ib, id);
+			write_block(fxml, "Zenith", rand() % 100);
+			write_block(fxml, "Azimuth", rand() % 100);
+			fprintf(fxml, "      </Viewing_Incidence_Angles_Grids>\n");
+		}
+	}
+	fprintf(fxml, "    </Tile_Angles>\n  </n1:Geometric_Info>\n</n1:Level-1C_Tile_ID>\n");
+	fclose(fxml);
+}
+
+/* The original parser: skip the fixed number of lines after a tag and scan the values
+ * with fscanf and atof. The angles are kept as they were stored, in hundredths of a degree,
+ * with ANGFILL for NaN.
+ */
+static void read_values_baseline(FILE *fxml, uint16 ang[N5KM][N5KM])
+{
+	char line[500], str[200];
+	double val;
+	int irow, icol;
+
+	fgets(line, sizeof(line), fxml);	/* <COL_STEP unit="m">5000</COL_STEP> */
+	fgets(line, sizeof(line), fxml);	/* <ROW_STEP unit="m">5000</ROW_STEP> */
+	fgets(line, sizeof(line), fxml);	/* <Values_List> */
+	for (irow = 0; irow < N5KM; irow++) {
+		for (icol = 0; icol < N5KM; icol++) {
+			fscanf(fxml, "%s", str);
+			if (strstr(str, "NaN"))
+				val = ANGFILL;
+			else
+				val = atof(icol == 0 ? str+strlen("<VALUES>") : str);
+			ang[irow][icol] = val == ANGFILL ? ANGFILL : val * 100;
+		}
+	}
+	fgets(line, sizeof(line), fxml);	/* There is a "\n" trailing "</VALUES>" */
+	fgets(line, sizeof(line), fxml);	/* </Values_List> */
+	fgets(line, sizeof(line), fxml);	/* </Zenith> or </Azimuth> */
+}
+
+static void read_xml_baseline(char *fname_xml)
+{
+	FILE *fxml;
+	char line[500];
+	uint16 skip[N5KM][N5KM];
+	int bandid, detid;
+
+	if ((fxml = fopen(fname_xml, "r")) == NULL) {
+		Error("Cannot read the xml file");
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fxml)) {
+		if (strstr(line, "<Sun_Angles_Grid>")) {
+			fgets(line, sizeof(line), fxml);	/* <Zenith> */
+			read_values_baseline(fxml, sunang[0]);
+			fgets(line, sizeof(line), fxml);	/* <Azimuth> */
+			read_values_baseline(fxml, sunang[1]);
+		}
+		if (strstr(line, "<Viewing_Incidence_Angles_Grids bandId=")) {
+			bandid = atoi(strstr(line, "bandId=\"") + strlen("bandId=\""));
+			detid = atoi(strstr(line, "detectorId=\"") + strlen("detectorId=\""));
+			fgets(line, sizeof(line), fxml);	/* <Zenith> */
+			read_values_baseline(fxml, bandid == 5 ? viewang[0][detid] : skip);
+			fgets(line, sizeof(line), fxml);	/* <Azimuth> */
+			read_values_baseline(fxml, bandid == 5 ? viewang[1][detid] : skip);
+		}
+	}
+	fclose(fxml);
+}
+
+/* Compare a grid from read_s2anggrid() with the original, as stored in hundredths */
+static int compare_grid(double val[N5KM][N5KM], uint16 ref[N5KM][N5KM], char *what, int detid)
+{
+	int irow, icol;
+	uint16 ang;
+
+	for (irow = 0; irow < N5KM; irow++) {
+		for (icol = 0; icol < N5KM; icol++) {
+			ang = isnan(val[irow][icol]) ? ANGFILL : val[irow][icol] * 100;
+			if (ang != ref[irow][icol]) {
+				fprintf(stderr, "%s detector %d differs at %d,%d: %d, baseline %d\n",
+						what, detid, irow, icol, ang, ref[irow][icol]);
+				return(1);
+			}
+		}
+	}
+	return(0);
+}
+
+int main()
+{
+	char *fname_xml = "check_anggrid_MTD_TL.xml";
+	s2anggrid_t *grid;
+	int itest, id;
+
+	if ((grid = (s2anggrid_t*)malloc(sizeof(s2anggrid_t))) == NULL) {
+		Error("Cannot allocate memory");
+		return(1);
+	}
+
+	srand(1);
+	for (itest = 0; itest < NTEST; itest++) {
+		write_xml(fname_xml);
+		read_xml_baseline(fname_xml);
+		if (read_s2anggrid(fname_xml, grid) != 0) {
+			Error("Error in read_s2anggrid");
+			return(1);
+		}
+		if (compare_grid(grid->sz, sunang[0], "Sun zenith", 0) != 0 ||
+		    compare_grid(grid->sa, sunang[1], "Sun azimuth", 0) != 0)
+			return(1);
+		for (id = 1; id <= NDETECTOR; id++) {
+			if (compare_grid(grid->vz[id], viewang[0][id], "View zenith", id) != 0 ||
+			    compare_grid(grid->va[id], viewang[1][id], "View azimuth", id) != 0)
+				return(1);
+		}
+	}
+
+	remove(fname_xml);
+	free(grid);
+
+	printf("check_anggrid: %d xml files parsed identically\n", NTEST);
+	return(0);
+}
@@ -0,0 +1,151 @@
+/* Regression check for rasterize_s2detfoo(): rasterize synthetic footprint polygons
+ * written to a gml file and compare the result with the original per-pixel crossing
+ * test. The footprint images must be identical. Exit status is 1 on any difference.
+ *
+ * The polygons are random star shapes, convex or not, with some vertices on pixel
+ * centers or on whole meters so that rows pass exactly through vertices.
+ *
+ * Oct 17, 2026
+ */
+#include <math.h>
+#include "s2detfoo.h"
+
+#define NPOLY_MAX 4
+#define NTEST 40
+
+/* The original rasterization of one polygon: for each row, find all the crossings of
+ * the polygon edges and test every pixel against them.
+ */
+static void fill_polygon_baseline(s2detfoo_t *s2detfoo, double *x, double *y, int n, int detid)
+{
+	double *ex, px, py;
+	int irow, icol, i, j, k, m, im;
+	char in;
+
+	if ((ex = malloc(n * sizeof(double))) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+	for (irow = 0; irow < s2detfoo->nrow; irow++) {
+		py = s2detfoo->uly - (irow+0.5) * DETFOOPIXSZ;
+		m = 0;
+		for (i = 0, j = n-1; i < n; j = i++) {
+			if ( (y[i]>py) != (y[j]>py) )
+				ex[m++] = (x[j]-x[i]) * (py-y[i]) / (y[j]-y[i]) + x[i];
+		}
+		if (m == 0)
+			continue;
+
+		for (icol = 0; icol < s2detfoo->ncol; icol++) {
+			px = s2detfoo->ulx + (icol+0.5) * DETFOOPIXSZ;
+			k = irow * s2detfoo->ncol + icol;
+			if (s2detfoo->detid[k] != DETIDFILL)
+				continue;
+			in = 0;
+			for (im = 0; im < m; im++) {
+				if (px < ex[im])
+					in = !in;
+			}
+			if (in)
+				s2detfoo->detid[k] = detid;
+		}
+	}
+	free(ex);
+}
+
+static double frand(double a, double b)
+{
+	return a + (b - a) * rand() / RAND_MAX;
+}
+
+int main()
+{
+	char *fname_gml = "check_detfoo_B06.gml";
+	s2detfoo_t s2detfoo, ref;
+	FILE *fgml;
+	double *x, *y, cx, cy, r, a;
+	int itest, ipoly, npoly, n, nv, detid, i;
+	long k, npix, nfilled;
+
+	s2detfoo.nrow = ref.nrow = 400;
+	s2detfoo.ncol = ref.ncol = 500;
+	s2detfoo.ulx = ref.ulx = 600000;
+	s2detfoo.uly = ref.uly = 4000020;
+	npix = (long)s2detfoo.nrow * s2detfoo.ncol;
+	s2detfoo.detid = (uint8*)malloc(npix);
+	ref.detid = (uint8*)malloc(npix);
+	x = (double*)malloc(NPOLY_MAX * 2000 * sizeof(double));
+	y = (double*)malloc(NPOLY_MAX * 2000 * sizeof(double));
+	if (s2detfoo.detid == NULL || ref.detid == NULL || x == NULL || y == NULL) {
+		Error("Cannot allocate memory");
+		return(1);
+	}
+
+	srand(1);
+	nfilled = 0;
+	for (itest = 0; itest < NTEST; itest++) {
+		memset(s2detfoo.detid, DETIDFILL, npix);
+		memset(ref.detid, DETIDFILL, npix);
+
+		if ((fgml = fopen(fname_gml, "w")) == NULL) {
+			Error("Cannot create the gml file");
+			return(1);
+		}
+		fprintf(fgml, "<?xml version=\"1.0\"?>\n<eop:Mask>\n");
+		npoly = 1 + rand() % NPOLY_MAX;
+		for (ipoly = 0, n = 0; ipoly < npoly; ipoly++, n += nv) {
+			detid = 1 + rand() % NDETECTOR;
+			cx = s2detfoo.ulx + frand(0, s2detfoo.ncol * DETFOOPIXSZ);
+			cy = s2detfoo.uly - frand(0, s2detfoo.nrow * DETFOOPIXSZ);
+			nv = (int[]){3, 4, 7, 30, 2000}[rand() % 5];
+			for (i = 0; i < nv; i++) {
+				a = 2 * M_PI * i / nv;
+				r = frand(500, 8000);
+				x[n+i] = cx + r * cos(a);
+				y[n+i] = cy + r * sin(a);
+				if (rand() % 10 < 3) {	/* On a pixel center */
+					x[n+i] = s2detfoo.ulx + (floor((x[n+i] - s2detfoo.ulx) / DETFOOPIXSZ) + 0.5) * DETFOOPIXSZ;
+					y[n+i] = s2detfoo.uly - (floor((s2detfoo.uly - y[n+i]) / DETFOOPIXSZ) + 0.5) * DETFOOPIXSZ;
+				}
+				else if (rand() % 10 == 0) {
+					x[n+i] = floor(x[n+i]);
+					y[n+i] = floor(y[n+i]);
+				}
+			}
+
+			fprintf(fgml, "<eop:MaskFeature gml:id=\"detector_footprint-B06-%02d-0\">\n", detid);
+			for (i = 0; i < 5; i++)
+				fprintf(fgml, "<line%d/>\n", i);
+			fprintf(fgml, "<gml:posList srsDimension=\"3\">");
+			for (i = 0; i < nv; i++)	/* Break the long lists into lines */
+				fprintf(fgml, "%.17g %.17g 0%s", x[n+i], y[n+i], i % 20 == 19 ? "\n" : " ");
+			fprintf(fgml, "</gml:posList>\n</eop:MaskFeature>\n");
+
+			fill_polygon_baseline(&ref, x+n, y+n, nv, detid);
+		}
+		fprintf(fgml, "</eop:Mask>\n");
+		fclose(fgml);
+
+		if (rasterize_s2detfoo(&s2detfoo, fname_gml) != 0) {
+			Error("Error in rasterize_s2detfoo");
+			return(1);
+		}
+		for (k = 0; k < npix; k++) {
+			if (s2detfoo.detid[k] != ref.detid[k]) {
+				fprintf(stderr, "Test %d: detid differs at row %ld col %ld: %d, baseline %d\n", itest,
+						k / s2detfoo.ncol, k % s2detfoo.ncol, s2detfoo.detid[k], ref.detid[k]);
+				return(1);
+			}
+			nfilled += ref.detid[k] != DETIDFILL;
+		}
+	}
+
+	remove(fname_gml);
+	free(s2detfoo.detid);
+	free(ref.detid);
+	free(x);
+	free(y);
+
+	printf("check_detfoo: %d footprint images identical, %ld pixels filled\n", NTEST, nfilled);
+	return(0);
+}
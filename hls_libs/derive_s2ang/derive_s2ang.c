@@ -145,7 +145,9 @@ int main(int argc, char *argv[])
 		exit(1);
 
 
-	/* Make it hdfeos */
+	/* Make it hdfeos, unless it is a raw intermediate (see hls_raw.h) */
+	if (is_hls_raw(s2ang.fname))
+		return 0;
         if (strstr(mapinfo.zonehem, "S")) 
              	s2ang.uly -= 1e7;		// To GCTP (and HDF-EOS?) convention.
 	sds_info_t all_sds[NANG];
@@ -0,0 +1,391 @@
+/* Regression check for the native COG writer (hls_cog.h): write synthetic images of the
+ * three pixel types with write_hls_cog(), decode the files with a TIFF reader written
+ * here from the TIFF 6.0 and GeoTIFF specifications (zlib inflate and the undoing of the
+ * horizontal predictor), and compare:
+ *   - the full resolution with the image given, pixel for pixel, and the tile padding
+ *     with the fill value;
+ *   - each overview with the halving of the previous level done here: the rounded mean
+ *     of the non-fill pixels of a 2x2 box for average, or the upper-left pixel for
+ *     nearest;
+ *   - the tags: dimension, tiling, deflate, predictor, sample format, the COG layout (all
+ *     the IFDs first, then the tiles of the smallest overview first), the georeferencing
+ *     with the southern hemisphere in the GCTP convention, the nodata and the metadata.
+ * Exit status is 1 on any difference.
+ *
+ * Oct 17, 2026
+ */
+#include <math.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "hls_cog.h"
+#include "fillval.h"
+
+#define NLEVEL_MAX HLS_COG_MAXLEVEL
+
+/* One IFD of the file */
+typedef struct {
+	int subfile, ncol, nrow, bps, compression, predictor, sampleformat, tilew, tileh;
+	int ntile;
+	uint32_t *tileoffset;
+	uint32_t *tilesize;
+	double scale[3], tiepoint[6];
+	uint16_t geokey[20];
+	char *nodata, *metadata;
+	uint32_t ifdend;	/* The end of the IFD and its tag data */
+} tiff_ifd_t;
+
+static unsigned char *tiff;
+static long tiffsize;
+
+static uint32_t get16(uint32_t off) { return tiff[off] | tiff[off+1] << 8; }
+static uint32_t get32(uint32_t off) { return get16(off) | get16(off+2) << 16; }
+
+static double getdouble(uint32_t off)
+{
+	uint64_t u;
+	double d;
+
+	u = get32(off) | (uint64_t)get32(off+4) << 32;
+	memcpy(&d, &u, 8);
+	return(d);
+}
+
+static int read_tiff(char *fname)
+{
+	FILE *fp;
+
+	if ((fp = fopen(fname, "rb")) == NULL) {
+		fprintf(stderr, "Cannot read %s\n", fname);
+		return(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	tiffsize = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if ((tiff = (unsigned char*)malloc(tiffsize)) == NULL ||
+	    fread(tiff, 1, tiffsize, fp) != (size_t)tiffsize) {
+		fprintf(stderr, "Cannot read %s\n", fname);
+		return(1);
+	}
+	fclose(fp);
+	if (tiffsize < 8 || memcmp(tiff, "II*\0", 4) != 0) {
+		fprintf(stderr, "%s is not a little-endian classic TIFF\n", fname);
+		return(1);
+	}
+	return(0);
+}
+
+/* Parse the IFD at off; return the offset of the next one, or 0 */
+static uint32_t parse_ifd(uint32_t off, tiff_ifd_t *ifd)
+{
+	int ntag, i, k, size;
+	uint32_t e, tag, type, count, p, prevtag;
+
+	memset(ifd, 0, sizeof(tiff_ifd_t));
+	ntag = get16(off);
+	ifd->ifdend = off + 2 + 12 * ntag + 4;
+	prevtag = 0;
+	for (i = 0; i < ntag; i++) {
+		e = off + 2 + 12 * i;
+		tag = get16(e);
+		type = get16(e+2);
+		count = get32(e+4);
+		if (tag <= prevtag) {
+			fprintf(stderr, "The tags are not in ascending order: %u after %u\n", tag, prevtag);
+			exit(1);
+		}
+		prevtag = tag;
+		size = (type == 2 ? 1 : type == 3 ? 2 : type == 4 ? 4 : 8) * count;
+		p = (size <= 4) ? e + 8 : get32(e+8);
+		if (size > 4 && p + size > ifd->ifdend)
+			ifd->ifdend = p + size;
+
+		switch (tag) {
+			case 254: ifd->subfile = get32(p); break;
+			case 256: ifd->ncol = type == 3 ? get16(p) : get32(p); break;
+			case 257: ifd->nrow = type == 3 ? get16(p) : get32(p); break;
+			case 258: ifd->bps = get16(p); break;
+			case 259: ifd->compression = get16(p); break;
+			case 317: ifd->predictor = get16(p); break;
+			case 322: ifd->tilew = type == 3 ? get16(p) : get32(p); break;
+			case 323: ifd->tileh = type == 3 ? get16(p) : get32(p); break;
+			case 324:
+			case 325:
+				ifd->ntile = count;
+				if (tag == 324)
+					ifd->tileoffset = (uint32_t*)malloc(count * sizeof(uint32_t));
+				else
+					ifd->tilesize = (uint32_t*)malloc(count * sizeof(uint32_t));
+				for (k = 0; k < (int)count; k++) {
+					if (tag == 324)
+						ifd->tileoffset[k] = get32(p + 4*k);
+					else
+						ifd->tilesize[k] = get32(p + 4*k);
+				}
+				break;
+			case 339: ifd->sampleformat = get16(p); break;
+			case 33550: for (k = 0; k < 3; k++) ifd->scale[k] = getdouble(p + 8*k); break;
+			case 33922: for (k = 0; k < 6; k++) ifd->tiepoint[k] = getdouble(p + 8*k); break;
+			case 34735: for (k = 0; k < 20 && k < (int)count; k++) ifd->geokey[k] = get16(p + 2*k); break;
+			case 42112: ifd->metadata = (char*)tiff + p; break;
+			case 42113: ifd->nodata = (char*)tiff + p; break;
+		}
+	}
+	return get32(off + 2 + 12 * ntag);
+}
+
+static double pixval(void *buf, int type, long k)
+{
+	if (type == HLS_COG_UINT8)
+		return ((uint8*)buf)[k];
+	else if (type == HLS_COG_INT16)
+		return ((int16*)buf)[k];
+	else
+		return ((uint16*)buf)[k];
+}
+
+/* Inflate the tiles of an IFD, undo the predictor, and compare with img; the padding
+ * must be fill.
+ */
+static int compare_level(tiff_ifd_t *ifd, void *img, int type, double fillval, int il)
+{
+	int pixsz, ntilex, it, tx, ty, r, c;
+	uLongf rawsize;
+	unsigned char *raw;
+	double v, ref;
+
+	pixsz = (type == HLS_COG_UINT8) ? 1 : 2;
+	ntilex = (ifd->ncol + HLS_COG_TILESZ - 1) / HLS_COG_TILESZ;
+	if (ifd->ntile != ntilex * ((ifd->nrow + HLS_COG_TILESZ - 1) / HLS_COG_TILESZ)) {
+		fprintf(stderr, "Level %d: %d tiles\n", il, ifd->ntile);
+		return(1);
+	}
+	if ((raw = (unsigned char*)malloc((size_t)HLS_COG_TILESZ * HLS_COG_TILESZ * pixsz)) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+	for (it = 0; it < ifd->ntile; it++) {
+		rawsize = (uLongf)HLS_COG_TILESZ * HLS_COG_TILESZ * pixsz;
+		if (ifd->tileoffset[it] + ifd->tilesize[it] > tiffsize ||
+		    uncompress(raw, &rawsize, tiff + ifd->tileoffset[it], ifd->tilesize[it]) != Z_OK ||
+		    rawsize != (uLongf)HLS_COG_TILESZ * HLS_COG_TILESZ * pixsz) {
+			fprintf(stderr, "Level %d: cannot inflate tile %d\n", il, it);
+			return(1);
+		}
+		for (r = 0; r < HLS_COG_TILESZ; r++) {
+			for (c = 1; c < HLS_COG_TILESZ; c++) {
+				if (pixsz == 1)
+					raw[r * HLS_COG_TILESZ + c] += raw[r * HLS_COG_TILESZ + c - 1];
+				else
+					((uint16*)raw)[r * HLS_COG_TILESZ + c] += ((uint16*)raw)[r * HLS_COG_TILESZ + c - 1];
+			}
+		}
+
+		ty = it / ntilex;
+		tx = it % ntilex;
+		for (r = 0; r < HLS_COG_TILESZ; r++) {
+			for (c = 0; c < HLS_COG_TILESZ; c++) {
+				v = pixval(raw, type, (long)r * HLS_COG_TILESZ + c);
+				if (ty * HLS_COG_TILESZ + r < ifd->nrow && tx * HLS_COG_TILESZ + c < ifd->ncol)
+					ref = pixval(img, type, (long)(ty * HLS_COG_TILESZ + r) * ifd->ncol + tx * HLS_COG_TILESZ + c);
+				else
+					ref = fillval;
+				if (v != ref) {
+					fprintf(stderr, "Level %d: differs at tile %d row %d col %d: %g, expected %g\n",
+							il, it, r, c, v, ref);
+					return(1);
+				}
+			}
+		}
+	}
+	free(raw);
+	return(0);
+}
+
+/* Halve an image: the rounded mean of the non-fill pixels in a 2x2 box, or the
+ * upper-left pixel.
+ */
+static void *halve_baseline(void *in, int type, int nrow, int ncol, double fillval, int resampling)
+{
+	int orow, ocol, r, c, dr, dc, n;
+	double v, sum;
+	void *out;
+
+	orow = (nrow + 1) / 2;
+	ocol = (ncol + 1) / 2;
+	if ((out = malloc((size_t)orow * ocol * 2)) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+	for (r = 0; r < orow; r++) {
+		for (c = 0; c < ocol; c++) {
+			if (resampling == HLS_COG_NEAREST)
+				v = pixval(in, type, (long)2*r * ncol + 2*c);
+			else {
+				sum = 0;
+				n = 0;
+				for (dr = 0; dr < 2; dr++) {
+					for (dc = 0; dc < 2; dc++) {
+						if (2*r + dr >= nrow || 2*c + dc >= ncol)
+							continue;
+						v = pixval(in, type, (long)(2*r + dr) * ncol + 2*c + dc);
+						if (v != fillval) {
+							sum += v;
+							n++;
+						}
+					}
+				}
+				v = (n == 0) ? fillval : floor(sum / n + 0.5);
+			}
+			if (type == HLS_COG_UINT8)
+				((uint8*)out)[(long)r * ocol + c] = v;
+			else if (type == HLS_COG_INT16)
+				((int16*)out)[(long)r * ocol + c] = v;
+			else
+				((uint16*)out)[(long)r * ocol + c] = v;
+		}
+	}
+	return(out);
+}
+
+static int check_cog(char *fname, int type, int nrow, int ncol, double fillval, int resampling,
+		     char *zonehem, double uly, char *metadata)
+{
+	tiff_ifd_t ifd[NLEVEL_MAX];
+	void *img, *level, *next;
+	int nlevel, il, it, pixsz, lnrow, lncol, epsg;
+	long k, npix;
+	uint32_t off, ifdend;
+	double ulx = 600000, pixsz_m = 30, uly_tiff;
+	char nodata[50];
+
+	/* Random values, and fill in a block and at random */
+	pixsz = (type == HLS_COG_UINT8) ? 1 : 2;
+	npix = (long)nrow * ncol;
+	if ((img = malloc(npix * pixsz)) == NULL) {
+		Error("Cannot allocate memory");
+		exit(1);
+	}
+	for (k = 0; k < npix; k++) {
+		if ((k / ncol < nrow / 5 && k % ncol < ncol / 3) || rand() % 20 == 0) {
+			if (type == HLS_COG_UINT8) ((uint8*)img)[k] = fillval;
+			else if (type == HLS_COG_INT16) ((int16*)img)[k] = fillval;
+			else ((uint16*)img)[k] = fillval;
+		}
+		else if (type == HLS_COG_UINT8)
+			((uint8*)img)[k] = rand() % 255;
+		else if (type == HLS_COG_INT16)
+			((int16*)img)[k] = rand() % 16000 - 2000;
+		else
+			((uint16*)img)[k] = rand() % 36000;
+	}
+
+	if (write_hls_cog(fname, img, type, nrow, ncol, zonehem, ulx, uly, pixsz_m, fillval, resampling, metadata) != 0) {
+		Error("Error in write_hls_cog");
+		return(1);
+	}
+	if (read_tiff(fname) != 0)
+		return(1);
+
+	/* All the IFDs are at the start, before the tiles */
+	nlevel = 0;
+	ifdend = 8;
+	for (off = get32(4); off != 0; nlevel++) {
+		if (nlevel == NLEVEL_MAX || off != ifdend) {
+			fprintf(stderr, "%s: IFD %d is not right after the previous one\n", fname, nlevel);
+			return(1);
+		}
+		off = parse_ifd(off, &ifd[nlevel]);
+		ifdend = (ifd[nlevel].ifdend + 1) & ~1u;
+	}
+
+	/* The levels, each half the previous until it fits in a tile */
+	level = img;
+	lnrow = nrow;
+	lncol = ncol;
+	for (il = 0; il < nlevel; il++) {
+		if (ifd[il].ncol != lncol || ifd[il].nrow != lnrow || ifd[il].subfile != (il > 0) ||
+		    ifd[il].bps != 8 * pixsz || ifd[il].compression != 8 || ifd[il].predictor != 2 ||
+		    ifd[il].sampleformat != (type == HLS_COG_INT16 ? 2 : 1) ||
+		    ifd[il].tilew != HLS_COG_TILESZ || ifd[il].tileh != HLS_COG_TILESZ) {
+			fprintf(stderr, "%s: the tags of level %d are wrong\n", fname, il);
+			return(1);
+		}
+		for (it = 0; it < ifd[il].ntile; it++) {
+			if (ifd[il].tileoffset[it] < ifdend ||
+			    (il + 1 < nlevel && ifd[il].tileoffset[it] <= ifd[il+1].tileoffset[ifd[il+1].ntile-1])) {
+				fprintf(stderr, "%s: tile %d of level %d is out of the COG order\n", fname, it, il);
+				return(1);
+			}
+		}
+		if (compare_level(&ifd[il], level, type, fillval, il) != 0) {
+			fprintf(stderr, "%s: level %d differs\n", fname, il);
+			return(1);
+		}
+		if (lnrow <= HLS_COG_TILESZ && lncol <= HLS_COG_TILESZ)
+			break;
+		next = halve_baseline(level, type, lnrow, lncol, fillval, resampling);
+		if (level != img)
+			free(level);
+		level = next;
+		lnrow = (lnrow + 1) / 2;
+		lncol = (lncol + 1) / 2;
+	}
+	if (il != nlevel - 1) {
+		fprintf(stderr, "%s: %d levels\n", fname, nlevel);
+		return(1);
+	}
+
+	/* Georeferencing, nodata and metadata */
+	uly_tiff = (strchr(zonehem, 'S') != NULL && uly < 0) ? uly + 10000000 : uly;
+	epsg = (strchr(zonehem, 'S') != NULL ? 32700 : 32600) + atoi(zonehem);
+	sprintf(nodata, "%g", fillval);
+	if (ifd[0].scale[0] != pixsz_m || ifd[0].scale[1] != pixsz_m ||
+	    ifd[0].tiepoint[3] != ulx || ifd[0].tiepoint[4] != uly_tiff ||
+	    ifd[0].geokey[15] != epsg || ifd[0].geokey[12] != 3072 ||
+	    ifd[0].nodata == NULL || strcmp(ifd[0].nodata, nodata) != 0 ||
+	    (metadata == NULL) != (ifd[0].metadata == NULL) ||
+	    (metadata != NULL && strcmp(ifd[0].metadata, metadata) != 0)) {
+		fprintf(stderr, "%s: the georeferencing, nodata or metadata is wrong\n", fname);
+		return(1);
+	}
+
+	if (level != img)
+		free(level);
+	for (il = 0; il < nlevel; il++) {
+		free(ifd[il].tileoffset);
+		free(ifd[il].tilesize);
+	}
+	free(tiff);
+	free(img);
+	remove(fname);
+	return(0);
+}
+
+int main()
+{
+	char *metadata;
+
+	srand(1);
+	metadata = hls_cog_metadata(NULL, "Red & <NIR>", "0.0001", "0.0");
+
+	/* Partial tiles and three levels; the southern hemisphere in the GCTP convention */
+	if (check_cog("check_cog_int16.tif", HLS_COG_INT16, 1100, 1300, HLS_REFL_FILLVAL,
+			HLS_COG_AVERAGE, "10S", -100020, metadata) != 0)
+		return(1);
+	/* Fmask */
+	if (check_cog("check_cog_uint8.tif", HLS_COG_UINT8, 1030, 700, 255,
+			HLS_COG_NEAREST, "33N", 4000020, NULL) != 0)
+		return(1);
+	/* Angles, one row and column more than a tile */
+	if (check_cog("check_cog_uint16.tif", HLS_COG_UINT16, 513, 513, 40000,
+			HLS_COG_NEAREST, "33N", 4000020, metadata) != 0)
+		return(1);
+	/* A single tile, no overview */
+	if (check_cog("check_cog_small.tif", HLS_COG_INT16, 300, 200, HLS_REFL_FILLVAL,
+			HLS_COG_AVERAGE, "1N", 20, NULL) != 0)
+		return(1);
+	free(metadata);
+
+	printf("check_cog: full resolution, overviews and tags as expected\n");
+	return(0);
+}
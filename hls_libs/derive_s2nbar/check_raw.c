@@ -0,0 +1,347 @@
+/* Regression check for the raw intermediate container (hls_raw.h): write the same
+ * synthetic S10, S30 and angles to an HDF file and to a raw intermediate, change some
+ * rows in place, and read both back. Both must give the image and geolocation that were
+ * written, so the raw intermediate is a drop-in for the original HDF. Exit status is 1
+ * on any difference.
+ *
+ * The S10 is written a strip at a time and trimmed in place as in addFmaskSDS and s2trim,
+ * once as the AC output (CLOUD but no masks) and once with the masks. The S30 is changed
+ * in a plane loaded on demand as in derive_s2nbar. A change to a file opened DFACC_READ
+ * must not reach the file.
+ *
+ * Oct 17, 2026
+ */
+#include "s2r.h"
+#include "s2at30m.h"
+#include "s2ang.h"
+
+#define NROW10M 360		/* 60 rows at 60m, several strips */
+#define STRIP_MAXMEM 300000
+#define NROW30M 200
+#define NROWANG 150
+
+static int nrow_per60m[3] = {6, 3, 1};	/* Rows in a 60m row at 10m, 20m, 60m, as in s2r.c */
+
+static char *fname_s10[2] = {"check_raw_s10.hdf", "check_raw_s10" HLS_RAW_EXT};
+static char *fname_s30[2] = {"check_raw_s30.hdf", "check_raw_s30" HLS_RAW_EXT};
+static char *fname_ang[2] = {"check_raw_ang.hdf", "check_raw_ang" HLS_RAW_EXT};
+
+static char *cs_name = "WGS84 / UTM zone 33N";
+static double ulx = 399960, uly = 8000020;
+
+static void set_mapinfo(int32 sd_id)
+{
+	SDsetattr(sd_id, ULX, DFNT_FLOAT64, 1, (VOIDP)&ulx);
+	SDsetattr(sd_id, ULY, DFNT_FLOAT64, 1, (VOIDP)&uly);
+	SDsetattr(sd_id, HORIZONTAL_CS_NAME, DFNT_CHAR8, strlen(cs_name), (VOIDP)cs_name);
+}
+
+static int check_mapinfo(char *fname, double fulx, double fuly, char *zonehem)
+{
+	if (fulx != ulx || fuly != uly || strcmp(zonehem, "33N") != 0) {
+		fprintf(stderr, "%s: the geolocation differs: %f %f %s\n", fname, fulx, fuly, zonehem);
+		return(1);
+	}
+	return(0);
+}
+
+static int compare_plane(char *fname, char *what, void *buf, void *ref, size_t size)
+{
+	if (buf == NULL || memcmp(buf, ref, size) != 0) {
+		fprintf(stderr, "%s: %s differs\n", fname, what);
+		return(1);
+	}
+	return(0);
+}
+
+/* The file and its sidecar or ENVI header */
+static void remove_files(char *fname)
+{
+	char fname_other[500];
+
+	remove(fname);
+	sprintf(fname_other, "%s%s", fname, HLS_RAW_SIDECAR_EXT);
+	remove(fname_other);
+	sprintf(fname_other, "%s.hdr", fname);
+	remove(fname_other);
+}
+
+/* The 13 bands, then CLOUD, ACmask, Fmask, as in S2R_*_PLANE */
+static size_t s10_plane_size(int ip)
+{
+	int n;
+
+	if (ip >= S2NBAND)
+		return (size_t)NROW10M * NROW10M;
+	n = NROW10M / 6 * nrow_per60m[get_pixsz_index(ip)];
+	return (size_t)n * n * sizeof(int16);
+}
+
+static void *s10_buf(s2r_t *s2r, int ip)
+{
+	if (ip < S2NBAND)
+		return s2r->ref[ip];
+	if (ip == S2R_CLOUD_PLANE)
+		return s2r->accloud;
+	return ip == S2R_ACMASK_PLANE ? s2r->acmask : s2r->fmask;
+}
+
+/* ac_output: the S10 from LaSRC, with CLOUD but no masks yet */
+static int check_s10(int ac_output)
+{
+	s2r_t s2r;
+	char *ref[S2NBAND+3];
+	int ifile, ip, psi, row60, nrow, ncol, iread;
+	size_t k, off, rowsize;
+
+	for (ip = 0; ip < S2NBAND+3; ip++) {
+		ref[ip] = NULL;
+		if ((ip == S2R_CLOUD_PLANE) != ac_output && ip >= S2NBAND)
+			continue;
+		if ((ref[ip] = (char*)malloc(s10_plane_size(ip))) == NULL) {
+			Error("Cannot allocate memory");
+			exit(1);
+		}
+		for (k = 0; k < s10_plane_size(ip); k++)
+			ref[ip][k] = rand();
+	}
+
+	for (ifile = 0; ifile < 2; ifile++) {
+		/* Create, a strip at a time */
+		strcpy(s2r.fname, fname_s10[ifile]);
+		s2r.nrow[0] = s2r.ncol[0] = NROW10M;
+		s2r.ulx = ulx;
+		s2r.uly = uly;
+		strcpy(s2r.zonehem, "33N");
+		strcpy(s2r.ac_cloud_available, ac_output ? AC_CLOUD_AVAILABLE : "");
+		strcpy(s2r.mask_unavailable, ac_output ? MASK_UNAVAILABLE : "");
+		if (open_s2r_strip(&s2r, DFACC_CREATE, STRIP_MAXMEM) != 0) {
+			Error("Error in open_s2r_strip");
+			return(1);
+		}
+		set_mapinfo(s2r.sd_id);
+		for (row60 = 0; row60 < s2r.nrow[2]; row60 += s2r.strip_nrow60) {
+			read_s2r_strip(&s2r, row60);
+			for (ip = 0; ip < S2NBAND+3; ip++) {
+				if (ref[ip] == NULL)
+					continue;
+				psi = (ip < S2NBAND) ? get_pixsz_index(ip) : 0;
+				rowsize = s10_plane_size(ip) / s2r.nrow[psi];
+				off = (size_t)row60 * nrow_per60m[psi] * rowsize;
+				memcpy(s10_buf(&s2r, ip), ref[ip] + off, s2r.strip_len60 * nrow_per60m[psi] * rowsize);
+			}
+			if (write_s2r_strip(&s2r) != 0) {
+				Error("Error in write_s2r_strip");
+				return(1);
+			}
+		}
+		close_s2r(&s2r);
+
+		/* Change a few rows in place, as trim_s2edge() does */
+		if (open_s2r(&s2r, DFACC_WRITE) != 0) {
+			Error("Error in open_s2r");
+			return(1);
+		}
+		if ((s2r.dirty_row60 = (uint8*)calloc(s2r.nrow[2], 1)) == NULL) {
+			Error("Cannot allocate memory");
+			return(1);
+		}
+		for (row60 = 17; row60 < 21; row60++) {
+			s2r.dirty_row60[row60] = 1;
+			for (ip = 1; ip < S2NBAND+3; ip += 5) {
+				if (ref[ip] == NULL)
+					continue;
+				s2r.dirty_plane[ip] = 1;
+				psi = (ip < S2NBAND) ? get_pixsz_index(ip) : 0;
+				rowsize = s10_plane_size(ip) / s2r.nrow[psi];
+				off = (size_t)row60 * nrow_per60m[psi] * rowsize;
+				memset((char*)s10_buf(&s2r, ip) + off, 0x5a, nrow_per60m[psi] * rowsize);
+				if (ifile == 0)
+					memset(ref[ip] + off, 0x5a, nrow_per60m[psi] * rowsize);
+			}
+		}
+		close_s2r(&s2r);
+
+		/* Read back, and a change in memory only */
+		for (iread = 0; iread < 2; iread++) {
+			if (open_s2r(&s2r, DFACC_READ) != 0) {
+				Error("Error in open_s2r");
+				return(1);
+			}
+			if (check_mapinfo(s2r.fname, s2r.ulx, s2r.uly, s2r.zonehem) != 0)
+				return(1);
+			nrow = s2r.nrow[0];
+			ncol = s2r.ncol[0];
+			if (nrow != NROW10M || ncol != NROW10M) {
+				fprintf(stderr, "%s: the dimension differs: %d %d\n", s2r.fname, nrow, ncol);
+				return(1);
+			}
+			for (ip = 0; ip < S2NBAND+3; ip++) {
+				if (ref[ip] == NULL)
+					continue;
+				if (compare_plane(s2r.fname, ip < S2NBAND ? S2_SDS_NAME[ip] : "a mask",
+						s10_buf(&s2r, ip), ref[ip], s10_plane_size(ip)) != 0)
+					return(1);
+			}
+			s2r.ref[1][0]++;
+			close_s2r(&s2r);
+		}
+	}
+
+	for (ifile = 0; ifile < 2; ifile++)
+		remove_files(fname_s10[ifile]);
+	for (ip = 0; ip < S2NBAND+3; ip++)
+		free(ref[ip]);
+	return(0);
+}
+
+static void *s30_buf(s2at30m_t *s2at30m, int ip)
+{
+	if (ip < S2NBAND)
+		return s2at30m->ref[ip];
+	return ip == S30_ACMASK_PLANE ? s2at30m->acmask : s2at30m->fmask;
+}
+
+static int check_s30()
+{
+	s2at30m_t s30;
+	char *ref[S2NBAND+2];
+	uint8 planes[S2NBAND+2];
+	int ifile, ip, iread;
+	size_t k, size[S2NBAND+2], rowsize;
+
+	for (ip = 0; ip < S2NBAND+2; ip++) {
+		size[ip] = (size_t)NROW30M * NROW30M * (ip < S2NBAND ? sizeof(int16) : sizeof(uint8));
+		if ((ref[ip] = (char*)malloc(size[ip])) == NULL) {
+			Error("Cannot allocate memory");
+			exit(1);
+		}
+		for (k = 0; k < size[ip]; k++)
+			ref[ip][k] = rand();
+	}
+
+	for (ifile = 0; ifile < 2; ifile++) {
+		strcpy(s30.fname, fname_s30[ifile]);
+		s30.nrow = s30.ncol = NROW30M;
+		s30.ulx = ulx;
+		s30.uly = uly;
+		strcpy(s30.zonehem, "33N");
+		if (open_s2at30m(&s30, DFACC_CREATE) != 0) {
+			Error("Error in open_s2at30m");
+			return(1);
+		}
+		set_mapinfo(s30.sd_id);
+		for (ip = 0; ip < S2NBAND+2; ip++)
+			memcpy(s30_buf(&s30, ip), ref[ip], size[ip]);
+		close_s2at30m(&s30);
+
+		/* Change rows of a band opened and of Fmask loaded later, and track them */
+		memset(planes, 0, sizeof(planes));
+		planes[3] = 1;
+		if (open_s2at30m_subset(&s30, DFACC_WRITE, planes) != 0 ||
+		    load_s2at30m_plane(&s30, S30_FMASK_PLANE) != 0) {
+			Error("Error in open_s2at30m_subset");
+			return(1);
+		}
+		s30.track_dirty = 1;
+		for (ip = 3; ip < S2NBAND+2; ip += S30_FMASK_PLANE-3) {
+			rowsize = size[ip] / NROW30M;
+			memset((char*)s30_buf(&s30, ip) + 40 * rowsize, 0xa5, 7 * rowsize);
+			mark_s2at30m_dirty(&s30, ip, 40, 7);
+			if (ifile == 0)
+				memset(ref[ip] + 40 * rowsize, 0xa5, 7 * rowsize);
+		}
+		close_s2at30m(&s30);
+
+		for (iread = 0; iread < 2; iread++) {
+			if (open_s2at30m(&s30, DFACC_READ) != 0) {
+				Error("Error in open_s2at30m");
+				return(1);
+			}
+			if (check_mapinfo(s30.fname, s30.ulx, s30.uly, s30.zonehem) != 0)
+				return(1);
+			if (s30.nrow != NROW30M || s30.ncol != NROW30M) {
+				fprintf(stderr, "%s: the dimension differs: %d %d\n", s30.fname, s30.nrow, s30.ncol);
+				return(1);
+			}
+			for (ip = 0; ip < S2NBAND+2; ip++) {
+				if (compare_plane(s30.fname, ip < S2NBAND ? S2_SDS_NAME[ip] : "a mask",
+						s30_buf(&s30, ip), ref[ip], size[ip]) != 0)
+					return(1);
+			}
+			s30.fmask[0]++;
+			close_s2at30m(&s30);
+		}
+	}
+
+	for (ifile = 0; ifile < 2; ifile++)
+		remove_files(fname_s30[ifile]);
+	for (ip = 0; ip < S2NBAND+2; ip++)
+		free(ref[ip]);
+	return(0);
+}
+
+static int check_ang()
+{
+	s2ang_t s2ang;
+	uint16 *ref[NANG];
+	int ifile, ia;
+	long k, npix;
+
+	npix = (long)NROWANG * NROWANG;
+	for (ia = 0; ia < NANG; ia++) {
+		if ((ref[ia] = (uint16*)malloc(npix * sizeof(uint16))) == NULL) {
+			Error("Cannot allocate memory");
+			exit(1);
+		}
+		for (k = 0; k < npix; k++)
+			ref[ia][k] = (rand() % 10 == 0) ? ANGFILL : rand() % 36000;
+	}
+
+	for (ifile = 0; ifile < 2; ifile++) {
+		strcpy(s2ang.fname, fname_ang[ifile]);
+		s2ang.nrow = s2ang.ncol = NROWANG;
+		s2ang.ulx = ulx;
+		s2ang.uly = uly;
+		strcpy(s2ang.zonehem, "33N");
+		if (open_s2ang(&s2ang, DFACC_CREATE) != 0) {
+			Error("Error in open_s2ang");
+			return(1);
+		}
+		for (ia = 0; ia < NANG; ia++)
+			memcpy(s2ang.ang[ia], ref[ia], npix * sizeof(uint16));
+		close_s2ang(&s2ang);
+
+		if (open_s2ang(&s2ang, DFACC_READ) != 0) {
+			Error("Error in open_s2ang");
+			return(1);
+		}
+		if (check_mapinfo(s2ang.fname, s2ang.ulx, s2ang.uly, s2ang.zonehem) != 0)
+			return(1);
+		if (s2ang.nrow != NROWANG || s2ang.ncol != NROWANG) {
+			fprintf(stderr, "%s: the dimension differs: %d %d\n", s2ang.fname, s2ang.nrow, s2ang.ncol);
+			return(1);
+		}
+		for (ia = 0; ia < NANG; ia++) {
+			if (compare_plane(s2ang.fname, ANG_SDS_NAME[ia], s2ang.ang[ia], ref[ia], npix * sizeof(uint16)) != 0)
+				return(1);
+		}
+		close_s2ang(&s2ang);
+	}
+
+	for (ifile = 0; ifile < 2; ifile++)
+		remove_files(fname_ang[ifile]);
+	for (ia = 0; ia < NANG; ia++)
+		free(ref[ia]);
+	return(0);
+}
+
+int main()
+{
+	srand(1);
+	if (check_s10(1) != 0 || check_s10(0) != 0 || check_s30() != 0 || check_ang() != 0)
+		return(1);
+
+	printf("check_raw: S10, S30 and angles identical in HDF and raw\n");
+	return(0);
+}
@@ -0,0 +1,92 @@
+/* Regression check for the BRDF kernel lookup table: compare rtls_lut_kernel() with the
+ * analytic RossThick() and LiSparseR() on random angles quantized to 0.01 degree, as in
+ * s2ang_t, and check the error against the bound given in rtls.h. The angles cover the
+ * table and beyond, and the relative azimuth is given in (-360, 360). Also check that a
+ * table saved and loaded again is the same as the one built. Exit status is 1 on failure.
+ *
+ * Oct 17, 2026
+ */
+#include "rtls.h"
+#include "modis_brdf_coeff.h"
+
+#define NSAMPLE 2000000
+
+/* The bound in rtls.h */
+#define MAXERR_ROSSTHICK 1.0e-5
+#define MAXERR_LISPARSER 5.5e-4
+#define MAXERR_RATIO	 2.0e-4
+
+static double rand_angle(double lo, double hi)
+{
+	return floor((lo + (hi - lo) * rand() / RAND_MAX) * 100) / 100;
+}
+
+int main()
+{
+	char *fname_lut = "check_rtls_lut.bin";
+	rtls_lut_t lut, lut2;
+	double sz, vz, ra;
+	double rt, li, rt_lut, li_lut;
+	double nbarsz, rt_nbar, li_nbar;
+	double err_rt, err_li, err_ratio, e, ratio, ratio_lut;
+	long isample, nkernel;
+	int ic;
+
+	if (build_rtls_lut(&lut) != 0) {
+		fprintf(stderr, "Error in build_rtls_lut\n");
+		return(1);
+	}
+	if (save_rtls_lut(&lut, fname_lut) != 0 || load_rtls_lut(&lut2, fname_lut) != 0) {
+		fprintf(stderr, "Error in saving or loading the table\n");
+		return(1);
+	}
+	nkernel = 2L * lut.nsz * lut.nvz * lut.nra;
+	if (lut2.nsz != lut.nsz || lut2.nvz != lut.nvz || lut2.nra != lut.nra ||
+	    memcmp(lut2.kernel, lut.kernel, nkernel * sizeof(float)) != 0) {
+		fprintf(stderr, "The loaded table differs from the built one\n");
+		return(1);
+	}
+	free_rtls_lut(&lut2);
+	remove(fname_lut);
+
+	srand(1);
+	err_rt = err_li = err_ratio = 0;
+	for (isample = 0; isample < NSAMPLE; isample++) {
+		sz = rand_angle(0, RTLS_LUT_SZMAX + 5);
+		vz = rand_angle(0, RTLS_LUT_VZMAX + 2);
+		ra = rand_angle(-360, 360);
+		nbarsz = rand_angle(0, 70);
+
+		rt = RossThick(sz, vz, ra);
+		li = LiSparseR(sz, vz, ra);
+		rtls_lut_kernel(&lut, sz, vz, ra, &rt_lut, &li_lut);
+
+		if ((e = fabs(rt_lut - rt)) > err_rt)
+			err_rt = e;
+		if ((e = fabs(li_lut - li)) > err_li)
+			err_li = e;
+
+		/* The NBAR ratio as in nbar_s2at30m(); the kernels at the NBAR geometry are
+		 * always analytic. */
+		rt_nbar = RossThick(nbarsz, 0, 0);
+		li_nbar = LiSparseR(nbarsz, 0, 0);
+		for (ic = 0; ic < 9; ic++) {
+			ratio = (coeff[ic][0] + coeff[ic][1] * rt_nbar + coeff[ic][2] * li_nbar) /
+				(coeff[ic][0] + coeff[ic][1] * rt + coeff[ic][2] * li);
+			ratio_lut = (coeff[ic][0] + coeff[ic][1] * rt_nbar + coeff[ic][2] * li_nbar) /
+				(coeff[ic][0] + coeff[ic][1] * rt_lut + coeff[ic][2] * li_lut);
+			if ((e = fabs(ratio_lut / ratio - 1)) > err_ratio)
+				err_ratio = e;
+		}
+	}
+	free_rtls_lut(&lut);
+
+	printf("check_rtls_lut: max abs error RossThick %.2e, LiSparseR %.2e; max relative error "
+	       "of the NBAR ratio %.2e\n", err_rt, err_li, err_ratio);
+	if (err_rt > MAXERR_ROSSTHICK || err_li > MAXERR_LISPARSER || err_ratio > MAXERR_RATIO) {
+		fprintf(stderr, "The error is beyond the bound in rtls.h\n");
+		return(1);
+	}
+
+	return(0);
+}
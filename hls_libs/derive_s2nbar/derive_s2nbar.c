@@ -35,22 +35,11 @@
 #include "hls_commondef.h"
 #include "s2at30m.h"
 #include "s2ang.h"
-#include "modis_brdf_coeff.h"
-#include "rtls.h"
 #include "cfactor.h"
-#include "mean_solarzen.h"
+#include "s2nbar.h"
+#include "s2bandpass.h"
 #include "util.h"
-
-#define NBARSZ  "NBAR_SOLAR_ZENITH"
-int write_nbar_solarzenith(s2at30m_t *s2o, double nbarsz);
-
-/* The mean solar and view zenith/azimuth angles.
- * Not essential quantities, but a possible use of the mean sun angle is: For tiles with 
- * its centers above the orbit nadir, the mean solar zenith may be used in NBAR because
- * the desired normalized solar zenith based on Landsat and Sentinel-2 overpass time 
- * can't be derived.
- */
-int write_mean_angle(s2at30m_t *s2o, double msz, double msa, double mvz, double mva);
+#include "hls_hdfeos.h"
 
 int main(int argc, char *argv[])
 {
@@ -58,48 +47,104 @@ int main(int argc, char *argv[])
 	char fname_out[LINELEN];	/* an exact copy of input for update */
 	char fname_ang[LINELEN];
 	char fname_cfactor[LINELEN];	/* C-factor file, not archived */
+	char fname_lut[LINELEN];	/* Optional kernel lookup table cache */
+	char fname_para[LINELEN];	/* Optional bandpass adjustment parameters */
+	char cog_prefix[LINELEN];	/* Optional COG output of the S30 and the angles */
+	char angcog_prefix[LINELEN];
+	char fname_nbarout[LINELEN];	/* Optional NBAR-only output, for debugging */
 
 	s2ang_t s2ang;		/* 30-m angles */
 	s2at30m_t s2o;		/* output surface reflectance, after adjustment */
+	s2at30m_t s2nb;		/* NBAR without the bandpass adjustment; only with -nbarout */
 	cfactor_t cfactor;	/* BRDF ancillary; ratio for each band */
-
-	int ib, irow, icol, k; 
-
-	float sz, sa, vz, va, ra;
-
-	double nbarsz;	/* Mean solar zenith for a location*/
-	double rossthick_nbarsz, lisparseR_nbarsz;	/* kernels at nadir and the mean solar zenith */
-	double ratio;
-	double tmpref;
-	int utmzone;
-	double cenx, ceny, cenlon, cenlat;
-
-	/* The mean angles in band 0 as metadata */
-	double msz, msa, mvz, mva;
-	int n;
-	msz = msa = mvz = mva = 0;
-	n = 0;
-
+	rtls_lut_t lut;		/* Kernel lookup table */
+	nbar_kernel_opt_t opt;	/* Analytic kernels for each pixel if none of the options is given */
+	double para[NCB][2];	/* Bandpass slope and offset for 7 bands */
+	int bandpass;
 
 	int ret;
-
-	if (argc != 4) {
-		fprintf(stderr, "Usage: %s outsr.hdf ang.hdf cfactor.hdf \n", argv[0]);
+	int i;
+
+	/* Oct 17, 2026: Options to evaluate the kernels faster. See s2nbar.h.
+	 *   -lut file: Interpolate the kernels from a lookup table, which is loaded from 
+	 *   	the file, or made and saved in the file if it doesn't exist. 
+	 *   -lattice n: Compute the kernels every n 30m pixels and interpolate in between.
+	 *   -bandpass para.txt: Also do the bandpass adjustment of L8like in the same pass,
+	 *   	with a single rounding, and make the output hdfeos. L8like is then not needed.
+	 *   -cog prefix: Write the output as COG, prefix.B01.tif etc. (see hls_cog.h)
+	 *   -angcog prefix: Write the angles as COG, prefix.SZA.tif etc.
+	 *   -nbarout file: Also write the reflectance after NBAR and before the bandpass
+	 *   	adjustment to file, which is to be a copy of outsr.hdf before NBAR and is 
+	 *   	updated. The output of -bandpass is the same with or without it.
+	 */
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s outsr.hdf ang.hdf cfactor.hdf [-lut kernel_lut] [-lattice n] "
+				"[-bandpass bandpass_para.txt] [-cog prefix] [-angcog prefix] [-nbarout nbar.hdf]\n", argv[0]);
 		exit(1);
 	}
 
 	strcpy(fname_out,     argv[1]);
 	strcpy(fname_ang,     argv[2]);
 	strcpy(fname_cfactor, argv[3]);
+	opt.lut = NULL;
+	opt.lattice = 0;
+	bandpass = 0;
+	cog_prefix[0] = angcog_prefix[0] = fname_nbarout[0] = '\0';
+	for (i = 4; i < argc; i++) {
+		if (strcmp(argv[i], "-lut") == 0 && i+1 < argc) {
+			strcpy(fname_lut, argv[++i]);
+			if (get_rtls_lut(&lut, fname_lut) != 0) {
+				Error("Error in get_rtls_lut");
+				exit(1);
+			}
+			opt.lut = &lut;
+		}
+		else if (strcmp(argv[i], "-lattice") == 0 && i+1 < argc) {
+			opt.lattice = atoi(argv[++i]);
+			if (opt.lattice <= 0) {
+				fprintf(stderr, "Lattice spacing must be positive: %s\n", argv[i]);
+				exit(1);
+			}
+		}
+		else if (strcmp(argv[i], "-bandpass") == 0 && i+1 < argc) {
+			strcpy(fname_para, argv[++i]);
+			if (read_bandpass_para(fname_para, para) != 0)
+				exit(1);
+			bandpass = 1;
+		}
+		else if (strcmp(argv[i], "-cog") == 0 && i+1 < argc)
+			strcpy(cog_prefix, argv[++i]);
+		else if (strcmp(argv[i], "-angcog") == 0 && i+1 < argc)
+			strcpy(angcog_prefix, argv[++i]);
+		else if (strcmp(argv[i], "-nbarout") == 0 && i+1 < argc)
+			strcpy(fname_nbarout, argv[++i]);
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			exit(1);
+		}
+	}
 
-	/* Open output (a copy of input) for update */
+	/* Open output (a copy of input) for update. Oct 17, 2026: Only the bands with NBAR 
+	 * are read; B09, B10 and the masks are left alone on disk.
+	 */
+	uint8 planes[S2NBAND+2];
+	for (i = 0; i < S2NBAND+2; i++)
+		planes[i] = (i < S2NBAND && nbar_spec_index(i) != -1);
 	strcpy(s2o.fname, fname_out);
-	ret = open_s2at30m(&s2o, DFACC_WRITE);
+	ret = open_s2at30m_subset(&s2o, DFACC_WRITE, planes);
 	if (ret != 0) {
 		Error("Error in open_s2at30m");	
 		exit(1);
 	}
 
+	if (fname_nbarout[0] != '\0') {
+		strcpy(s2nb.fname, fname_nbarout);
+		if (open_s2at30m_subset(&s2nb, DFACC_WRITE, planes) != 0) {
+			Error("Error in open_s2at30m");	
+			exit(1);
+		}
+	}
+
 	/* Read angles */
 	strcpy(s2ang.fname, fname_ang);
 	ret = open_s2ang(&s2ang, DFACC_READ);
@@ -118,198 +163,55 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	/* Calculate the mean solar zenith and azimuth in case that the input granule is
-	 * a consolidated one from twin granules, the mean values will be different from
-	 * the L1C values of the twin granules. For the same reason, calculate the mean 
-	 * view zenith and azimuth.
-	 * These mean values angles are written out as metadata.
-	 *
-	 * May 15, 2020: For very high latitude, the calculated mean solar zenith
-	 * will also be used for NBAR since an "ideal" NBAR solar zenith can't be derived.
-	 */
-	ib = 0; 	/* coastal/aerosol band */
-	for (irow = 0; irow < s2o.nrow; irow++) {
-		for (icol = 0; icol < s2o.ncol; icol++) {
-			k = irow * s2o.ncol + icol;
-			if (s2o.ref[ib][k] == ref_fillval)
-				continue;
-
-			if (s2ang.ang[0][k] == ANGFILL || s2ang.ang[1][k] == ANGFILL ||
-			    s2ang.ang[2][k] == ANGFILL || s2ang.ang[3][k] == ANGFILL)
-				continue;
-
-			sz = s2ang.ang[0][k]/100.0;
-			sa = s2ang.ang[1][k]/100.0;
-			vz = s2ang.ang[2][k]/100.0;
-			va = s2ang.ang[3][k]/100.0;
-
-			n++;
-                        msz = msz + (sz-msz)/n;
-                        msa = msa + (sa-msa)/n;
-                        mvz = mvz + (vz-mvz)/n;
-                        mva = mva + (va-mva)/n;
-		}	
-	}
-
-	/*** Derive solar zenith used in BRDF adjustment. 
-	 *
-	 * Sentinel-2 nadir does not go higher than 81.38 deg and Landsat does not go 
-	 * higher than 81.8.
-	 * Compute the tile center latitude rather than reading from a file. 
-	 */
-	utmzone = atoi(s2o.zonehem);
-	cenx = s2o.ulx + (s2o.ncol/2.0 * HLS_PIXSZ),
-	ceny = s2o.uly - (s2o.nrow/2.0 * HLS_PIXSZ);
-	if (strstr(s2o.zonehem, "S") && ceny > 0)  /* Sentinel 2 */ 
-		ceny -= 1E7;		/* accommodate GCTP */
-	utm2lonlat(utmzone, cenx, ceny, &cenlon, &cenlat);
-
-	fprintf(stderr, "cenlat = %lf\n", cenlat);
-	if (cenlat > 81.3) 
-		nbarsz = msz;
-	else {
-		/* Example basename of filename: HLS.S30.T03VXH.2019202.v1.4.hdf 
-	 	 * 				 HLS.S30.T03VXH.2019202TXXXXXX.v1.4.hdf 
-		 */
-		char *cp;	
-		int yeardoy, year, doy;
-		cp = strrchr(s2o.fname, '/');	/* find basename */
-		if (cp == NULL)
-			cp = s2o.fname;
-		else
-			cp++;
-		/* Skip to yeardoy */
-		cp = strchr(cp, '.'); cp++;
-		cp = strchr(cp, '.'); cp++;
-		cp = strchr(cp, '.'); cp++;
-		yeardoy = atoi(cp);
-		year = yeardoy / 1000;
-		doy = yeardoy - year * 1000;
-
-		nbarsz = mean_solarzen(s2o.zonehem, cenx, ceny, year, doy);
-	}
-
 	/* Processing time */
 	char creationtime[50];
 	getcurrenttime(creationtime);
 	SDsetattr(s2o.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
+	if (fname_nbarout[0] != '\0')
+		SDsetattr(s2nb.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
 
-	/* Kernel values for NBAR solar zenith and nadir view */
-	rossthick_nbarsz = RossThick(nbarsz, 0, 0);
-	lisparseR_nbarsz = LiSparseR(nbarsz, 0, 0); 
-
-
-	int nbaridx = -1;	/* Sequence number of a band in bands with BRDF correction*/
-	int specidx;		/* Band index in the MODIS BRDF coefficient array */
-	for (ib = 0; ib < S2NBAND; ib++) {
-		switch (ib) {
-			/* Aug 5, 2019: with the added SDSU coefficients for the red edge bands. 
-			 * Landsat processing will skip these bands.
-			 * No correction on water vapor or cirrus bands */
-			case 0:  specidx =  0; break;
-			case 1:  specidx =  0; break;
-			case 2:  specidx =  1; break;
-			case 3:  specidx =  2; break;
-			case 4:  specidx =  3; break;
-			case 5:  specidx =  4; break;
-			case 6:  specidx =  5; break;
-			case 7:  specidx =  6; break;
-			case 8:  specidx =  6; break;
-			case 9:  specidx = -1; break;
-			case 10: specidx = -1; break;
-			case 11: specidx =  7; break;
-			case 12: specidx =  8; break;
-		}
-		if (specidx == -1)
-			continue;
-
-		nbaridx++;
-
-		/* NBAR */
-		for (irow = 0; irow < s2o.nrow; irow++) {
-			for (icol = 0; icol < s2o.ncol; icol++) {
-				k = irow * s2o.ncol + icol;
-				if (s2o.ref[ib][k] == ref_fillval)
-					continue;
-
-				/* Bug fix, Sep 6, 2016. Angles for certain bands are not available for some grnaules
-				 * due to mistakes in the ESA XML.
-				 * Sep 10, 2016: a substitute band may not be able to find.
-				 *
-				 *  ang[0] is solar zenith, 1 is solar azimuth, 2 is view zenith, 3 is view azimuth
-				 */
-
-				if (s2ang.ang[0][k] == ANGFILL || s2ang.ang[1][k] == ANGFILL ||
-				    s2ang.ang[2][k] == ANGFILL || s2ang.ang[3][k] == ANGFILL)
-					continue;
-
-				sz = s2ang.ang[0][k]/100.0;
-				sa = s2ang.ang[1][k]/100.0;
-				vz = s2ang.ang[2][k]/100.0;
-				va = s2ang.ang[3][k]/100.0;
-				ra = va - sa;
-
-				ratio = (coeff[specidx][0] + coeff[specidx][1] * rossthick_nbarsz + coeff[specidx][2] * lisparseR_nbarsz) / 
-					(coeff[specidx][0] + coeff[specidx][1] * RossThick(sz, vz, ra) + coeff[specidx][2] * LiSparseR(sz, vz, ra));
-				tmpref = s2o.ref[ib][k] * ratio;
-				s2o.ref[ib][k] = asInt16(tmpref);
-
-				cfactor.ratio[nbaridx][k] = ratio;
-			}
-		}
+	/* NBAR, and the NBAR solar zenith and the mean angles as metadata. With -bandpass,
+	 * also the bandpass adjustment and its slope and offset as metadata.
+	 */
+	ret = nbar_s2at30m(&s2o, &s2ang, &opt, &cfactor, bandpass ? para : NULL, 
+			   fname_nbarout[0] != '\0' ? &s2nb : NULL);
+	if (ret != 0) {
+		Error("Error in nbar_s2at30m");
+		exit(1);
 	}
 
-	write_nbar_solarzenith(&s2o, nbarsz);
-	write_mean_angle(&s2o, msz, msa, mvz, mva);
-
+	if (angcog_prefix[0] != '\0' && write_s2ang_cog(&s2ang, angcog_prefix) != 0) {
+		Error("Error in write_s2ang_cog");
+		exit(1);
+	}
 	close_s2ang(&s2ang);
-	close_s2at30m(&s2o);
-	close_cfactor(&cfactor);
-
-	return 0;
-}
-
-int write_nbar_solarzenith(s2at30m_t *s2o, double nbarsz)
-{
-	int ret;
-	ret = SDsetattr(s2o->sd_id, NBARSZ, DFNT_FLOAT64, 1, (VOIDP)&nbarsz);
-	if (ret != 0) {
-                Error("Error in SDsetattr");
-                exit(-1);
-        }
-
-        return(0);
-}
 
-int write_mean_angle(s2at30m_t *s2o, double msz, double msa, double mvz, double mva)
-{
-	int ret; 
-	/* MSZ */
-	ret = SDsetattr(s2o->sd_id, MSZ, DFNT_FLOAT64, 1, (VOIDP)&msz);
-	if (ret != 0) {
-		Error("Error in SDsetattr");
-		exit(-1);
+	if (cog_prefix[0] != '\0' && write_s2at30m_cog(&s2o, cog_prefix, NULL) != 0) {
+		Error("Error in write_s2at30m_cog");
+		exit(1);
 	}
-
-	/* MSA */
-	ret = SDsetattr(s2o->sd_id, MSA, DFNT_FLOAT64, 1, (VOIDP)&msa);
-	if (ret != 0) {
-		Error("Error in SDsetattr");
-		exit(-1);
+	if (close_s2at30m(&s2o) != 0) {
+		Error("Error in close_s2at30m");
+		exit(1);
 	}
-
-	/* MVZ */
-	ret = SDsetattr(s2o->sd_id, MVZ, DFNT_FLOAT64, 1, (VOIDP)&mvz);
-	if (ret != 0) {
-		Error("Error in SDsetattr");
-		exit(-1);
+	if (fname_nbarout[0] != '\0' && close_s2at30m(&s2nb) != 0) {
+		Error("Error in close_s2at30m");
+		exit(1);
 	}
-	/* MVA */
-	ret = SDsetattr(s2o->sd_id, MVA, DFNT_FLOAT64, 1, (VOIDP)&mva);
-	if (ret != 0) {
-		Error("Error in SDsetattr");
-		exit(-1);
+	close_cfactor(&cfactor);
+	if (opt.lut != NULL)
+		free_rtls_lut(opt.lut);
+
+	/* Make it hdfeos, as L8like does, unless it is a raw intermediate */
+	if (bandpass && !is_hls_raw(s2o.fname)) {
+		sds_info_t all_sds[S2NBAND+2];	/* +2 masks */
+		set_S30_sds_info(all_sds, S2NBAND+2, &s2o);
+		ret = S30_PutSpaceDefHDF(s2o.fname, all_sds, S2NBAND+2);
+		if (ret != 0) {
+			Error("Error in S30_PutSpaceDefHDF");
+			exit(1);
+		}
 	}
 
-	return(0);
+	return 0;
 }
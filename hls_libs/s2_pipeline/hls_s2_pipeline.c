@@ -0,0 +1,359 @@
+/********************************************************************************
+ * Process a single S2 granule from the LaSRC output to the final S30 in one
+ * process. The stages are the same as in the chain of separate executables
+ *
+ *   twohdf2one -> addFmaskSDS -> s2trim -> create_s2at30m -> derive_s2nbar -> L8like
+ *
+ * but the S10 and S30 are passed between the stages in memory, instead of each
+ * stage writing a deflated HDF file for the next stage to read back. Only the
+ * final S30 is written, unless -debug debug_dir sr.hdf is given, in which case
+ * the intermediate products are also saved where the chain of executables in
+ * sentinel.sh leaves them:
+ *	sr.hdf					S10, as from s2trim, in the granule directory
+ *	debug_dir/resample30m.hdf		S30 before NBAR, as from create_s2at30m
+ *	debug_dir/nbarIntermediate.hdf		S30 after NBAR, before bandpass adjustment
+ *	debug_dir/cfactor.hdf			NBAR c-factor
+ *
+ * The angle file is made by derive_s2ang as before.
+ *
+ * With -cog prefix, the final S30 and the angles are also written as COG,
+ * prefix.B01.tif ... prefix.Fmask.tif and prefix.SZA.tif ... prefix.VAA.tif,
+ * from memory (see hls_cog.h); in debug mode also debug_dir/quicklook.jpg, the RGB
+ * quicklook from their overviews (see hls_quicklook.h).
+ *
+ * Twin granules still go through the separate executables because consolidate
+ * needs the S10 of both granules.
+ *
+ * part1 and part2 can be the two LaSRC hdf files, or the two ESPA XML that 
+ * describe the raw binary bands (see s2combine.c).
+ *
+ * Note that NBAR takes the year and day of year from the output filename,
+ * e.g. HLS.S30.T03VXH.2019202T222559.v2.0.hdf  (See derive_s2nbar.c)
+ *
+ * Oct 17, 2026
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "hls_projection.h"
+#include "s2r.h"
+#include "s2at30m.h"
+#include "s2ang.h"
+#include "cfactor.h"
+#include "s2combine.h"
+#include "s2addmask.h"
+#include "s2trimedge.h"
+#include "s2nbar.h"
+#include "s2bandpass.h"
+#include "util.h"
+#include "hls_hdfeos.h"
+
+/* Save a copy of the S30 at its current stage of processing, for debugging */
+int save_s2at30m_copy(s2at30m_t *s2o, s2r_t *s2r, char *fname);
+
+int main(int argc, char *argv[])
+{
+	/* Command-line parameters */
+	char fname_part1[LINELEN];	/* The two LaSRC output, hdf or ESPA xml */
+	char fname_part2[LINELEN];
+	char fname_safexml[LINELEN];  	/* XML for the overall SAFE */
+	char fname_granulexml[LINELEN];
+	char accodename[100];		/* Atmospheric correction code name */
+	char fname_fmask[LINELEN];	/* fmask result in flat binary */
+	char fname_aeroQA[LINELEN];	/* Aerosol QA byte from USGS LaSRC */
+	char fname_ang[LINELEN];	/* From derive_s2ang */
+	char fname_para[LINELEN];	/* Bandpass adjustment parameters */
+	char fname_out[LINELEN];	/* Final S30 */
+	char debug_dir[LINELEN];	/* Optional; save intermediate products if given */
+	char fname_debug_s10[LINELEN];	/* The S10 saved in debug mode */
+	char cog_prefix[LINELEN];	/* Optional; write the S30 and angles as COG if given */
+
+	s2r_t s2in;		/* LaSRC output, all bands at 10m */
+	s2r_t s2r;		/* S10 */
+	s2at30m_t s2o;		/* S30 */
+	s2at30m_t s2nb;		/* Copy of the S30 for the NBAR intermediate; only in debug mode */
+	s2ang_t s2ang;		/* 30-m angles */
+	cfactor_t cfactor;	/* BRDF ancillary; only saved in debug mode */
+	double para[NCB][2];	/* slope and offset for 7 bands */
+
+	char creationtime[50];
+	char fname_tmp[LINELEN];
+	char message[MSGLEN];
+	int debug;
+	int ret, i;
+
+	if (argc < 11) {
+		fprintf(stderr, "Usage: %s part1 part2 safexml granulexml accodename fmask aeroQA ang.hdf "
+				"bandpass_para.txt out.hdf [-cog prefix] [-debug debug_dir sr.hdf]\n", argv[0]);
+		exit(1);
+	}
+
+	strcpy(fname_part1,      argv[1]);
+	strcpy(fname_part2,      argv[2]);
+	strcpy(fname_safexml,    argv[3]);
+	strcpy(fname_granulexml, argv[4]);
+	strcpy(accodename,       argv[5]);
+	strcpy(fname_fmask,      argv[6]);
+	strcpy(fname_aeroQA,     argv[7]);
+	strcpy(fname_ang,        argv[8]);
+	strcpy(fname_para,       argv[9]);
+	strcpy(fname_out,        argv[10]);
+	debug = 0;
+	cog_prefix[0] = '\0';
+	for (i = 11; i < argc; i++) {
+		if (strcmp(argv[i], "-cog") == 0 && i+1 < argc)
+			strcpy(cog_prefix, argv[++i]);
+		else if (strcmp(argv[i], "-debug") == 0 && i+2 < argc) {
+			strcpy(debug_dir, argv[++i]);
+			strcpy(fname_debug_s10, argv[++i]);
+			debug = 1;
+		}
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	/* Check the bandpass parameter early, before the heavy lifting */
+	if (read_bandpass_para(fname_para, para) != 0)
+		exit(1);
+
+
+	/*********** twohdf2one: Read the two LaSRC output and map info */
+	ret = read_twohdf(&s2in, fname_part1, fname_part2, fname_granulexml);
+	if (ret != 0) {
+		Error("Error in reading two hdf");
+		exit(1);
+	}
+
+	/* The S10. Only held in memory unless in debug mode. It has ACmask and Fmask,
+	 * but no CLOUD SDS; ACmask is derived from the CLOUD SDS of s2in directly.
+	 */
+	if (debug)
+		strcpy(s2r.fname, fname_debug_s10);
+	else
+		strcpy(s2r.fname, fname_out);
+	s2r.nrow[0] = s2in.nrow[0];
+	s2r.ncol[0] = s2in.ncol[0];
+	s2r.ulx = s2in.ulx;
+	s2r.uly = s2in.uly;
+	strcpy(s2r.zonehem, s2in.zonehem);
+	s2r.ac_cloud_available[0] = '\0';
+	s2r.mask_unavailable[0] = '\0';
+	ret = open_s2r(&s2r, debug ? DFACC_CREATE : HLS_ACC_MEMORY);
+	if (ret != 0) {
+		Error("Error in open_s2r");
+		exit(1);
+	}
+
+	/* Get some metadata from the two XML; written to the file in debug mode */
+	if (setinputmeta(&s2r, fname_safexml, fname_granulexml, accodename) != 0) {
+		Error("Error in setinputmeta");
+		exit(1);
+	}
+
+	ret = combine_twohdf(&s2in, fname_part1, fname_part2, &s2r);
+	if (ret != 0) {
+		Error("Error in combine_twohdf");
+		exit(1);
+	}
+
+	/*********** addFmaskSDS */
+	ret = add_s2mask(&s2in, fname_fmask, fname_aeroQA, &s2r);
+	if (ret != 0) {
+		Error("Error in add_s2mask");
+		exit(1);
+	}
+	close_s2r(&s2in);	/* Free the 10m input as soon as possible */
+
+	/*********** s2trim */
+	trim_s2edge(&s2r);
+
+	getcurrenttime(creationtime);
+	if (s2r.sd_id != FAIL)
+		SDsetattr(s2r.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
+
+	/* spatial and cloud. Cloud coverage relies on QA SDS */
+	setcoverage(&s2r);
+
+
+	/*********** create_s2at30m */
+	strcpy(s2o.fname, fname_out);
+	strcpy(s2o.zonehem, s2r.zonehem);
+	s2o.ulx = s2r.ulx;
+	s2o.uly = s2r.uly;
+	s2o.nrow = s2r.nrow[0]/3;
+	s2o.ncol = s2r.ncol[0]/3;
+	ret = open_s2at30m(&s2o, DFACC_CREATE);
+	if (ret != 0) {
+		Error("Error in open_s2at30m");
+		exit(1);
+	}
+
+	ret = resample_s2to30m(&s2r, &s2o);
+	if (ret != 0) {
+		Error("Error in resample_s2to30m");
+		exit(1);
+	}
+
+	/* The metadata have been kept in s2r; no need to read back with get_all_metadata() */
+	ret = set_s2at30m_metadata(&s2r, &s2o);
+	if (ret != 0) {
+		Error("Error in set_s2at30m_metadata");
+		exit(1);
+	}
+
+	/* In the chain of executables, opening the S30 for update in derive_s2nbar
+	 * rewrites ULX and ULY to the GCTP convention for the southern hemisphere.
+	 * See open_s2at30m(). Do the same here.
+	 */
+	if (strstr(s2o.zonehem, "S") && s2r.ululy > 0) {
+		SDsetattr(s2o.sd_id, ULX, DFNT_FLOAT64, 1, (VOIDP)&(s2o.ulx));
+		SDsetattr(s2o.sd_id, ULY, DFNT_FLOAT64, 1, (VOIDP)&(s2o.uly));
+	}
+
+	/* Done with the S10. Written out in debug mode. */
+	if (close_s2r(&s2r) != 0) {
+		Error("Error in closing S10");
+		exit(1);
+	}
+	if (debug) {
+		sds_info_t all_sds[S2NBAND+2];
+		set_S10_sds_info(all_sds, S2NBAND+2, &s2r);
+		ret = S10_PutSpaceDefHDF(s2r.fname, all_sds, S2NBAND+2);
+		if (ret != 0) {
+			Error("Error in S10_PutSpaceDefHDF");
+			exit(1);
+		}
+
+		sprintf(fname_tmp, "%s/resample30m.hdf", debug_dir);
+		if (save_s2at30m_copy(&s2o, &s2r, fname_tmp) != 0)
+			exit(1);
+
+		/* The S30 before NBAR, into which the fused pass writes the NBAR-only values */
+		sprintf(s2nb.fname, "%s/nbarIntermediate.hdf", debug_dir);
+		strcpy(s2nb.zonehem, s2o.zonehem);
+		s2nb.ulx = s2o.ulx;
+		s2nb.uly = s2o.uly;
+		s2nb.nrow = s2o.nrow;
+		s2nb.ncol = s2o.ncol;
+		if (open_s2at30m(&s2nb, DFACC_CREATE) != 0) {
+			Error("Error in open_s2at30m");
+			exit(1);
+		}
+		dup_s2at30m(&s2o, &s2nb);
+		if (set_s2at30m_metadata(&s2r, &s2nb) != 0) {
+			Error("Error in set_s2at30m_metadata");
+			exit(1);
+		}
+	}
+
+
+	/*********** derive_s2nbar */
+	strcpy(s2ang.fname, fname_ang);
+	ret = open_s2ang(&s2ang, DFACC_READ);
+	if (ret != 0) {
+		Error("Error in open_s2ang");
+		exit(1);
+	}
+	if (s2ang.nrow != s2o.nrow || s2ang.ncol != s2o.ncol) {
+		sprintf(message, "Angle dimension differs from S30: %s", fname_ang);
+		Error(message);
+		exit(1);
+	}
+
+	if (debug) {
+		sprintf(cfactor.fname, "%s/cfactor.hdf", debug_dir);
+		cfactor.nrow = s2o.nrow;
+		cfactor.ncol = s2o.ncol;
+		ret = open_cfactor(SENTINEL2, &cfactor, DFACC_CREATE);
+		if (ret != 0) {
+			Error("Error in open_cfactor");
+			exit(1);
+		}
+	}
+
+	/* Oct 17, 2026: NBAR and the bandpass adjustment are done in one pass with a single
+	 * rounding, also in debug mode, where the S30 between them is written to s2nb.
+	 */
+	ret = nbar_s2at30m(&s2o, &s2ang, NULL, debug ? &cfactor : NULL, para, debug ? &s2nb : NULL);
+	if (ret != 0) {
+		Error("Error in nbar_s2at30m");
+		exit(1);
+	}
+	if (cog_prefix[0] != '\0' && write_s2ang_cog(&s2ang, cog_prefix) != 0) {
+		Error("Error in write_s2ang_cog");
+		exit(1);
+	}
+	close_s2ang(&s2ang);
+
+	if (debug) {
+		getcurrenttime(creationtime);
+		SDsetattr(s2nb.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
+		if (close_s2at30m(&s2nb) != 0) {
+			Error("Error in close_s2at30m");
+			exit(1);
+		}
+		close_cfactor(&cfactor);
+	}
+
+
+	/*********** L8like */
+	getcurrenttime(creationtime);
+	SDsetattr(s2o.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
+
+	/* In debug mode, also the quicklook from the COG overviews, for comparison with the
+	 * thumbnail from create_thumbnail */
+	if (debug)
+		sprintf(fname_tmp, "%s/quicklook.jpg", debug_dir);
+	if (cog_prefix[0] != '\0' && write_s2at30m_cog(&s2o, cog_prefix, debug ? fname_tmp : NULL) != 0) {
+		Error("Error in write_s2at30m_cog");
+		exit(1);
+	}
+	if (close_s2at30m(&s2o) != 0) {
+		Error("Error in close_s2at30m");
+		exit(1);
+	}
+
+	/* Make it hdfeos */
+	sds_info_t all_sds[S2NBAND+2];	/* +2 masks */
+	set_S30_sds_info(all_sds, S2NBAND+2, &s2o);
+	ret = S30_PutSpaceDefHDF(s2o.fname, all_sds, S2NBAND+2);
+	if (ret != 0) {
+		Error("Error in S30_PutSpaceDefHDF");
+		exit(1);
+	}
+
+	return 0;
+}
+
+int save_s2at30m_copy(s2at30m_t *s2o, s2r_t *s2r, char *fname)
+{
+	s2at30m_t s2cp;
+	char creationtime[50];
+	int ret;
+
+	strcpy(s2cp.fname, fname);
+	strcpy(s2cp.zonehem, s2o->zonehem);
+	s2cp.ulx = s2o->ulx;
+	s2cp.uly = s2o->uly;
+	s2cp.nrow = s2o->nrow;
+	s2cp.ncol = s2o->ncol;
+	ret = open_s2at30m(&s2cp, DFACC_CREATE);
+	if (ret != 0) {
+		Error("Error in open_s2at30m");
+		return(ret);
+	}
+
+	dup_s2at30m(s2o, &s2cp);
+	ret = set_s2at30m_metadata(s2r, &s2cp);
+	if (ret != 0)
+		return(ret);
+
+	getcurrenttime(creationtime);
+	SDsetattr(s2cp.sd_id, HLSTIME, DFNT_CHAR8, strlen(creationtime), (VOIDP)creationtime);
+
+	return close_s2at30m(&s2cp);
+}
@@ -0,0 +1,154 @@
+/* Regression check for combine_twohdf(): write synthetic LaSRC bands as ESPA raw binary
+ * with the two XML, combine them, and compare with the original aggregation, which
+ * summed each box in double and applied the USGS scale and offset in floating point.
+ * The output must be identical. Exit status is 1 on any difference.
+ *
+ * The image spans more than one row strip. One 10m band holds every possible uint16
+ * value, so the integer scaling is checked exhaustively for single pixels; the other
+ * bands are random, with some 0 (nodata) pixels.
+ *
+ * Oct 17, 2026
+ */
+#include "s2combine.h"
+
+#define NROW10M 780		/* Two full row strips and a part */
+
+static char *fname_xml[2] = {"check_combine_1.xml", "check_combine_2.xml"};
+
+/* The original aggregation of one band to a box of boxsize by boxsize 10m pixels */
+static void combine_band_baseline(uint16 *in, int nrow10m, int ncol10m, int boxsize, int16 *out)
+{
+	int irow, icol, ir, ic, n;
+	double sum;
+
+	for (irow = 0; irow < nrow10m/boxsize; irow++) {
+		for (icol = 0; icol < ncol10m/boxsize; icol++) {
+			sum = 0.0;
+			n = 0;
+			for (ir = irow*boxsize; ir < (irow+1)*boxsize; ir++) {
+				for (ic = icol*boxsize; ic < (icol+1)*boxsize; ic++) {
+					if (in[(long)ir * ncol10m + ic] > 0) {
+						sum += in[(long)ir * ncol10m + ic];
+						n++;
+					}
+				}
+			}
+			if (n == boxsize * boxsize) {
+				sum = (sum * 0.0000275/n - 0.2) * 10000;
+				out[(long)irow * (ncol10m/boxsize) + icol] = asInt16(sum);
+			}
+		}
+	}
+}
+
+/* Write the bands as .img files and list them in the two ESPA XML. Bands 8A to 12 are
+ * in the second file.
+ */
+static int write_espa(uint16 **band, int nrow, int ncol)
+{
+	FILE *fxml[2], *fimg;
+	char fname_img[100];
+	int ib, ifile;
+
+	for (ifile = 0; ifile < 2; ifile++) {
+		if ((fxml[ifile] = fopen(fname_xml[ifile], "w")) == NULL) {
+			Error("Cannot create the xml file");
+			return(1);
+		}
+		fprintf(fxml[ifile], "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<espa_metadata version=\"2.0\">\n<bands>\n");
+	}
+	for (ib = 0; ib < S2NBAND; ib++) {
+		ifile = ib < 8 ? 0 : 1;
+		sprintf(fname_img, "check_combine_band%d.img", ib);
+		if ((fimg = fopen(fname_img, "wb")) == NULL ||
+		    fwrite(band[ib], sizeof(uint16), (long)nrow * ncol, fimg) != (size_t)nrow * ncol) {
+			Error("Cannot write the img file");
+			return(1);
+		}
+		fclose(fimg);
+		fprintf(fxml[ifile], "<band product=\"sr_refl\" source=\"toa_refl\" name=\"%s\" category=\"image\" "
+			"data_type=\"UINT16\" nlines=\"%d\" nsamps=\"%d\" fill_value=\"0\">\n"
+			"<short_name>S2ASR</short_name>\n<file_name>%s</file_name>\n</band>\n",
+			VermoteS2sdsname[ib], nrow, ncol, fname_img);
+	}
+	for (ifile = 0; ifile < 2; ifile++) {
+		fprintf(fxml[ifile], "</bands>\n</espa_metadata>\n");
+		fclose(fxml[ifile]);
+	}
+
+	return(0);
+}
+
+int main()
+{
+	int boxsize_of_band[S2NBAND] = {6, 1, 1, 1, 2, 2, 2, 1, 2, 6, 6, 2, 2};
+	uint16 *band[S2NBAND];
+	int16 *ref;
+	s2r_t s2in, s2out;
+	int ib, ret;
+	long k, npix10m, npix;
+	char fname_img[100];
+
+	memset(&s2in, 0, sizeof(s2r_t));
+	memset(&s2out, 0, sizeof(s2r_t));
+	s2in.nrow[0] = s2in.ncol[0] = NROW10M;
+	npix10m = (long)NROW10M * NROW10M;
+
+	srand(1);
+	for (ib = 0; ib < S2NBAND; ib++) {
+		npix = npix10m / (boxsize_of_band[ib] * boxsize_of_band[ib]);
+		band[ib] = (uint16*)malloc(npix10m * sizeof(uint16));
+		s2out.ref[ib] = (int16*)malloc(npix * sizeof(int16));
+		if (band[ib] == NULL || s2out.ref[ib] == NULL) {
+			Error("Cannot allocate memory");
+			return(1);
+		}
+		for (k = 0; k < npix10m; k++) {
+			if (ib == 1)
+				band[ib][k] = k % 65536;	/* Every value, 0 included */
+			else if (rand() % 100 == 0)
+				band[ib][k] = 0;
+			else if (rand() % 2 == 0)
+				band[ib][k] = 7000 + rand() % 6000;	/* Typical reflectance */
+			else
+				band[ib][k] = 1 + rand() % 65535;
+		}
+		for (k = 0; k < npix; k++)
+			s2out.ref[ib][k] = HLS_S2_FILLVAL;
+	}
+	if (write_espa(band, NROW10M, NROW10M) != 0)
+		return(1);
+
+	if ((ret = combine_twohdf(&s2in, fname_xml[0], fname_xml[1], &s2out)) != 0) {
+		Error("Error in combine_twohdf");
+		return(1);
+	}
+
+	for (ib = 0; ib < S2NBAND; ib++) {
+		npix = npix10m / (boxsize_of_band[ib] * boxsize_of_band[ib]);
+		if ((ref = (int16*)malloc(npix * sizeof(int16))) == NULL) {
+			Error("Cannot allocate memory");
+			return(1);
+		}
+		for (k = 0; k < npix; k++)
+			ref[k] = HLS_S2_FILLVAL;
+		combine_band_baseline(band[ib], NROW10M, NROW10M, boxsize_of_band[ib], ref);
+		for (k = 0; k < npix; k++) {
+			if (s2out.ref[ib][k] != ref[k]) {
+				fprintf(stderr, "%s differs at pixel %ld: %d, baseline %d\n",
+						S2_SDS_NAME[ib], k, s2out.ref[ib][k], ref[k]);
+				return(1);
+			}
+		}
+		free(ref);
+		free(band[ib]);
+		free(s2out.ref[ib]);
+		sprintf(fname_img, "check_combine_band%d.img", ib);
+		remove(fname_img);
+	}
+	remove(fname_xml[0]);
+	remove(fname_xml[1]);
+
+	printf("check_combine: %d bands identical\n", S2NBAND);
+	return(0);
+}
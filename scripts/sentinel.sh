@@ -15,6 +15,7 @@ bucket_role_arn="$GCC_ROLE_ARN"
 debug_bucket="$DEBUG_BUCKET"
 replace_existing="$REPLACE_EXISTING"
 gibs_bucket="$GIBS_OUTPUT_BUCKET"
+native_cog="$NATIVE_COG"
 
 # Remove tmp files on exit
 # shellcheck disable=SC2064
@@ -62,6 +63,18 @@ set_output_names () {
   # We also need to obtain the sensor for the Bandpass parameters file
   sensor="${granulecomponents[0]:0:3}"
   angleoutputfinal="${workingdir}/${outputname}.ANGLE.hdf"
+  # With NATIVE_COG set, the final S30 and angles are written as COG by the C
+  # code with this prefix, e.g. ${cog_prefix}.B01.tif, ${cog_prefix}.SZA.tif,
+  # and checked by validate_cog.sh. Otherwise hdf_to_cog converts the hdf as
+  # before, until the two are shown to match.
+  cog_prefix="${workingdir}/${outputname}"
+  cog_args=()
+  angcog_args=()
+  if [ -n "$native_cog" ]; then
+    cog_args=(-cog "$cog_prefix")
+    angcog_args=(-angcog "$cog_prefix")
+  fi
+  parameter="/usr/local/bandpass_parameter.${sensor}.txt"
 }
 
 exit_if_exists () {
@@ -83,13 +96,23 @@ read -r -a granules <<< "$granulelist"
 if [ "${#granules[@]}" = 2 ]; then
   # Use the base SAFE name without the unique id for the output file name.
   set_output_names "${granules[0]}" twin
+  # Twin granules are consolidated at 10m, so run the separate executables.
+  s30output=""
+  # The S10 and the angles passed between the executables are raw, mapped by
+  # the next executable instead of being deflated and inflated (see hls_raw.h).
+  # Keep them as hdf in debug mode.
+  if [ -z "$debug_bucket" ]; then
+    intermediate_ext="raw"
+  else
+    intermediate_ext="hdf"
+  fi
   # Process each granule in granulelist and build the consolidatelist
   consolidatelist=""
   consolidate_angle_list=""
   for granule in "${granules[@]}"; do
     granuledir="${workingdir}/${granule}"
-    angleoutput="${granuledir}/angle.hdf"
-    granuleoutput="${granuledir}/sr.hdf"
+    angleoutput="${granuledir}/angle.${intermediate_ext}"
+    granuleoutput="${granuledir}/sr.${intermediate_ext}"
     source sentinel_granule.sh
     # Build list of outputs and angleoutputs to consolidate
     if [ "${#consolidatelist}" = 0 ]; then
@@ -101,12 +124,12 @@ if [ "${#granules[@]}" = 2 ]; then
     fi
   done
   echo "Running consolidate on ${consolidatelist}"
-  consolidate_output="${workingdir}/consolidate.hdf"
+  consolidate_output="${workingdir}/consolidate.${intermediate_ext}"
   consolidate_angle_output="${workingdir}/consolidate_angle.hdf"
-  consolidate_command="consolidate ${consolidatelist} ${consolidate_output}"
-  consolidate_angle_command="consolidate_s2ang ${consolidate_angle_list} ${consolidate_angle_output}"
+  # The angles are consolidated in the same pass, from the granule that
+  # supplies the reflectance of each 60m pixel.
+  consolidate_command="consolidate ${consolidatelist} ${consolidate_output} -ang ${consolidate_angle_list} ${consolidate_angle_output}"
   eval "$consolidate_command"
-  eval "$consolidate_angle_command"
   # Use the consolidate output as loop process output for next stage.
   angleoutput="$consolidate_angle_output"
   granuleoutput="$consolidate_output"
@@ -119,56 +142,76 @@ else
   granuledir="${workingdir}/${granule}"
   angleoutput="${granuledir}/angle.hdf"
   granuleoutput="${granuledir}/sr.hdf"
+  # hls_s2_pipeline runs all the stages up to L8like in one process and
+  # writes the final S30 directly.
+  s30output="$output_hdf"
 
   source sentinel_granule.sh
 fi
 
-# Resample to 30m
-echo "Running create_s2at30m"
 resample30m="${workingdir}/resample30m.hdf"
 resample30m_hdr="${resample30m}.hdr"
-create_s2at30m "$granuleoutput" "$resample30m"
-
-# Unlike all the other C libs, derive_s2nbar and L8like modify the input file
-# Move the resample output to nbar naming.
-# Maintain intermediate 30m version in debug mode.
-if [ -z "$debug_bucket" ]; then
-  mv "$resample30m" "$nbar_input"
-  mv "$resample30m_hdr" "$nbar_hdr"
-else
-  cp "$resample30m" "$nbar_input"
-  cp "$resample30m_hdr" "$nbar_hdr"
-fi
-
-# Nbar
-echo "Running derive_s2nbar"
-cfactor="${workingdir}/cfactor.hdf"
-derive_s2nbar "$nbar_input" "$angleoutput" "$cfactor"
-
 nbarIntermediate="${workingdir}/nbarIntermediate.hdf"
 nbarIntermediate_hdr="${nbarIntermediate}.hdr"
-# Maintain intermediate nbar version in debug mode.
-if [ "$debug_bucket" ]; then
-  cp "$nbar_input" "$nbarIntermediate"
-  cp "$nbar_hdr" "$nbarIntermediate_hdr"
-fi
 
-# Bandpass
-echo "Running L8like"
-parameter="/usr/local/bandpass_parameter.${sensor}.txt"
-L8like "$parameter" "$nbar_input"
+if [ -z "$s30output" ]; then
+  # Resample to 30m
+  echo "Running create_s2at30m"
+  create_s2at30m "$granuleoutput" "$resample30m"
+
+  # Unlike all the other C libs, derive_s2nbar and L8like modify the input file
+  # Move the resample output to nbar naming.
+  # Maintain intermediate 30m version in debug mode.
+  if [ -z "$debug_bucket" ]; then
+    mv "$resample30m" "$nbar_input"
+    mv "$resample30m_hdr" "$nbar_hdr"
+  else
+    cp "$resample30m" "$nbar_input"
+    cp "$resample30m_hdr" "$nbar_hdr"
+  fi
+
+  cfactor="${workingdir}/cfactor.hdf"
+  # Maintain intermediate nbar version in debug mode, written by derive_s2nbar
+  # into a copy of the resampled input; the output is the same either way.
+  nbarout_args=()
+  if [ -n "$debug_bucket" ]; then
+    cp "$nbar_input" "$nbarIntermediate"
+    cp "$nbar_hdr" "$nbarIntermediate_hdr"
+    nbarout_args=(-nbarout "$nbarIntermediate")
+  fi
 
-mv "$nbar_input" "$output_hdf"
-mv "${nbar_input}.hdr" "${output_hdf}.hdr"
+  # Nbar and bandpass in one pass
+  echo "Running derive_s2nbar with bandpass"
+  derive_s2nbar "$nbar_input" "$angleoutput" "$cfactor" -bandpass "$parameter" \
+    "${cog_args[@]}" "${angcog_args[@]}" "${nbarout_args[@]}"
 
-# Convert to COGs
-echo "Converting to COGs"
-hdf_to_cog "$output_hdf" --output-dir "$workingdir" --product S30
+  mv "$nbar_input" "$output_hdf"
+  mv "${nbar_input}.hdr" "${output_hdf}.hdr"
+fi
 
 mv "$angleoutput" "$angleoutputfinal"
-hdf_to_cog "$angleoutputfinal" --output-dir "$workingdir" --product S30_ANGLES
 
-# Create thumbnail
+if [ -z "$native_cog" ]; then
+  # Convert to COGs
+  echo "Converting to COGs"
+  hdf_to_cog "$output_hdf" --output-dir "$workingdir" --product S30
+  hdf_to_cog "$angleoutputfinal" --output-dir "$workingdir" --product S30_ANGLES
+else
+  # The COGs have been written along with the S30 (see cog_prefix), with
+  # internal overviews. Validate them; in debug mode also compare them
+  # with the hdf_to_cog output, the report going to the debug bucket without
+  # stopping the run.
+  echo "Validating COGs"
+  if [ -z "$debug_bucket" ]; then
+    validate_cog.sh "$workingdir" "$outputname" "$output_hdf" "$angleoutputfinal"
+  else
+    validate_cog.sh "$workingdir" "$outputname" "$output_hdf" "$angleoutputfinal" \
+      --compare 2>&1 | tee "${workingdir}/cog_validation.txt"
+  fi
+fi
+
+# Create thumbnail. In debug mode with NATIVE_COG, hls_s2_pipeline also writes
+# quicklook.jpg from the COG overviews, for comparison.
 echo "Creating thumbnail"
 create_thumbnail -i "$workingdir" -o "$output_thumbnail" -s S30
 
@@ -117,32 +117,44 @@ do_lasrc_sentinel.py --xml "$espa_xml"
 
 hls_espa_one_xml="${espa_id}_1_hls.xml"
 hls_espa_two_xml="${espa_id}_2_hls.xml"
-sr_hdf_one="${espa_id}_sr_1.hdf"
-sr_hdf_two="${espa_id}_sr_2.hdf"
-hls_sr_combined_hdf="${espa_id}_sr_combined.hdf"
+hls_sr_combined_hdf="${espa_id}_sr_combined.${intermediate_ext:-hdf}"
 aerosol_qa="${espa_id}_sr_aerosol_qa.img"
 # Surface reflectance is current final output
 hls_sr_output_hdf="$granuleoutput"
 
-# Create ESPA xml files using HLS v1.5 band names.
+# Create ESPA xml files using HLS v1.5 band names. twohdf2one and
+# hls_s2_pipeline read the raw binary bands through them directly, so
+# there is no conversion to HDF.
 create_sr_hdf_xml "$espa_xml" "$hls_espa_one_xml" one
 create_sr_hdf_xml "$espa_xml" "$hls_espa_two_xml" two
 
-# Convert ESPA xml files to HDF
-convert_espa_to_hdf --xml="$hls_espa_one_xml" --hdf="$sr_hdf_one"
-convert_espa_to_hdf --xml="$hls_espa_two_xml" --hdf="$sr_hdf_two"
-
-# Combine split hdf files and resample 10M SR bands back to 20M and 60M.
-echo "Combining hdf files"
-twohdf2one "$sr_hdf_one" "$sr_hdf_two" MTD_MSIL1C.xml MTD_TL.xml LaSRC "$hls_sr_combined_hdf"
+if [ -n "$s30output" ]; then
+  # Single granule: combine, add Fmask, trim, resample to 30m, NBAR and
+  # bandpass in one process. The S10 is not written unless in debug mode.
+  echo "Running hls_s2_pipeline"
+  # With NATIVE_COG, the S30 and angle COGs are written from memory alongside
+  # the S30 (see cog_args in sentinel.sh).
+  if [ -z "$debug_bucket" ]; then
+    hls_s2_pipeline "$hls_espa_one_xml" "$hls_espa_two_xml" MTD_MSIL1C.xml MTD_TL.xml LaSRC \
+      "$fmaskbin" "$aerosol_qa" "$angleoutput" "$parameter" "$s30output" "${cog_args[@]}"
+  else
+    hls_s2_pipeline "$hls_espa_one_xml" "$hls_espa_two_xml" MTD_MSIL1C.xml MTD_TL.xml LaSRC \
+      "$fmaskbin" "$aerosol_qa" "$angleoutput" "$parameter" "$s30output" "${cog_args[@]}" \
+      -debug "$workingdir" "$hls_sr_output_hdf"
+  fi
+else
+  # Combine split hdf files and resample 10M SR bands back to 20M and 60M.
+  echo "Combining hdf files"
+  twohdf2one "$hls_espa_one_xml" "$hls_espa_two_xml" MTD_MSIL1C.xml MTD_TL.xml LaSRC "$hls_sr_combined_hdf"
 
-# Run addFmaskSDS
-echo "Adding Fmask SDS"
-addFmaskSDS "$hls_sr_combined_hdf" "$fmaskbin" "$aerosol_qa" MTD_MSIL1C.xml MTD_TL.xml LaSRC "$hls_sr_output_hdf"
+  # Run addFmaskSDS
+  echo "Adding Fmask SDS"
+  addFmaskSDS "$hls_sr_combined_hdf" "$fmaskbin" "$aerosol_qa" MTD_MSIL1C.xml MTD_TL.xml LaSRC "$hls_sr_output_hdf"
 
-# Trim edge pixels for spurious SR values
-echo "Trimming output hdf file"
-s2trim "$hls_sr_output_hdf"
+  # Trim edge pixels for spurious SR values
+  echo "Trimming output hdf file"
+  s2trim "$hls_sr_output_hdf"
+fi
 
 # Remove intermediate files.
 cd "$granuledir"
@@ -0,0 +1,63 @@
+#!/bin/bash
+# Check the COGs written directly by the C code (NATIVE_COG, see sentinel.sh).
+#
+#   validate_cog.sh workingdir outputname output.hdf angle.hdf [--compare]
+#
+# Every ${outputname}.*.tif in workingdir must pass "rio cogeo validate".
+# With --compare, output.hdf and angle.hdf are also converted by hdf_to_cog into
+# a scratch directory and each native COG is compared with its hdf_to_cog
+# counterpart with gdalinfo -checksum; the size, coordinate system, geotransform,
+# nodata and the band checksum must match. The full gdalinfo diff, metadata
+# included, is printed for review.
+#
+# Exit status is 1 if any check fails.
+set -o nounset
+
+workingdir="$1"
+outputname="$2"
+output_hdf="$3"
+angle_hdf="$4"
+compare="${5:-}"
+
+status=0
+
+for tif in "${workingdir}/${outputname}".*.tif; do
+  result=$(rio cogeo validate "$tif" 2>&1)
+  echo "$result"
+  if [[ "$result" == *"is NOT a valid"* ]] || [[ "$result" != *"is a valid"* ]]; then
+    status=1
+  fi
+done
+
+if [ "$compare" = "--compare" ]; then
+  refdir="${workingdir}/hdf_to_cog_ref"
+  mkdir -p "$refdir"
+  hdf_to_cog "$output_hdf" --output-dir "$refdir" --product S30
+  hdf_to_cog "$angle_hdf" --output-dir "$refdir" --product S30_ANGLES
+
+  for tif in "${workingdir}/${outputname}".*.tif; do
+    name=$(basename "$tif")
+    ref="${refdir}/${name}"
+    if [ ! -f "$ref" ]; then
+      echo "No hdf_to_cog output for ${name}"
+      status=1
+      continue
+    fi
+    # Drop the file names, which differ by directory
+    gdalinfo -checksum -nofl "$tif" | grep -v "^Files:\|${name}" > "${tif}.gdalinfo"
+    gdalinfo -checksum -nofl "$ref" | grep -v "^Files:\|${name}" > "${ref}.gdalinfo"
+    if ! diff "${ref}.gdalinfo" "${tif}.gdalinfo"; then
+      echo "gdalinfo differs for ${name} (< hdf_to_cog, > native)"
+    fi
+    for key in "Size is" "PROJCRS\|PROJCS" "Origin =" "Pixel Size =" "NoData Value=" "Checksum="; do
+      if [ "$(grep "$key" "${ref}.gdalinfo")" != "$(grep "$key" "${tif}.gdalinfo")" ]; then
+        echo "Mismatch in \"${key}\" for ${name}"
+        status=1
+      fi
+    done
+    rm -f "${tif}.gdalinfo" "${ref}.gdalinfo"
+  done
+  rm -rf "$refdir"
+fi
+
+exit $status